@@ -121,6 +121,48 @@ EError TPortoApi::Send(const TPortoRequest &req) {
         return EError::InvalidMethod;
     }
 
+    if (AttachedFd >= 0) {
+        TString buf;
+
+        {
+            google::protobuf::io::StringOutputStream stream(&buf);
+            google::protobuf::io::CodedOutputStream output(&stream);
+
+            output.WriteVarint32(req.ByteSizeLong());
+            req.SerializeWithCachedSizes(&output);
+        }
+
+        /* Ancillary data sticks to the first byte of request */
+        char control[CMSG_SPACE(sizeof(int))] = {0};
+        struct msghdr msghdr = {};
+        struct iovec iovec;
+
+        iovec.iov_base = &buf[0];
+        iovec.iov_len = buf.size();
+        msghdr.msg_iov = &iovec;
+        msghdr.msg_iovlen = 1;
+        msghdr.msg_control = control;
+        msghdr.msg_controllen = sizeof(control);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msghdr);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        *((int*)CMSG_DATA(cmsg)) = AttachedFd;
+
+        ssize_t len = sendmsg(Fd, &msghdr, MSG_NOSIGNAL);
+        if (len <= 0)
+            return SetError("send", len ? errno : EIO);
+
+        for (size_t off = len; off < buf.size(); off += len) {
+            len = send(Fd, &buf[off], buf.size() - off, MSG_NOSIGNAL);
+            if (len <= 0)
+                return SetError("send", len ? errno : EIO);
+        }
+
+        return EError::Success;
+    }
+
     {
         google::protobuf::io::CodedOutputStream output(&raw);
 
@@ -995,6 +1037,66 @@ EError TPortoApi::ReExportLayer(const TString &layer,
     return Call(DiskTimeout);
 }
 
+EError TPortoApi::ImportLayerFd(const TString &layer,
+                                int fd,
+                                const TString &compress,
+                                bool merge,
+                                const TString &place,
+                                const TString &private_value) {
+    Req.Clear();
+    auto req = Req.mutable_importlayer();
+
+    req->set_layer(layer);
+    req->set_fd(true);
+    req->set_merge(merge);
+    if (compress.size())
+        req->set_compress(compress);
+    if (place.size())
+        req->set_place(place);
+    if (private_value.size())
+        req->set_private_value(private_value);
+
+    AttachedFd = fd;
+    EError err = Call(DiskTimeout);
+    AttachedFd = -1;
+    return err;
+}
+
+EError TPortoApi::ExportLayerFd(const TString &volume,
+                                int fd,
+                                const TString &compress) {
+    Req.Clear();
+    auto req = Req.mutable_exportlayer();
+
+    req->set_volume(volume);
+    req->set_fd(true);
+    if (compress.size())
+        req->set_compress(compress);
+
+    AttachedFd = fd;
+    EError err = Call(DiskTimeout);
+    AttachedFd = -1;
+    return err;
+}
+
+EError TPortoApi::ReExportLayerFd(const TString &layer,
+                                  int fd,
+                                  const TString &compress) {
+    Req.Clear();
+    auto req = Req.mutable_exportlayer();
+
+    req->set_volume("");
+    req->set_layer(layer);
+    req->set_fd(true);
+    if (compress.size())
+        req->set_compress(compress);
+
+    AttachedFd = fd;
+    EError err = Call(DiskTimeout);
+    AttachedFd = -1;
+    return err;
+}
+
 EError TPortoApi::RemoveLayer(const TString &layer,
                               const TString &place) {
     Req.Clear();
@@ -49,6 +49,9 @@ private:
     int AsyncWaitTimeout = INFINITE_TIMEOUT;
     TWaitCallback AsyncWaitCallback;
 
+    /* Passed by SCM_RIGHTS along with next request */
+    int AttachedFd = -1;
+
     EError SetError(const TString &prefix, int _errno) Y_WARN_UNUSED_RESULT;
 
     EError SetSocketTimeout(int direction, int timeout) Y_WARN_UNUSED_RESULT;
@@ -346,6 +349,22 @@ public:
                          const TString &tarball,
                          const TString &compress = "") Y_WARN_UNUSED_RESULT;
 
+    /* Stream archive from or into pipe or socket without intermediate file */
+    EError ImportLayerFd(const TString &layer,
+                         int fd,
+                         const TString &compress,
+                         bool merge = false,
+                         const TString &place = "",
+                         const TString &private_value = "") Y_WARN_UNUSED_RESULT;
+
+    EError ExportLayerFd(const TString &volume,
+                         int fd,
+                         const TString &compress = "") Y_WARN_UNUSED_RESULT;
+
+    EError ReExportLayerFd(const TString &layer,
+                           int fd,
+                           const TString &compress = "") Y_WARN_UNUSED_RESULT;
+
     EError RemoveLayer(const TString &layer,
                        const TString &place = "") Y_WARN_UNUSED_RESULT;
 
@@ -1,4 +1,5 @@
 import os
+import array
 import socket
 import threading
 
@@ -41,6 +42,8 @@ class PortoApi(object):
         self.async_wait_names = []
         self.async_wait_callback = None
         self.async_wait_timeout = None
+        self.async_wait_labels = None
+        self.async_wait_seq = None
 
     def _set_timeout(self, extra_timeout=0):
         if extra_timeout is None:
@@ -136,7 +139,12 @@ class PortoApi(object):
             rsp.ParseFromString(bytes(self._recv_data(length)))
 
             if rsp.HasField('AsyncWait'):
-                if self.async_wait_callback is not None:
+                if self.async_wait_seq is not None and rsp.AsyncWait.HasField("seq"):
+                    # resumable wait: reconnect continues from last seen event
+                    self.async_wait_seq = rsp.AsyncWait.seq
+                    if self.async_wait_callback is not None:
+                        self.async_wait_callback(name=rsp.AsyncWait.name, state=rsp.AsyncWait.state, when=rsp.AsyncWait.when, label=rsp.AsyncWait.label, value=rsp.AsyncWait.value, seq=rsp.AsyncWait.seq)
+                elif self.async_wait_callback is not None:
                     if rsp.AsyncWait.HasField("label"):
                         self.async_wait_callback(name=rsp.AsyncWait.name, state=rsp.AsyncWait.state, when=rsp.AsyncWait.when, label=rsp.AsyncWait.label, value=rsp.AsyncWait.value)
                     else:
@@ -144,7 +152,18 @@ class PortoApi(object):
             else:
                 return rsp
 
-    def _call(self, request, extra_timeout=0):
+    def _send_request(self, req, fd=None):
+        if fd is None:
+            self.sock.sendall(req)
+            return
+        if hasattr(fd, 'fileno'):
+            fd = fd.fileno()
+        # ancillary data sticks to the first byte of request
+        sent = self.sock.sendmsg([bytes(req)], [(socket.SOL_SOCKET, socket.SCM_RIGHTS, array.array('i', [fd]))])
+        if sent < len(req):
+            self.sock.sendall(req[sent:])
+
+    def _call(self, request, extra_timeout=0, fd=None):
         req = self._encode_request(request)
 
         with self.lock:
@@ -160,7 +179,7 @@ class PortoApi(object):
                     raise exceptions.SocketError("Porto socket connected by other pid {}".format(self.sock_pid))
             elif self.auto_reconnect:
                 try:
-                    self.sock.sendall(req)
+                    self._send_request(req, fd)
                     req = None
                 except socket.timeout as e:
                     self.sock = None
@@ -170,7 +189,7 @@ class PortoApi(object):
 
             try:
                 if req is not None:
-                    self.sock.sendall(req)
+                    self._send_request(req, fd)
 
                 if extra_timeout is None or extra_timeout > 0:
                     self._set_timeout(extra_timeout)
@@ -200,6 +219,10 @@ class PortoApi(object):
         request.AsyncWait.name.extend(self.async_wait_names)
         if self.async_wait_timeout is not None:
             request.AsyncWait.timeout_ms = int(self.async_wait_timeout * 1000)
+        if self.async_wait_labels is not None:
+            request.AsyncWait.label.extend(self.async_wait_labels)
+        if self.async_wait_seq is not None:
+            request.AsyncWait.since_seq = self.async_wait_seq
 
         self.sock.sendall(self._encode_request(request))
         response = self._recv_response()
@@ -397,6 +420,22 @@ class PortoApi(object):
             return True
         return res
 
+    def ReadStream(self, name, stream="stdout", offset=None, limit=None, timeout=None):
+        """returns (data, offset, size), waits up to timeout seconds for data beyond offset"""
+        request = rpc.TPortoRequest()
+        request.ReadStream.name = name
+        request.ReadStream.stream = stream
+        if offset is not None:
+            request.ReadStream.offset = offset
+        if limit is not None:
+            request.ReadStream.limit = limit
+        if timeout is not None and timeout > 0:
+            request.ReadStream.timeout_ms = int(timeout * 1000)
+        else:
+            timeout = 0
+        res = self._call(request, timeout).ReadStream
+        return res.data, res.offset, res.size
+
     def SetProperty(self, name, prop, value, index=None):
         if value is False:
             value = 'false'
@@ -548,13 +587,15 @@ class PortoApi(object):
         except exceptions.WaitContainerTimeout:
             return ""
 
-    def AsyncWait(self, containers, callback, timeout=None, labels=None):
+    def AsyncWait(self, containers, callback, timeout=None, labels=None, since_seq=None):
         names = [str(ct) for ct in containers]
 
         with self.lock:
             self.async_wait_names = names
             self.async_wait_callback = callback
             self.async_wait_timeout = timeout
+            self.async_wait_labels = labels
+            self.async_wait_seq = since_seq
 
         request = rpc.TPortoRequest()
         request.AsyncWait.name.extend(names)
@@ -562,6 +603,8 @@ class PortoApi(object):
             request.AsyncWait.timeout_ms = int(timeout * 1000)
         if labels is not None:
             request.AsyncWait.label.extend(labels)
+        if since_seq is not None:
+            request.AsyncWait.since_seq = since_seq
         self._call(request)
 
     def WaitLabels(self, containers, labels, timeout=None):
@@ -728,29 +771,40 @@ class PortoApi(object):
             req.SetVolumeLabel.prev_value = prev_value
         self._call(req).SetVolumeLabel.prev_value
 
-    def ImportLayer(self, layer, tarball, place=None, private_value=None, timeout=None):
+    # With fd (pipe or socket) archive is streamed from it, tarball must be None
+    def ImportLayer(self, layer, tarball, place=None, private_value=None, timeout=None, compress=None, fd=None):
         request = rpc.TPortoRequest()
         request.ImportLayer.layer = layer
-        request.ImportLayer.tarball = tarball
+        if tarball is not None:
+            request.ImportLayer.tarball = tarball
         request.ImportLayer.merge = False
         if place is not None:
             request.ImportLayer.place = place
         if private_value is not None:
             request.ImportLayer.private_value = private_value
+        if compress is not None:
+            request.ImportLayer.compress = compress
+        if fd is not None:
+            request.ImportLayer.fd = True
 
-        self._call(request, timeout or self.disk_timeout)
+        self._call(request, timeout or self.disk_timeout, fd=fd)
         return Layer(self, layer, place)
 
-    def MergeLayer(self, layer, tarball, place=None, private_value=None, timeout=None):
+    def MergeLayer(self, layer, tarball, place=None, private_value=None, timeout=None, compress=None, fd=None):
         request = rpc.TPortoRequest()
         request.ImportLayer.layer = layer
-        request.ImportLayer.tarball = tarball
+        if tarball is not None:
+            request.ImportLayer.tarball = tarball
         request.ImportLayer.merge = True
         if place is not None:
             request.ImportLayer.place = place
         if private_value is not None:
             request.ImportLayer.private_value = private_value
-        self._call(request, timeout or self.disk_timeout)
+        if compress is not None:
+            request.ImportLayer.compress = compress
+        if fd is not None:
+            request.ImportLayer.fd = True
+        self._call(request, timeout or self.disk_timeout, fd=fd)
         return Layer(self, layer, place)
 
     def RemoveLayer(self, layer, place=None, timeout=None):
@@ -776,34 +830,43 @@ class PortoApi(object):
             request.SetLayerPrivate.place = place
         self._call(request)
 
-    def ExportLayer(self, volume, tarball, place=None, compress=None, timeout=None):
+    # With fd (pipe or socket) archive is streamed into it, tarball must be None
+    def ExportLayer(self, volume, tarball, place=None, compress=None, timeout=None, fd=None):
         request = rpc.TPortoRequest()
         request.ExportLayer.volume = volume
-        request.ExportLayer.tarball = tarball
+        if tarball is not None:
+            request.ExportLayer.tarball = tarball
         if place is not None:
             request.ExportLayer.place = place
         if compress is not None:
             request.ExportLayer.compress = compress
-        self._call(request, timeout or self.disk_timeout)
+        if fd is not None:
+            request.ExportLayer.fd = True
+        self._call(request, timeout or self.disk_timeout, fd=fd)
 
-    def ReExportLayer(self, layer, tarball, place=None, compress=None, timeout=None):
+    def ReExportLayer(self, layer, tarball, place=None, compress=None, timeout=None, fd=None):
         request = rpc.TPortoRequest()
         request.ExportLayer.volume = ""
         request.ExportLayer.layer = layer
-        request.ExportLayer.tarball = tarball
+        if tarball is not None:
+            request.ExportLayer.tarball = tarball
         if place is not None:
             request.ExportLayer.place = place
         if compress is not None:
             request.ExportLayer.compress = compress
-        self._call(request, timeout or self.disk_timeout)
+        if fd is not None:
+            request.ExportLayer.fd = True
+        self._call(request, timeout or self.disk_timeout, fd=fd)
 
-    def _ListLayers(self, place=None, mask=None):
+    def _ListLayers(self, place=None, mask=None, cache_only=False):
         request = rpc.TPortoRequest()
         request.ListLayers.SetInParent()
         if place is not None:
             request.ListLayers.place = place
         if mask is not None:
             request.ListLayers.mask = mask
+        if cache_only:
+            request.ListLayers.cache_only = True
         return self._call(request).ListLayers
 
     def ListLayers(self, place=None, mask=None):
@@ -812,6 +875,9 @@ class PortoApi(object):
             return [Layer(self, l.name, place, l) for l in response.layers]
         return [Layer(self, l, place) for l in response.layer]
 
+    def GetLayerCache(self, place=None):
+        return self._ListLayers(place, None, cache_only=True).cache
+
     def FindLayer(self, layer, place=None):
         response = self._ListLayers(place, layer)
         if layer not in response.layer:
@@ -10,6 +10,8 @@ class Layer(object):
         self.owner_group = None
         self.last_usage = None
         self.private_value = None
+        self.space_used = None
+        self.space_shared = None
         if pb is not None:
             self.Update(pb)
 
@@ -20,6 +22,9 @@ class Layer(object):
         self.owner_group = pb.owner_group
         self.last_usage = pb.last_usage
         self.private_value = pb.private_value
+        if pb.HasField('space_used'):
+            self.space_used = pb.space_used
+            self.space_shared = pb.space_shared
 
     def __str__(self):
         return self.name
@@ -27,14 +32,14 @@ class Layer(object):
     def __repr__(self):
         return 'Layer `{}` at `{}`'.format(self.name, self.place or "/place")
 
-    def Merge(self, tarball, private_value=None, timeout=None):
-        self.api.MergeLayer(self.name, tarball, place=self.place, private_value=private_value, timeout=timeout)
+    def Merge(self, tarball, private_value=None, timeout=None, compress=None, fd=None):
+        self.api.MergeLayer(self.name, tarball, place=self.place, private_value=private_value, timeout=timeout, compress=compress, fd=fd)
 
     def Remove(self, timeout=None):
         self.api.RemoveLayer(self.name, place=self.place, timeout=timeout)
 
-    def Export(self, tarball, compress=None, timeout=None):
-        self.api.ReExportLayer(self.name, place=self.place, tarball=tarball, compress=compress, timeout=timeout)
+    def Export(self, tarball, compress=None, timeout=None, fd=None):
+        self.api.ReExportLayer(self.name, place=self.place, tarball=tarball, compress=compress, timeout=timeout, fd=fd)
 
     def GetPrivate(self):
         return self.api.GetLayerPrivate(self.name, place=self.place)
@@ -252,8 +257,8 @@ class Volume(object):
     def SetLabel(self, label, value, prev_value=None):
         return self.api.SetVolumeLabel(self.path, label, value, prev_value)
 
-    def Export(self, tarball, compress=None, timeout=None):
-        self.api.ExportLayer(self.path, place=self.place, tarball=tarball, compress=compress, timeout=timeout)
+    def Export(self, tarball, compress=None, timeout=None, fd=None):
+        self.api.ExportLayer(self.path, place=self.place, tarball=tarball, compress=compress, timeout=timeout, fd=fd)
 
     def Destroy(self, strict=None, timeout=None):
         self.api.UnlinkVolume(self.path, '***', strict=strict, timeout=timeout)
@@ -301,23 +301,48 @@ TError TCgroup::GetPids(const std::string &knob, std::vector<pid_t> &pids) const
     return OK;
 }
 
+/* Counts lines without parsing and storing pids */
+TError TCgroup::CountPids(const std::string &knob, uint64_t &count) const {
+    char buf[16 << 10];
+    ssize_t len;
+    int fd;
+
+    if (!Subsystem)
+        return TError("Cannot get from null cgroup");
+
+    fd = open(Knob(knob).c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0)
+        return TError::System("Cannot open knob " + knob);
+
+    count = 0;
+    while ((len = read(fd, buf, sizeof(buf))) > 0)
+        count += std::count(buf, buf + len, '\n');
+
+    close(fd);
+
+    if (len < 0)
+        return TError::System("Cannot read knob " + knob);
+
+    return OK;
+}
+
 TError TCgroup::GetCount(bool threads, uint64_t &count) const {
     std::vector<TCgroup> childs;
     TError error;
 
     if (!Subsystem)
-        TError("Cannot get from null cgroup");
+        return TError("Cannot get from null cgroup");
     error = ChildsAll(childs);
     if (error)
         return error;
     childs.push_back(*this);
     count = 0;
     for (auto &cg: childs) {
-        std::vector<pid_t> pids;
-        error = cg.GetPids(threads ? "tasks" : "cgroup.procs", pids);
+        uint64_t pids;
+        error = cg.CountPids(threads ? "tasks" : "cgroup.procs", pids);
         if (error)
             break;
-        count += pids.size();
+        count += pids;
     }
     return error;
 }
@@ -653,37 +678,96 @@ TError TMemorySubsystem::GetReclaimed(TCgroup &cg, uint64_t &count) const {
 }
 
 // Freezer
-TError TFreezerSubsystem::WaitState(const TCgroup &cg, const std::string &state) const {
+
+/*
+ * Cgroup-v1 freezer has no completion notification: state FREEZING turns
+ * into FROZEN only when somebody reads freezer.state. So poll all cgroups
+ * at once with exponential backoff: fast freezes complete in a couple of
+ * milliseconds, stuck ones do not burn cpu with frequent wakeups.
+ */
+TError TFreezerSubsystem::WaitState(const std::vector<TCgroup> &cgroups,
+                                    const std::string &state) const {
     uint64_t deadline = GetCurrentTimeMs() + config().daemon().freezer_wait_timeout_s() * 1000;
+    std::list<const TCgroup *> pending;
+    uint64_t wait = 1;
     std::string cur;
     TError error;
 
+    for (auto &cg: cgroups)
+        pending.push_back(&cg);
+
     do {
-        error = cg.Get("freezer.state", cur);
-        if (error || StringTrim(cur) == state)
-            return error;
-    } while (!WaitDeadline(deadline));
+        for (auto it = pending.begin(); it != pending.end(); ) {
+            error = (*it)->Get("freezer.state", cur);
+            if (error)
+                return error;
+            if (StringTrim(cur) == state)
+                it = pending.erase(it);
+            else
+                ++it;
+        }
+        if (pending.empty())
+            return OK;
+        wait = std::min(wait * 2, (uint64_t)100);
+    } while (!WaitDeadline(deadline, wait));
 
-    return TError("Freezer {} timeout waiting {}", cg.Name, state);
+    return TError("Freezer {} timeout waiting {}", pending.front()->Name, state);
+}
+
+TError TFreezerSubsystem::WaitState(const TCgroup &cg, const std::string &state) const {
+    return WaitState(std::vector<TCgroup>{cg}, state);
+}
+
+/* Freezes all cgroups and waits once, on failure thaws them back */
+TError TFreezerSubsystem::Freeze(const std::vector<TCgroup> &cgroups, bool wait) const {
+    TError error;
+
+    for (auto &cg: cgroups) {
+        error = cg.Set("freezer.state", "FROZEN");
+        if (error)
+            break;
+    }
+
+    if (!error && wait)
+        error = WaitState(cgroups, "FROZEN");
+
+    if (error) {
+        for (auto &cg: cgroups)
+            (void)cg.Set("freezer.state", "THAWED");
+    }
+
+    return error;
 }
 
 TError TFreezerSubsystem::Freeze(const TCgroup &cg, bool wait) const {
-    TError error = cg.Set("freezer.state", "FROZEN");
+    return Freeze(std::vector<TCgroup>{cg}, wait);
+}
+
+/*
+ * Sets state in the given order, callers pass parents before childs.
+ * Continues after failure and returns the first error.
+ */
+TError TFreezerSubsystem::Thaw(const std::vector<TCgroup> &cgroups, bool wait) const {
+    TError error;
+
+    for (auto &cg: cgroups) {
+        TError err = cg.Set("freezer.state", "THAWED");
+        if (err && !error)
+            error = err;
+    }
+
     if (error || !wait)
         return error;
-    error = WaitState(cg, "FROZEN");
-    if (error)
-        (void)cg.Set("freezer.state", "THAWED");
-    return error;
+
+    for (auto &cg: cgroups)
+        if (IsParentFreezing(cg))
+            return TError(EError::Busy, "parent cgroup is frozen");
+
+    return WaitState(cgroups, "THAWED");
 }
 
 TError TFreezerSubsystem::Thaw(const TCgroup &cg, bool wait) const {
-    TError error = cg.Set("freezer.state", "THAWED");
-    if (error || !wait)
-        return error;
-    if (IsParentFreezing(cg))
-        return TError(EError::Busy, "parent cgroup is frozen");
-    return WaitState(cg, "THAWED");
+    return Thaw(std::vector<TCgroup>{cg}, wait);
 }
 
 bool TFreezerSubsystem::IsFrozen(const TCgroup &cg) const {
@@ -876,6 +960,48 @@ TError TCpuacctSubsystem::SystemUsage(TCgroup &cg, uint64_t &value) const {
     return OK;
 }
 
+bool TCpuacctSubsystem::SupportPressure() const {
+    return Cgroup(PORTO_DAEMON_CGROUP).Has("cpu.pressure");
+}
+
+TPath TCpuacctSubsystem::PressureKnob(const TCgroup &cg, const std::string &resource) const {
+    /* Root cgroup has no pressure files, system-wide stall is in procfs */
+    if (cg.IsRoot())
+        return "/proc/pressure/" + resource;
+    return cg.Knob(resource + ".pressure");
+}
+
+TError TCpuacctSubsystem::GetPressure(const TCgroup &cg, const std::string &resource,
+                                      TPressure &pressure) const {
+    std::string text;
+    TError error = PressureKnob(cg, resource).ReadAll(text);
+    if (error)
+        return error;
+    return pressure.Parse(text);
+}
+
+TError TCpuacctSubsystem::SetupPressureTrigger(const TCgroup &cg, const std::string &resource,
+                                               const std::string &type, uint64_t stall,
+                                               uint64_t window, TFile &trigger) const {
+    TPath knob = PressureKnob(cg, resource);
+    TError error;
+
+    error = trigger.Open(knob, O_RDWR | O_NONBLOCK | O_CLOEXEC | O_NOCTTY);
+    if (error)
+        return error;
+
+    L_CG("Set pressure trigger {} {} {} {}", knob, type, stall, window);
+
+    /* Kernel signals POLLPRI at most once per window */
+    error = trigger.WriteAll(fmt::format("{} {} {}", type, stall, window));
+    if (error) {
+        trigger.Close();
+        return TError(error, "Cannot set pressure trigger {}", knob);
+    }
+
+    return OK;
+}
+
 // Cpuset
 TError TCpusetSubsystem::SetCpus(TCgroup &cg, const std::string &cpus) const {
     std::string val;
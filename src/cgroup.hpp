@@ -5,6 +5,7 @@
 #include "common.hpp"
 #include "config.hpp"
 #include "util/path.hpp"
+#include "util/proc.hpp"
 
 struct TDevice;
 class TCgroup;
@@ -122,6 +123,7 @@ public:
     TError Set(const std::string &knob, const std::string &value) const;
 
     TError GetPids(const std::string &knob, std::vector<pid_t> &pids) const;
+    TError CountPids(const std::string &knob, uint64_t &count) const;
 
     TError GetInt64(const std::string &knob, int64_t &value) const;
     TError SetInt64(const std::string &knob, int64_t value) const;
@@ -247,8 +249,11 @@ class TFreezerSubsystem : public TSubsystem {
 public:
     TFreezerSubsystem() : TSubsystem(CGROUP_FREEZER, "freezer") {}
 
+    TError WaitState(const std::vector<TCgroup> &cgroups, const std::string &state) const;
     TError WaitState(const TCgroup &cg, const std::string &state) const;
+    TError Freeze(const std::vector<TCgroup> &cgroups, bool wait = true) const;
     TError Freeze(const TCgroup &cg, bool wait = true) const;
+    TError Thaw(const std::vector<TCgroup> &cgroups, bool wait = true) const;
     TError Thaw(const TCgroup &cg, bool wait = true) const;
     bool IsFrozen(const TCgroup &cg) const;
     bool IsSelfFreezing(const TCgroup &cg) const;
@@ -279,6 +284,14 @@ public:
     TCpuacctSubsystem() : TSubsystem(CGROUP_CPUACCT, "cpuacct") {}
     TError Usage(TCgroup &cg, uint64_t &value) const;
     TError SystemUsage(TCgroup &cg, uint64_t &value) const;
+
+    /* Pressure stall information: resource is cpu, memory or io */
+    bool SupportPressure() const;
+    TPath PressureKnob(const TCgroup &cg, const std::string &resource) const;
+    TError GetPressure(const TCgroup &cg, const std::string &resource, TPressure &pressure) const;
+    TError SetupPressureTrigger(const TCgroup &cg, const std::string &resource,
+                                const std::string &type, uint64_t stall,
+                                uint64_t window, TFile &trigger) const;
 };
 
 class TCpusetSubsystem : public TSubsystem {
@@ -84,6 +84,7 @@ void TClient::StartRequest() {
 }
 
 void TClient::FinishRequest() {
+    RequestFd.Close();
     ReleaseContainer();
     PORTO_ASSERT(CL == this);
     CL = nullptr;
@@ -421,9 +422,29 @@ TError TClient::ReadRequest(Porto::TPortoRequest &request) {
     if (Offset >= Buffer.size())
         Buffer.resize(Offset + 4096);
 
-    ssize_t len = recv(Fd, &Buffer[Offset], Length ? (Length - Offset) : 1, MSG_DONTWAIT);
-    if (len > 0)
+    /* Client might attach fd to request by SCM_RIGHTS */
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msghdr = {};
+    struct iovec iovec;
+
+    iovec.iov_base = &Buffer[Offset];
+    iovec.iov_len = Length ? (Length - Offset) : 1;
+    msghdr.msg_iov = &iovec;
+    msghdr.msg_iovlen = 1;
+    msghdr.msg_control = control;
+    msghdr.msg_controllen = sizeof(control);
+
+    ssize_t len = recvmsg(Fd, &msghdr, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (len > 0) {
         Offset += len;
+        for (auto cmsg = CMSG_FIRSTHDR(&msghdr); cmsg; cmsg = CMSG_NXTHDR(&msghdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+                    cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+                RequestFd.Close();
+                RequestFd.SetFd = *((int *)CMSG_DATA(cmsg));
+            }
+        }
+    }
     else if (len == 0)
         return TError("recv return zero");
     else if (errno != EAGAIN && errno != EWOULDBLOCK)
@@ -471,10 +492,20 @@ TError TClient::SendResponse(bool first) {
         return OK; /* Connection closed */
 
 next:
-    ssize_t len = send(Fd, &Buffer[Offset], Length - Offset, MSG_DONTWAIT);
-    if (len > 0)
+    ssize_t len;
+
+    if (!AttachedFd)
+        len = send(Fd, &Buffer[Offset], Length - Offset, MSG_DONTWAIT);
+    else if (Offset < AttachedOffset)
+        len = send(Fd, &Buffer[Offset], AttachedOffset - Offset, MSG_DONTWAIT);
+    else
+        len = SendAttachedFd();
+
+    if (len > 0) {
         Offset += len;
-    else if (len == 0) {
+        if (AttachedFd && Offset == AttachedOffset)
+            goto next;
+    } else if (len == 0) {
         if (!first)
             return TError("send return zero");
     } else if (errno == EPIPE) {
@@ -514,6 +545,31 @@ next:
     return TError::Queued();
 }
 
+/* Ancillary data sticks to the first byte of response */
+ssize_t TClient::SendAttachedFd() {
+    char buffer[CMSG_SPACE(sizeof(int))] = {0};
+    struct msghdr msghdr = {};
+    struct iovec iovec;
+
+    iovec.iov_base = &Buffer[Offset];
+    iovec.iov_len = Length - Offset;
+    msghdr.msg_iov = &iovec;
+    msghdr.msg_iovlen = 1;
+    msghdr.msg_control = buffer;
+    msghdr.msg_controllen = sizeof(buffer);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msghdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    *((int*)CMSG_DATA(cmsg)) = AttachedFd.Fd;
+
+    ssize_t len = sendmsg(Fd, &msghdr, MSG_DONTWAIT);
+    if (len > 0)
+        AttachedFd.Close();
+    return len;
+}
+
 TError TClient::QueueResponse(Porto::TPortoResponse &response) {
 
     if (Receiving)
@@ -523,6 +579,14 @@ TError TClient::QueueResponse(Porto::TPortoResponse &response) {
     size_t lengthSize = google::protobuf::io::CodedOutputStream::VarintSize32(length);
 
     size_t tail = Length;
+
+    if (response.has_readstream() && response.readstream().fd()) {
+        if (AttachedFd)
+            return TError(EError::Busy, "Previous fd is not sent yet");
+        AttachedFd.Swap(StreamFd);
+        AttachedOffset = tail;
+    }
+
     Length += lengthSize + length;
 
     if (Buffer.size() < Length)
@@ -541,13 +605,18 @@ TError TClient::QueueReport(const TContainerReport &report, bool async) {
     rsp.set_error(EError::Success);
     auto wait = async ? rsp.mutable_asyncwait() : rsp.mutable_wait();
     wait->set_name(report.Name);
-    if (report.State == EContainerState::UNDEFINED) {
+    if (report.Gap) {
+        wait->set_state("gap");
+        wait->set_gap(true);
+    } else if (report.State == EContainerState::UNDEFINED) {
         wait->set_state("timeout");
     } else {
         wait->set_state(TContainer::StateName(report.State));
         wait->set_st(report.State);
     }
     wait->set_when(report.When);
+    if (report.Seq)
+        wait->set_seq(report.Seq);
 
     if (!report.Label.empty()) {
         wait->set_label(report.Label);
@@ -562,26 +631,41 @@ TError TClient::QueueReport(const TContainerReport &report, bool async) {
     return QueueResponse(rsp);
 }
 
-TError TClient::MakeReport(const std::string &name, EContainerState state, bool async,
-                           const std::string &label, const std::string &value) {
+TError TClient::MakeReport(const TContainerReport &report, bool async) {
     auto lock = Lock();
     TError error;
 
     if (async) {
         if (Sending || Receiving) {
-            ReportQueue.emplace_back(name, state, time(nullptr), label, value);
+            ReportQueue.push_back(report);
             return OK;
         }
     } else
         Processing = false;
 
-    error = QueueReport({name, state, time(nullptr), label, value}, async);
+    error = QueueReport(report, async);
     if (error)
         return error;
 
     return SendResponse(true);
 }
 
+TError TClient::MakeResponse(Porto::TPortoResponse &response) {
+    auto lock = Lock();
+    TError error;
+
+    Processing = false;
+    error = QueueResponse(response);
+    if (!error && !Sending)
+        error = SendResponse(true);
+    return error;
+}
+
+TError TClient::MakeReport(const std::string &name, EContainerState state, bool async,
+                           const std::string &label, const std::string &value) {
+    return MakeReport(TContainerReport(name, state, time(nullptr), label, value), async);
+}
+
 TError TClient::Event(uint32_t events) {
     auto lock = Lock();
     TError error;
@@ -624,7 +708,8 @@ void TClient::QueueRequest() {
 
     ClientContainer->ContainerRequests++;
     Processing = true;
-    WaitRequest = Request->Req.has_wait() || Request->Req.has_asyncwait();
+    WaitRequest = Request->Req.has_wait() || Request->Req.has_asyncwait() ||
+                  Request->Req.has_readstream();
 
     QueueRpcRequest(Request);
     Request = nullptr;
@@ -99,12 +99,20 @@ public:
     void QueueRequest();
     TError SendResponse(bool first);
     TError QueueResponse(Porto::TPortoResponse &response);
+    TError MakeResponse(Porto::TPortoResponse &response);
     TError QueueReport(const TContainerReport &report, bool async);
+    TError MakeReport(const TContainerReport &report, bool async);
     TError MakeReport(const std::string &name, EContainerState state, bool async,
                       const std::string &label = "", const std::string &value = "");
 
     std::list<std::weak_ptr<TContainer>> WeakContainers;
 
+    /* Passed by SCM_RIGHTS along with next ReadStream response */
+    TFile StreamFd;
+
+    /* Received by SCM_RIGHTS along with current request */
+    TFile RequestFd;
+
 private:
     std::mutex Mutex;
     uint64_t ConnectionTime = 0;
@@ -113,6 +121,11 @@ private:
     uint64_t Offset = 0;
     std::vector<uint8_t> Buffer;
     std::unique_ptr<TRequest> Request;
+
+    TFile AttachedFd;
+    uint64_t AttachedOffset = 0;
+
+    ssize_t SendAttachedFd();
 };
 
 extern TClient SystemClient;
@@ -97,6 +97,8 @@ constexpr const char *PORTO_PLACE = "/place";
 constexpr const char *PORTO_VOLUMES = "porto_volumes";
 constexpr const char *PORTO_LAYERS = "porto_layers";
 constexpr const char *PORTO_STORAGE = "porto_storage";
+constexpr const char *PORTO_TRASH = "porto_trash";
+constexpr const char *PORTO_OBJECTS = "porto_objects";
 
 constexpr const char *PORTO_CHROOT_VOLUMES = "porto";
 
@@ -111,6 +113,9 @@ constexpr uint64_t RUN_SUBDIR_LIMIT = 100u;
 constexpr uint64_t PRIVATE_VALUE_MAX = 4096;
 constexpr uint64_t CONTAINER_COMMAND_MAX = 128 * 1024;
 
+constexpr size_t VM_STAT_PIDS_PER_THREAD = 256;
+constexpr size_t VM_STAT_MAX_THREADS = 8;
+
 constexpr const char *PORTO_NAME_CHARS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-@:.";
 constexpr const char *PORTO_PATH_CHARS = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-@:./";
 
@@ -70,6 +70,12 @@ static void DefaultConfig() {
     config().mutable_daemon()->set_memory_guarantee_reserve(std::min(2ull << 30, mem / 4)); /* 2Gb */
 
     config().mutable_daemon()->set_log_rotate_ms(1000);
+    config().mutable_daemon()->set_stats_sample_ms(0);
+    config().mutable_daemon()->set_stats_history(60);
+    config().mutable_daemon()->set_sync_share_ms(10);
+    config().mutable_daemon()->set_get_chunk_size(256);
+    config().mutable_daemon()->set_get_parallelism(4);
+    config().mutable_daemon()->set_event_journal_size(10000);
     config().mutable_daemon()->set_memory_limit(1ull << 30);
     config().mutable_daemon()->set_helpers_memory_limit(std::min(1ull << 30, mem / 2)); /* 1Gb */
     config().mutable_daemon()->set_helpers_dirty_limit(std::min(256ull << 20, mem / 4)); /* 256Mb */
@@ -134,6 +140,16 @@ static void DefaultConfig() {
     config().mutable_volumes()->set_max_total(3000);
     config().mutable_volumes()->set_place_load_limit("default: 2; /ssd: 4");
     config().mutable_volumes()->set_squashfs_compression("gzip");
+    config().mutable_volumes()->set_copy_threads(4);
+    config().mutable_volumes()->set_trash_threads(2);
+    config().mutable_volumes()->set_extract_threads(4);
+    config().mutable_volumes()->set_layer_checksum("default: md5");
+    config().mutable_volumes()->set_checksum_threads(4);
+    config().mutable_volumes()->set_layer_cache_limit("default: 0");
+    config().mutable_volumes()->set_layer_cache_high_watermark(95);
+    config().mutable_volumes()->set_layer_cache_low_watermark(85);
+    config().mutable_volumes()->set_layer_cache_period_ms(60000);
+    config().mutable_volumes()->set_stream_timeout_ms(60000);
 
     config().mutable_network()->set_device_qdisc("default: htb");
 
@@ -5,6 +5,7 @@
 #include <cstdlib>
 #include <algorithm>
 #include <condition_variable>
+#include <thread>
 
 #include "portod.hpp"
 #include "container.hpp"
@@ -46,12 +47,23 @@ std::mutex ContainersMutex;
 static std::condition_variable ContainersCV;
 std::shared_ptr<TContainer> RootContainer;
 std::map<std::string, std::shared_ptr<TContainer>> Containers;
+
+/*
+ * Inverted label index: "label" and "label=value" to registered
+ * containers sorted by name. Protected with ContainersMutex.
+ */
+static std::unordered_map<std::string, std::map<std::string, TContainer *>> LabelIndex;
 TPath ContainersKV;
 TIdMap ContainerIdMap(1, CONTAINER_ID_MAX);
 
 std::mutex CpuAffinityMutex;
 static std::vector<TPortoBitMap> CoreThreads;
 
+static std::thread StatsThread;
+static std::mutex StatsMutex;
+static std::condition_variable StatsThreadCv;
+static bool StatsThreadRun = false;
+
 static TPortoBitMap NumaNodes;
 static std::vector<TPortoBitMap> NodeThreads;
 
@@ -309,6 +321,9 @@ void TContainer::Register() {
     Containers[Name] = shared_from_this();
     if (Parent)
         Parent->Children.emplace_back(shared_from_this());
+    for (auto &it: Labels)
+        IndexLabel(it.first, it.second, true);
+    LabelsIndexed = true;
     Statistics->ContainersCreated++;
 }
 
@@ -317,6 +332,11 @@ void TContainer::Unregister() {
     Containers.erase(Name);
     if (Parent)
         Parent->Children.remove(shared_from_this());
+    if (LabelsIndexed) {
+        for (auto &it: Labels)
+            IndexLabel(it.first, it.second, false);
+        LabelsIndexed = false;
+    }
 
     TError error = ContainerIdMap.Put(Id);
     if (error)
@@ -330,15 +350,15 @@ TContainer::TContainer(std::shared_ptr<TContainer> parent, int id, const std::st
     Parent(parent), Level(parent ? parent->Level + 1 : 0), Id(id), Name(name),
     FirstName(!parent ? "" : parent->IsRoot() ? name : name.substr(parent->Name.length() + 1)),
     Stdin(0), Stdout(1), Stderr(2),
-    ClientsCount(0), ContainerRequests(0), OomEvents(0)
+    ClientsCount(0), ContainerRequests(0), OomEvents(0), OomKillsStamp(0), PressureEvents(0)
 {
     Statistics->ContainersCount++;
     RealCreationTime = time(nullptr);
 
     memset(&TaintFlags, 0, sizeof(TaintFlags));
 
-    std::fill(PropSet, PropSet + sizeof(PropSet), false);
-    std::fill(PropDirty, PropDirty + sizeof(PropDirty), false);
+    PropSet.reset();
+    PropDirty.reset();
 
 
     Stdin.SetOutside("/dev/null");
@@ -640,6 +660,20 @@ TError TContainer::Restore(const TKeyValue &kv, std::shared_ptr<TContainer> &ct)
         if (error)
             goto err;
 
+        error = ct->PreparePressureMonitor();
+        if (error)
+            L_WRN("Cannot restore pressure monitor: {}", error);
+
+        /* Captured text is lost, pipes are kept open by tasks */
+        error = ct->Stdout.OpenRing(ct, true);
+        if (!error)
+            error = ct->Stderr.OpenRing(ct, true);
+        if (error)
+            L_WRN("Cannot restore stdout ring: {}", error);
+
+        ct->Stdout.WatchRotate(ct);
+        ct->Stderr.WatchRotate(ct);
+
         /* Kernel without group rt forbids moving RT tasks in to cpu cgroup */
         if (ct->Task.Pid && !CpuSubsystem.HasRtGroup) {
             auto cpuCg = ct->GetCgroup(CpuSubsystem);
@@ -703,9 +737,12 @@ TError TContainer::Restore(const TKeyValue &kv, std::shared_ptr<TContainer> &ct)
     if (ct->State == EContainerState::DEAD && ct->AutoRespawn)
         ct->ScheduleRespawn();
 
+    if (ct->State == EContainerState::DEAD)
+        ct->ScheduleAgedDestroy();
+
     /* Do not apply dynamic properties to dead container */
     if (ct->State == EContainerState::DEAD)
-        memset(ct->PropDirty, 0, sizeof(ct->PropDirty));
+        ct->PropDirty.reset();
 
     error = ct->Save();
     if (error)
@@ -819,11 +856,52 @@ TError TContainer::GetLabel(const std::string &label, std::string &value) const
     return TError(EError::LabelNotFound, "Label {} is not set", label);
 }
 
+void TContainer::IndexLabel(const std::string &label, const std::string &value, bool add) {
+    for (auto &key: {label, label + "=" + value}) {
+        if (add) {
+            LabelIndex[key][Name] = this;
+        } else {
+            auto it = LabelIndex.find(key);
+            if (it != LabelIndex.end()) {
+                it->second.erase(Name);
+                if (it->second.empty())
+                    LabelIndex.erase(it);
+            }
+        }
+    }
+}
+
+static const std::map<std::string, TContainer *> *FindLabelIndex(const std::string &key) {
+    auto it = LabelIndex.find(key);
+    return it != LabelIndex.end() ? &it->second : nullptr;
+}
+
+const std::map<std::string, TContainer *> *TContainer::FindLabel(const std::string &label) {
+    PORTO_LOCKED(ContainersMutex);
+    /* Index also holds "label=value" keys, label names never contain '=' */
+    if (label.find('=') != std::string::npos)
+        return nullptr;
+    return FindLabelIndex(label);
+}
+
+const std::map<std::string, TContainer *> *TContainer::FindLabel(const std::string &label,
+                                                                 const std::string &value) {
+    PORTO_LOCKED(ContainersMutex);
+    if (label.find('=') != std::string::npos)
+        return nullptr;
+    return FindLabelIndex(label + "=" + value);
+}
+
 void TContainer::SetLabel(const std::string &label, const std::string &value) {
+    auto it = Labels.find(label);
+    if (LabelsIndexed && it != Labels.end())
+        IndexLabel(label, it->second, false);
     if (value.empty())
         Labels.erase(label);
     else
         Labels[label] = value;
+    if (LabelsIndexed && !value.empty())
+        IndexLabel(label, value, true);
     SetProp(EProperty::LABELS);
 }
 
@@ -851,11 +929,17 @@ TError TContainer::IncLabel(const std::string &label, int64_t &result, int64_t a
 
     val += add;
 
+    if (LabelsIndexed && it != Labels.end())
+        IndexLabel(label, it->second, false);
+
     if (it == Labels.end())
         Labels[label] = std::to_string(val);
     else
         it->second = std::to_string(val);
 
+    if (LabelsIndexed)
+        IndexLabel(label, Labels[label], true);
+
     result = val;
 
     SetProp(EProperty::LABELS);
@@ -1013,6 +1097,9 @@ void TContainer::SetState(EContainerState next) {
     if (next == EContainerState::DEAD && AutoRespawn)
         ScheduleRespawn();
 
+    if (next == EContainerState::DEAD)
+        ScheduleAgedDestroy();
+
     DowngradeStateLock();
 
     if (prev == EContainerState::RUNNING || next == EContainerState::RUNNING) {
@@ -1144,7 +1231,7 @@ TError TContainer::GetPidFor(pid_t pidns, pid_t &pid) const {
     return error;
 }
 
-TError TContainer::GetThreadCount(uint64_t &count) const {
+TError TContainer::CountThreads(uint64_t &count) const {
     if (IsRoot()) {
         struct sysinfo si;
         if (sysinfo(&si) < 0)
@@ -1160,7 +1247,7 @@ TError TContainer::GetThreadCount(uint64_t &count) const {
     return OK;
 }
 
-TError TContainer::GetProcessCount(uint64_t &count) const {
+TError TContainer::CountProcesses(uint64_t &count) const {
     TError error;
     if (IsRoot()) {
         struct stat st;
@@ -1175,8 +1262,217 @@ TError TContainer::GetProcessCount(uint64_t &count) const {
     return OK;
 }
 
-TError TContainer::GetVmStat(TVmStat &stat) const {
+const char *TStatsHistory::ColumnName[NR_COLUMNS] = {
+    "time", P_CPU_USAGE, P_CPU_SYSTEM, P_MEMORY_USAGE, P_IO_READ, P_IO_WRITE, P_IO_OPS,
+    P_THREAD_COUNT, P_PROCESS_COUNT,
+};
+
+void TStatsHistory::Push(const TSample &sample, size_t capacity) {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    if (Columns[TIME].size() != capacity) {
+        for (auto &column: Columns)
+            column.assign(capacity, 0);
+        Head = 0;
+        Size = 0;
+    }
+
+    for (int i = 0; i < NR_COLUMNS; i++)
+        Columns[i][Head] = sample[i];
+
+    Head = (Head + 1) % capacity;
+    Size = std::min(Size + 1, capacity);
+}
+
+bool TStatsHistory::Last(TSample &sample) const {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    if (!Size)
+        return false;
+
+    size_t index = Index(0);
+    for (int i = 0; i < NR_COLUMNS; i++)
+        sample[i] = Columns[i][index];
+    return true;
+}
+
+/*
+ * Rate per second between last sample and the oldest one within window,
+ * zero window means the last sampling period. Counter reset gives zero.
+ */
+double TStatsHistory::Rate(EColumn column, uint64_t window) const {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    if (Size < 2)
+        return 0;
+
+    size_t last = Index(0);
+    size_t first = Index(1);
+
+    for (size_t age = 2; age < Size; age++) {
+        size_t index = Index(age);
+        if (Columns[TIME][last] - Columns[TIME][index] > window)
+            break;
+        first = index;
+    }
+
+    uint64_t time = Columns[TIME][last] - Columns[TIME][first];
+    uint64_t end = Columns[column][last];
+    uint64_t begin = Columns[column][first];
+
+    if (!time || end < begin)
+        return 0;
+
+    return (double)(end - begin) * 1000 / time;
+}
+
+void TStatsHistory::Series(EColumn column, std::vector<std::pair<uint64_t, uint64_t>> &series) const {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    for (size_t age = Size; age > 0; age--) {
+        size_t index = Index(age - 1);
+        series.emplace_back(Columns[TIME][index], Columns[column][index]);
+    }
+}
+
+void TStatsHistory::Clear() {
+    std::lock_guard<std::mutex> lock(Mutex);
+    Size = 0;
+}
+
+bool TContainer::GetStatsSample(TStatsHistory::TSample &sample) const {
+    uint64_t period = config().daemon().stats_sample_ms();
+    return period && Stats.Last(sample) &&
+        GetCurrentTimeMs() - sample[TStatsHistory::TIME] < period * 2;
+}
+
+TError TContainer::GetThreadCount(uint64_t &count) const {
+    TStatsHistory::TSample sample;
+
+    if (GetStatsSample(sample)) {
+        if (SyncedTime >= sample[TStatsHistory::TIME])
+            count = SyncedThreads;
+        else
+            count = sample[TStatsHistory::THREADS];
+        return OK;
+    }
+    return CountThreads(count);
+}
+
+TError TContainer::GetProcessCount(uint64_t &count) const {
+    TStatsHistory::TSample sample;
+
+    if (GetStatsSample(sample)) {
+        if (SyncedTime >= sample[TStatsHistory::TIME])
+            count = SyncedProcesses;
+        else
+            count = sample[TStatsHistory::PROCESSES];
+        return OK;
+    }
+    return CountProcesses(count);
+}
+
+/* Refresh counts for sync get without touching sampler history */
+void TContainer::SyncCounts() {
+    uint64_t threads, processes;
+
+    if (CountThreads(threads) || CountProcesses(processes))
+        return;
+
+    SyncedThreads = threads;
+    SyncedProcesses = processes;
+    SyncedTime = GetCurrentTimeMs();
+}
+
+/* Reads all sampled counters in one pass */
+void TContainer::SampleStats() {
+    TStatsHistory::TSample sample = {};
+
+    if (CountThreads(sample[TStatsHistory::THREADS]) ||
+            CountProcesses(sample[TStatsHistory::PROCESSES]))
+        return;
+
+    if (Controllers & CGROUP_CPUACCT) {
+        auto cg = GetCgroup(CpuacctSubsystem);
+        (void)CpuacctSubsystem.Usage(cg, sample[TStatsHistory::CPU_USAGE]);
+        (void)CpuacctSubsystem.SystemUsage(cg, sample[TStatsHistory::CPU_SYSTEM]);
+    }
+
+    if (Controllers & CGROUP_MEMORY) {
+        auto cg = GetCgroup(MemorySubsystem);
+        (void)MemorySubsystem.Usage(cg, sample[TStatsHistory::MEMORY_USAGE]);
+    }
+
+    if (Controllers & CGROUP_BLKIO) {
+        auto cg = GetCgroup(BlkioSubsystem);
+        TUintMap bytes, ops;
+
+        if (!BlkioSubsystem.GetIoStat(cg, TBlkioSubsystem::IoStat::Full, bytes)) {
+            sample[TStatsHistory::IO_READ] = bytes["hw r"];
+            sample[TStatsHistory::IO_WRITE] = bytes["hw w"];
+        }
+        if (!BlkioSubsystem.GetIoStat(cg, TBlkioSubsystem::IoStat::Iops, ops))
+            sample[TStatsHistory::IO_OPS] = ops["hw"];
+    }
+
+    sample[TStatsHistory::TIME] = GetCurrentTimeMs();
+    Stats.Push(sample, std::max(config().daemon().stats_history(), 2u));
+}
+
+void TContainer::StatsSampler() {
+    uint64_t period = config().daemon().stats_sample_ms();
+    std::vector<std::shared_ptr<TContainer>> plan;
+
+    SetProcessName("portod-ST");
+
+    auto lock = std::unique_lock<std::mutex>(StatsMutex);
+    while (StatsThreadRun) {
+        lock.unlock();
+
+        auto containers_lock = LockContainers();
+        for (auto &it: Containers)
+            if (it.second->State != EContainerState::STOPPED)
+                plan.push_back(it.second);
+        containers_lock.unlock();
+
+        for (auto &ct: plan)
+            ct->SampleStats();
+        plan.clear();
+
+        lock.lock();
+        StatsThreadCv.wait_for(lock, std::chrono::milliseconds(period));
+    }
+}
+
+void TContainer::StartStatsSampler() {
+    if (!config().daemon().stats_sample_ms())
+        return;
+    StatsThreadRun = true;
+    StatsThread = std::thread(&TContainer::StatsSampler);
+}
+
+void TContainer::StopStatsSampler() {
+    if (!StatsThread.joinable())
+        return;
+    auto lock = std::unique_lock<std::mutex>(StatsMutex);
+    StatsThreadRun = false;
+    lock.unlock();
+    StatsThreadCv.notify_all();
+    StatsThread.join();
+}
+
+static TVmStatCache VmStatCache;
+
+/*
+ * Brief stat reads only statm: count, size, used and anon.
+ * While stats sampler is enabled full per-pid stats are cached by pid for
+ * one sample period, reused pid might show stale stat until it expires.
+ * Large containers are parsed in parallel.
+ */
+TError TContainer::GetVmStat(TVmStat &stat, bool brief) const {
     auto cg = GetCgroup(FreezerSubsystem);
+    uint64_t ttl = config().daemon().stats_sample_ms();
+    uint64_t now = GetCurrentTimeMs();
     std::vector<pid_t> pids;
     TError error;
 
@@ -1184,8 +1480,46 @@ TError TContainer::GetVmStat(TVmStat &stat) const {
     if (error)
         return error;
 
-    for (auto pid: pids)
-        stat.Parse(pid);
+    auto parse = [&](size_t begin, size_t end, TVmStat &result) {
+        for (size_t i = begin; i < end; i++) {
+            pid_t pid = pids[i];
+
+            if (brief) {
+                (void)result.ParseStatm(pid);
+                continue;
+            }
+
+            if (ttl && VmStatCache.Get(pid, now, ttl, result))
+                continue;
+
+            TVmStat st;
+            if (st.Parse(pid))
+                continue;
+            if (ttl)
+                VmStatCache.Put(pid, now, ttl, st);
+            result.Add(st);
+        }
+    };
+
+    size_t chunks = (pids.size() + VM_STAT_PIDS_PER_THREAD - 1) / VM_STAT_PIDS_PER_THREAD;
+
+    if (chunks < 2) {
+        parse(0, pids.size(), stat);
+        return OK;
+    }
+
+    /* Helpers come from persistent RO pool, caller parses chunks too */
+    std::vector<TVmStat> results(chunks);
+
+    RunParallel(chunks, 1, std::min<size_t>(GetNumCores(), VM_STAT_MAX_THREADS),
+                [&](size_t index) {
+        parse(index * VM_STAT_PIDS_PER_THREAD,
+              std::min(pids.size(), (index + 1) * VM_STAT_PIDS_PER_THREAD),
+              results[index]);
+    });
+
+    for (auto &result: results)
+        stat.Add(result);
 
     return OK;
 }
@@ -1193,74 +1527,107 @@ TError TContainer::GetVmStat(TVmStat &stat) const {
 void TContainer::CollectOomKills(bool event) {
 
     /*
-     * Kernel sends OOM events before actual OOM kill into each cgroup in subtree.
-     * We turn these events into speculative OOM kill.
+     * Kernel sends OOM events before actual OOM kill into each cgroup in subtree
+     * and counts kill only in cgroup of victim. Thus every container could account
+     * own kills and speculative kills from events by itself, in O(depth).
+     *
+     * Speculative kill is added only if there is no pending one in subtree or
+     * at parents and later moves into container where kill actually happened.
      */
 
-    auto plan = Subtree();
-    for (auto p = Parent; event && p; p = p->Parent)
-        plan.push_front(p);
+    if (!HasResources() || !(Controllers & CGROUP_MEMORY))
+        return;
 
-    auto total = OomKillsTotal;
+    auto cg = GetCgroup(MemorySubsystem);
+    uint64_t kills = 0;
 
-    for (auto &ct: plan) {
-        if (!HasResources() || !(ct->Controllers & CGROUP_MEMORY))
-            continue;
-
-        auto cg = ct->GetCgroup(MemorySubsystem);
-        uint64_t kills = 0;
+    if (MemorySubsystem.GetOomKills(cg, kills))
+        return;
 
-        if (MemorySubsystem.GetOomKills(cg, kills))
-            continue;
+    auto lock = LockContainers();
 
-        auto lock = LockContainers();
+    auto speculate = [](TContainer *ct, uint64_t add, uint64_t sub) {
+        for (; ct; ct = ct->Parent.get())
+            ct->OomKillsSpeculative = ct->OomKillsSpeculative + add -
+                std::min(sub, ct->OomKillsSpeculative + add);
+    };
 
-        /* Collect this kill later from child event. */
-        if (event && kills > ct->OomKillsRaw && ct->Level > Level)
-            break;
+    if (kills > OomKillsRaw) {
+        L_EVT("OOM Kill in CT{}:{}", Id, Name);
 
-        /* Already have speculative kill at parent, ignore this event. */
-        if (event && ct->OomKills > ct->OomKillsRaw && ct->Level < Level)
-            event = false;
+        /* Own speculative kills became real */
+        if (OomKills > OomKillsRaw)
+            speculate(this, 0, std::min(kills, OomKills) - OomKillsRaw);
 
-        if (kills > ct->OomKillsRaw)
-            L_EVT("OOM Kill in CT{}:{}", ct->Id, ct->Name);
+        OomKillsRaw = kills;
+    } else if (event && !OomKillsSpeculative) {
+        bool pending = false;
 
-        ct->OomKillsRaw = kills;
+        for (auto p = Parent; p && !pending; p = p->Parent)
+            pending = p->OomKills > p->OomKillsRaw;
 
-        if (event && ct.get() == this &&
-                OomKills == OomKillsRaw &&
-                OomKillsTotal == total) {
+        if (!pending && OomKills == OomKillsRaw) {
             L_EVT("Speculative OOM Kill in CT{}:{}", Id, Name);
+            speculate(this, 1, 0);
             kills++;
         }
+    }
 
-        /* Nothing new happened. */
-        if (ct->OomKills >= kills)
-            continue;
+    /* Nothing new happened. */
+    if (OomKills >= kills)
+        return;
 
-        kills -= ct->OomKills;
+    kills -= OomKills;
 
-        ct->OomKills += kills;
-        ct->SetProp(EProperty::OOM_KILLS);
+    OomKills += kills;
+    SetProp(EProperty::OOM_KILLS);
 
-        ct->OomKillsTotal += kills;
-        ct->SetProp(EProperty::OOM_KILLS_TOTAL);
+    OomKillsTotal += kills;
+    SetProp(EProperty::OOM_KILLS_TOTAL);
 
-        for (auto p = ct->Parent; kills && p ; p = p->Parent) {
-            if (p->OomKills > p->OomKillsRaw) {
-                L_EVT("Move speculative OOM Kill from CT{}:{} into CT{}:{}", p->Id, p->Name, ct->Id, ct->Name);
-                p->OomKills--;
-                kills--;
-            }
-            p->OomKillsTotal += kills;
-            p->SetProp(EProperty::OOM_KILLS_TOTAL);
+    for (auto p = Parent; kills && p ; p = p->Parent) {
+        if (p->OomKills > p->OomKillsRaw) {
+            L_EVT("Move speculative OOM Kill from CT{}:{} into CT{}:{}", p->Id, p->Name, Id, Name);
+            speculate(p.get(), 0, 1);
+            p->OomKills--;
+            kills--;
         }
+        p->OomKillsTotal += kills;
+        p->SetProp(EProperty::OOM_KILLS_TOTAL);
+    }
 
-        lock.unlock();
+    lock.unlock();
+
+    for (auto p = shared_from_this(); p ; p = p->Parent)
+        p->Save();
+}
+
+/*
+ * Kills without memcg OOM event, for example by global OOM,
+ * are visible only in counters. Rescan subtree only if system-wide
+ * counter has been changed since last time.
+ */
+void TContainer::SyncOomKills() {
+    uint64_t stamp = 0;
+    bool valid = !GetSystemOomKills(stamp);
 
-        for (auto p = ct; p ; p = p->Parent)
-            p->Save();
+    SyncOomKills(stamp, valid);
+}
+
+/* Same with system-wide counter already read once per sync pass */
+void TContainer::SyncOomKills(uint64_t stamp, bool valid) {
+    if (valid && stamp == OomKillsStamp)
+        return;
+
+    auto subtree = Subtree();
+
+    for (auto &ct: subtree)
+        ct->CollectOomKills();
+
+    /* Nested subtrees are in sync too */
+    if (valid) {
+        for (auto &ct: subtree)
+            ct->OomKillsStamp = stamp;
     }
 }
 
@@ -1914,29 +2281,29 @@ TError TContainer::ApplyDynamicProperties() {
     }
 
     if (TestClearPropDirty(EProperty::IO_LIMIT)) {
-        if (IoBpsLimit.count("fs")) {
-            error = MemorySubsystem.SetIoLimit(memcg, IoBpsLimit["fs"]);
+        if (Sparse().IoBpsLimit.count("fs")) {
+            error = MemorySubsystem.SetIoLimit(memcg, Sparse().IoBpsLimit.at("fs"));
             if (error) {
                 if (error.Errno != EINVAL)
                     L_ERR("Can't set {}: {}", P_IO_LIMIT, error);
                 return error;
             }
         }
-        error = BlkioSubsystem.SetIoLimit(blkcg, RootPath, IoBpsLimit);
+        error = BlkioSubsystem.SetIoLimit(blkcg, RootPath, Sparse().IoBpsLimit);
         if (error)
             return error;
     }
 
     if (TestClearPropDirty(EProperty::IO_OPS_LIMIT)) {
-        if (IoOpsLimit.count("fs")) {
-            error = MemorySubsystem.SetIopsLimit(memcg, IoOpsLimit["fs"]);
+        if (Sparse().IoOpsLimit.count("fs")) {
+            error = MemorySubsystem.SetIopsLimit(memcg, Sparse().IoOpsLimit.at("fs"));
             if (error) {
                 if (error.Errno != EINVAL)
                     L_ERR("Can't set {}: {}", P_IO_OPS_LIMIT, error);
                 return error;
             }
         }
-        error = BlkioSubsystem.SetIoLimit(blkcg, RootPath, IoOpsLimit, true);
+        error = BlkioSubsystem.SetIoLimit(blkcg, RootPath, Sparse().IoOpsLimit, true);
         if (error)
             return error;
     }
@@ -2107,6 +2474,78 @@ TError TContainer::PrepareOomMonitor() {
     return error;
 }
 
+void TContainer::ShutdownPressure() {
+    for (auto &source: PressureSources) {
+        EpollLoop->RemoveSource(source->Fd);
+        PORTO_ASSERT(source->Fd > 2);
+        close(source->Fd);
+    }
+    PressureSources.clear();
+}
+
+TError TContainer::PreparePressureMonitor() {
+    TError error;
+
+    if (IsRoot() || Sparse().PressureTrigger.empty())
+        return OK;
+
+    if (!CpuacctSubsystem.SupportPressure())
+        return TError(EError::NotSupported, "Pressure stall information is not supported");
+
+    auto cg = GetCgroup(CpuacctSubsystem);
+
+    for (auto &trigger: Sparse().PressureTrigger) {
+        uint64_t stall, window;
+        TFile file;
+
+        error = StringToUint64(trigger[2], stall);
+        if (!error)
+            error = StringToUint64(trigger[3], window);
+        if (!error)
+            error = CpuacctSubsystem.SetupPressureTrigger(cg, trigger[0], trigger[1],
+                                                          stall, window, file);
+        if (error)
+            break;
+
+        PORTO_ASSERT(file.Fd > 2);
+
+        auto source = std::make_shared<TEpollSource>(file.Fd, EPOLL_EVENT_PRESSURE, shared_from_this());
+        error = EpollLoop->AddSource(source);
+        if (error)
+            break;
+
+        file.SetFd = -1;
+        PressureSources.push_back(source);
+    }
+
+    if (error)
+        ShutdownPressure();
+
+    return error;
+}
+
+void TContainer::RecvPressureEvent(int fd) {
+    for (unsigned i = 0; i < PressureSources.size(); i++) {
+        if (PressureSources[i]->Fd != fd)
+            continue;
+
+        auto &trigger = Sparse().PressureTrigger[i];
+
+        PressureEvents++;
+        Statistics->ContainersPressure++;
+        L_EVT("Pressure {} {} stall {} within {} in CT{}:{}",
+              trigger[0], trigger[1], trigger[2], trigger[3], Id, Name);
+
+        TEvent e(EEventType::Pressure, shared_from_this());
+        e.Pressure.Resource = trigger[0];
+        e.Pressure.Action = trigger.size() > 4 ? trigger[4] : "event";
+        EventQueue->Add(0, e);
+        return;
+    }
+
+    L_WRN("Unknown pressure trigger fd {} in CT{}:{}", fd, Id, Name);
+}
+
 TError TContainer::ApplyDeviceConf() const {
     TError error;
 
@@ -2150,9 +2589,9 @@ TError TContainer::SetSymlink(const TPath &symlink, const TPath &target) {
 
     if (!error) {
         if (target)
-            Symlink[symlink] = target;
-        else
-            Symlink.erase(symlink);
+            MutableSparse().Symlink[symlink] = target;
+        else if (SparseProps)
+            SparseProps->Symlink.erase(symlink);
         SetProp(EProperty::SYMLINK);
     }
 
@@ -2387,7 +2826,7 @@ TError TContainer::PrepareTask(TTaskEnv &TaskEnv) {
     TaskEnv.QuadroFork = !JobMode && !OsMode && !IsMeta();
 
     TaskEnv.Mnt.BindMounts = BindMounts;
-    TaskEnv.Mnt.Symlink = Symlink;
+    TaskEnv.Mnt.Symlink = Sparse().Symlink;
 
     /* legacy kludge */
     if (BindDns && !TaskEnv.Mnt.Root.IsRoot()) {
@@ -2458,7 +2897,7 @@ TError TContainer::PrepareTask(TTaskEnv &TaskEnv) {
                           TaskEnv.Mnt.BindMounts.size() ||
                           (Hostname.size() && HasProp(EProperty::HOSTNAME)) ||
                           ResolvConf.size() ||
-                          EtcHosts.size() ||
+                          Sparse().EtcHosts.size() ||
                           !TaskEnv.Mnt.Root.IsRoot() ||
                           TaskEnv.Mnt.RootRo ||
                           !TaskEnv.Mnt.Systemd.empty();
@@ -2560,7 +2999,7 @@ TError TContainer::StartTask() {
         return OK;
 
     /* After restart apply all set dynamic properties */
-    memcpy(PropDirty, PropSet, sizeof(PropDirty));
+    PropDirty = PropSet;
 
     /* Applied by starting task */
     TestClearPropDirty(EProperty::RESOLV_CONF);
@@ -2581,8 +3020,19 @@ TError TContainer::StartTask() {
     if (IsMeta() && !Isolate && NetInherit && !TaskEnv.NewMountNs)
         return OK;
 
+    error = Stdout.OpenRing(shared_from_this());
+    if (!error)
+        error = Stderr.OpenRing(shared_from_this());
+    if (error)
+        return error;
+
     error = TaskEnv.Start();
 
+    if (!error) {
+        Stdout.WatchRotate(shared_from_this());
+        Stderr.WatchRotate(shared_from_this());
+    }
+
     /* Always report OOM stuation if any */
     if (error && RecvOomEvents())
         error = TError(EError::ResourceNotAvailable, "OOM at container {} start: {}", Name, error);
@@ -2914,6 +3364,12 @@ TError TContainer::PrepareRuntimeResources() {
         return error;
     }
 
+    error = PreparePressureMonitor();
+    if (error) {
+        L_ERR("Cannot prepare pressure monitor: {}", error);
+        return error;
+    }
+
     error = UpdateSoftLimit();
     if (error) {
         L_ERR("Cannot update memory soft limit: {}", error);
@@ -2930,6 +3386,8 @@ void TContainer::FreeRuntimeResources() {
 
     CollectOomKills();
     ShutdownOom();
+    ShutdownPressure();
+    Stats.Clear();
 
     error = UpdateSoftLimit();
     if (error)
@@ -3226,12 +3684,15 @@ TError TContainer::Pause() {
     if (!(Controllers & CGROUP_FREEZER))
         return TError(EError::NotSupported, "Cannot pause without freezer");
 
-    auto cg = GetCgroup(FreezerSubsystem);
-    TError error = FreezerSubsystem.Freeze(cg);
+    /* Freezing propagates down, sub-containers keep own self-freezing state */
+    auto subtree = Subtree();
+    std::vector<TCgroup> cgroups = { GetCgroup(FreezerSubsystem) };
+
+    TError error = FreezerSubsystem.Freeze(cgroups);
     if (error)
         return error;
 
-    for (auto &ct: Subtree()) {
+    for (auto &ct: subtree) {
         if (ct->State & (EContainerState::RUNNING | EContainerState::META)) {
             ct->SetState(EContainerState::PAUSED);
             ct->PropagateCpuLimit();
@@ -3255,24 +3716,34 @@ TError TContainer::Resume() {
     if (!FreezerSubsystem.IsSelfFreezing(cg))
         return TError(EError::InvalidState, "Container not paused");
 
-    TError error = FreezerSubsystem.Thaw(cg);
+    /* Thaw self-frozen sub-containers in one batch, subtree lists childs first */
+    auto subtree = Subtree();
+    std::vector<TCgroup> cgroups;
+
+    for (auto it = subtree.rbegin(); it != subtree.rend(); ++it) {
+        auto cg = (*it)->GetCgroup(FreezerSubsystem);
+        if (it->get() == this || FreezerSubsystem.IsSelfFreezing(cg))
+            cgroups.push_back(cg);
+    }
+
+    TError error = FreezerSubsystem.Thaw(cgroups);
     if (error)
-        return error;
+        L_WRN("Cannot thaw {}: {}", Name, error);
 
-    for (auto &ct: Subtree()) {
-        auto cg = ct->GetCgroup(FreezerSubsystem);
-        if (FreezerSubsystem.IsSelfFreezing(cg))
-            FreezerSubsystem.Thaw(cg, false);
+    /* After partial failure resume containers which are thawed anyway */
+    for (auto &ct: subtree) {
+        if (error && FreezerSubsystem.IsFrozen(ct->GetCgroup(FreezerSubsystem)))
+            continue;
         if (ct->State == EContainerState::PAUSED) {
             ct->SetState(IsMeta() ? EContainerState::META : EContainerState::RUNNING);
             ct->PropagateCpuLimit();
         }
-        error = ct->Save();
-        if (error)
-            L_ERR("Cannot save state after resume: {}", error);
+        TError err = ct->Save();
+        if (err)
+            L_ERR("Cannot save state after resume: {}", err);
     }
 
-    return OK;
+    return error;
 }
 
 TError TContainer::MayRespawn() {
@@ -3307,6 +3778,15 @@ TError TContainer::ScheduleRespawn() {
     return error;
 }
 
+/* Handler checks deadline again, changed aging_time schedules new event */
+void TContainer::ScheduleAgedDestroy() {
+    uint64_t now = GetCurrentTimeMs();
+    uint64_t due = (DeathTime ? DeathTime : now) + AgingTime;
+
+    TEvent e(EEventType::DestroyAgedContainer, shared_from_this());
+    EventQueue->Add(due > now ? due - now : 0, e);
+}
+
 TError TContainer::Respawn() {
     TError error;
 
@@ -3406,13 +3886,38 @@ void TContainer::SyncProperty(const std::string &name) {
     PORTO_ASSERT(IsStateLockedRead());
     if (StringStartsWith(name, "net_") && Net)
         Net->SyncStat();
-    if (StringStartsWith(name, "oom_kills"))
+    TStatsHistory::TSample sample;
+    if ((name == P_PROCESS_COUNT || name == P_THREAD_COUNT) && GetStatsSample(sample))
+        SyncCounts();
+    if (name == P_OOM_KILLS)
         CollectOomKills();
+    else if (name == P_OOM_KILLS_TOTAL)
+        SyncOomKills();
 }
 
 void TContainer::SyncPropertiesAll() {
     TNetwork::SyncAllStat();
-    RootContainer->CollectOomKills();
+    RootContainer->SyncOomKills();
+}
+
+/* Refresh networks and OOM counters only for given containers */
+void TContainer::SyncProperties(const std::list<std::shared_ptr<TContainer>> &containers) {
+    std::list<std::shared_ptr<TNetwork>> nets;
+
+    for (auto &ct: containers) {
+        ct->LockStateRead();
+        if (ct->Net)
+            nets.push_back(ct->Net);
+        ct->UnlockState();
+    }
+
+    TNetwork::SyncStats(nets);
+
+    uint64_t stamp = 0;
+    bool valid = !GetSystemOomKills(stamp);
+
+    for (auto &ct: containers)
+        ct->SyncOomKills(stamp, valid);
 }
 
 /* property -> name[index] */
@@ -3495,51 +4000,50 @@ TError TContainer::HasProperty(const std::string &property) const {
 
 TError TContainer::GetProperty(const std::string &property,
                                std::string &value) const {
-    std::string name, index;
-    TError error;
+    TPropertyRef ref;
 
-    error = ParsePropertyName(property, name, index);
-    if (error)
-        return error;
+    ref.Resolve(property);
 
-    if (index.empty()) {
-        auto dot = property.find('.');
+    return GetProperty(ref, value);
+}
 
-        if (dot != std::string::npos) {
-            std::string type = property.substr(0, dot);
+TError TContainer::GetProperty(const TPropertyRef &ref,
+                               std::string &value) const {
+    TError error;
 
-            if (type.find_first_not_of(PORTO_LABEL_PREFIX_CHARS) == std::string::npos) {
-                auto lock = LockContainers();
-                return GetLabel(property, value);
-            }
+    if (ref.Error)
+        return ref.Error;
 
-            if (State == EContainerState::STOPPED)
-                return TError(EError::InvalidState,
-                        "Not available in stopped state: " + property);
-            for (auto subsys: Subsystems) {
-                if (subsys->Type == type) {
-                    auto cg = GetCgroup(*subsys);
-                    if (!cg.Has(property))
-                        break;
-                    return cg.Get(property, value);
-                }
+    if (!ref.Prop) {
+        auto &property = ref.Property;
+
+        if (ref.IsLabel) {
+            auto lock = LockContainers();
+            return GetLabel(property, value);
+        }
+
+        if (State == EContainerState::STOPPED)
+            return TError(EError::InvalidState,
+                    "Not available in stopped state: " + property);
+        for (auto subsys: Subsystems) {
+            if (subsys->Type == ref.Type) {
+                auto cg = GetCgroup(*subsys);
+                if (!cg.Has(property))
+                    break;
+                return cg.Get(property, value);
             }
-            return TError(EError::InvalidProperty,
-                    "Unknown cgroup attribute: " + property);
         }
+        return TError(EError::InvalidProperty,
+                "Unknown cgroup attribute: " + property);
     }
 
-    auto it = ContainerProperties.find(name);
-    if (it == ContainerProperties.end())
-        return TError(EError::InvalidProperty,
-                              "Unknown container property: " + name);
-    auto prop = it->second;
+    auto prop = ref.Prop;
 
     CT = const_cast<TContainer *>(this);
     error = prop->CanGet();
     if (!error) {
-        if (index.length())
-            error = prop->GetIndexed(index, value);
+        if (ref.Index.length())
+            error = prop->GetIndexed(ref.Index, value);
         else
             error = prop->Get(value);
     }
@@ -3724,7 +4228,7 @@ TError TContainer::Load(const Porto::TContainer &spec) {
     return error;
 }
 
-void TContainer::Dump(const std::vector<std::string> &props, Porto::TContainer &spec) {
+void TContainer::Dump(const std::vector<TPropertyRef> &props, Porto::TContainer &spec) {
     PORTO_ASSERT(!CT);
     CT = this;
     LockStateRead();
@@ -3736,12 +4240,11 @@ void TContainer::Dump(const std::vector<std::string> &props, Porto::TContainer &
         }
     } else {
         for (auto &p: props) {
-            auto it = ContainerProperties.find(p);
-            if (it == ContainerProperties.end()) {
-                TError(EError::InvalidProperty, "Unknown property {}", p).Dump(*spec.add_error());
+            auto prop = p.Prop;
+            if (!prop || p.Index.size()) {
+                TError(EError::InvalidProperty, "Unknown property {}", p.Property).Dump(*spec.add_error());
                 continue;
             }
-            auto prop = it->second;
             if (!prop->CanGet())
                 prop->Dump(spec);
         }
@@ -4165,6 +4668,10 @@ void TContainer::Event(const TEvent &event) {
         break;
     }
 
+    case EEventType::StreamFollow:
+        TStdStream::FollowEvent(event.Stream.Id);
+        break;
+
     case EEventType::DestroyAgedContainer:
     {
         if (ct && !CL->LockContainer(ct)) {
@@ -4182,6 +4689,22 @@ void TContainer::Event(const TEvent &event) {
         break;
     }
 
+    case EEventType::Pressure:
+    {
+        if (ct && !CL->LockContainer(ct)) {
+            TContainerWaiter::ReportAll(*ct, "pressure", event.Pressure.Resource);
+
+            if (event.Pressure.Action == "kill" &&
+                    ct->State == EContainerState::RUNNING) {
+                L_ACT("Kill CT{}:{} at {} pressure", ct->Id, ct->Name,
+                      event.Pressure.Resource);
+                ct->Exit(SIGKILL, false);
+            }
+            CL->ReleaseContainer();
+        }
+        break;
+    }
+
     case EEventType::DestroyWeakContainer:
         if (ct && !CL->LockContainer(ct)) {
             std::list<std::shared_ptr<TVolume>> unlinked;
@@ -4196,17 +4719,7 @@ void TContainer::Event(const TEvent &event) {
 
     case EEventType::RotateLogs:
     {
-        for (auto &ct: RootContainer->Subtree()) {
-            if (ct->State == EContainerState::DEAD &&
-                    GetCurrentTimeMs() >= ct->DeathTime + ct->AgingTime) {
-                TEvent ev(EEventType::DestroyAgedContainer, ct);
-                EventQueue->Add(0, ev);
-            }
-            if (ct->State == EContainerState::RUNNING) {
-                ct->Stdout.Rotate(*ct);
-                ct->Stderr.Rotate(*ct);
-            }
-        }
+        TStdStream::RotateModified();
 
         struct stat st;
         if (!StdLog && LogFile && !LogFile.Stat(st) && !st.st_nlink)
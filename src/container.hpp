@@ -4,7 +4,10 @@
 #include <vector>
 #include <list>
 #include <memory>
+#include <array>
+#include <bitset>
 #include <atomic>
+#include <mutex>
 #include <condition_variable>
 
 #include "util/unix.hpp"
@@ -42,6 +45,48 @@ enum class ECpuSetType {
 
 class TProperty;
 
+/* Columnar ring buffer of counters collected by stats sampler */
+class TStatsHistory {
+public:
+    enum EColumn {
+        TIME, CPU_USAGE, CPU_SYSTEM, MEMORY_USAGE, IO_READ, IO_WRITE, IO_OPS,
+        THREADS, PROCESSES, NR_COLUMNS,
+    };
+
+    typedef std::array<uint64_t, NR_COLUMNS> TSample;
+
+    static const char *ColumnName[NR_COLUMNS];
+
+    void Push(const TSample &sample, size_t capacity);
+    bool Last(TSample &sample) const;
+    double Rate(EColumn column, uint64_t window) const;
+    void Series(EColumn column, std::vector<std::pair<uint64_t, uint64_t>> &series) const;
+    void Clear();
+
+private:
+    mutable std::mutex Mutex;
+    std::vector<uint64_t> Columns[NR_COLUMNS];
+    size_t Head = 0;
+    size_t Size = 0;
+
+    size_t Index(size_t age) const {
+        return (Head + Columns[TIME].size() - 1 - age) % Columns[TIME].size();
+    }
+};
+
+/* Rarely set properties, allocated at first change */
+struct TSparseProps {
+    std::map<TPath, TPath> Symlink;
+    TMultiTuple DefaultGw;
+    std::string EtcHosts;
+    TStringMap Sysctl;
+    TUintMap IoBpsLimit;
+    TUintMap IoOpsLimit;
+
+    /* <resource> <some|full> <stall usec> <window usec> [event|kill] */
+    TMultiTuple PressureTrigger;
+};
+
 class TContainer : public std::enable_shared_from_this<TContainer>,
                    public TPortoNonCopyable {
     friend class TProperty;
@@ -58,6 +103,9 @@ class TContainer : public std::enable_shared_from_this<TContainer>,
 
     std::shared_ptr<TEpollSource> Source;
 
+    /* Indexed as PressureTrigger */
+    std::vector<std::shared_ptr<TEpollSource>> PressureSources;
+
     // data
     TError UpdateSoftLimit();
     void SetState(EContainerState next);
@@ -69,6 +117,8 @@ class TContainer : public std::enable_shared_from_this<TContainer>,
     TError ApplyDynamicProperties();
     TError PrepareOomMonitor();
     void ShutdownOom();
+    TError PreparePressureMonitor();
+    void ShutdownPressure();
     TError PrepareCgroups();
     TError PrepareTask(TTaskEnv &TaskEnv);
 
@@ -108,8 +158,8 @@ public:
     /* protected with ContainersMutex */
     std::list<std::shared_ptr<TContainer>> Children;
 
-    bool PropSet[(int)EProperty::NR_PROPERTIES];
-    bool PropDirty[(int)EProperty::NR_PROPERTIES];
+    std::bitset<(int)EProperty::NR_PROPERTIES> PropSet;
+    std::bitset<(int)EProperty::NR_PROPERTIES> PropDirty;
     uint64_t Controllers = 0;
     uint64_t RequiredControllers = 0;
     TCred OwnerCred;
@@ -135,7 +185,6 @@ public:
     std::string Hostname;
     std::string EnvCfg;
     std::vector<TBindMount> BindMounts;
-    std::map<TPath, TPath> Symlink;
     TMultiTuple IpList;
 
     TMultiTuple IpLimit;
@@ -145,11 +194,8 @@ public:
     TCapabilities CapAllowed;   /* can be set as ambient */
     TCapabilities CapLimit;     /* upper limit */
     TCapabilities CapBound;     /* actual bounding set */
-    TMultiTuple DefaultGw;
     std::string ResolvConf;
-    std::string EtcHosts;
     TDevices Devices;
-    TStringMap Sysctl;
 
     time_t RealCreationTime;
     time_t RealStartTime = 0;
@@ -182,9 +228,6 @@ public:
     int IoPrio;
     double IoWeight = 1;
 
-    TUintMap IoBpsLimit;
-    TUintMap IoOpsLimit;
-
     std::string CpuPolicy;
 
     int SchedPolicy;
@@ -217,8 +260,23 @@ public:
     TError MayRespawn();
     TError Respawn();
     TError ScheduleRespawn();
+    void ScheduleAgedDestroy();
+
+    std::unique_ptr<TSparseProps> SparseProps;
+
+    const TSparseProps &Sparse() const {
+        static const TSparseProps empty;
+        return SparseProps ? *SparseProps : empty;
+    }
+
+    TSparseProps &MutableSparse() {
+        if (!SparseProps)
+            SparseProps.reset(new TSparseProps);
+        return *SparseProps;
+    }
 
     TStringMap Labels;
+    bool LabelsIndexed = false;
     std::string Private;
     EAccessLevel AccessLevel;
     std::atomic<int> ClientsCount;
@@ -232,8 +290,20 @@ public:
     uint64_t OomKills = 0;
     uint64_t OomKillsRaw = 0;
     uint64_t OomKillsTotal = 0;
+    uint64_t OomKillsSpeculative = 0; /* pending in subtree, including own */
+    std::atomic<uint64_t> OomKillsStamp; /* system oom_kill at last subtree sync */
     int ExitStatus = 0;
 
+    /* Counters collected by stats sampler */
+    TStatsHistory Stats;
+
+    /* Counts refreshed by sync get, outside of sampler history */
+    std::atomic<uint64_t> SyncedThreads{0};
+    std::atomic<uint64_t> SyncedProcesses{0};
+    std::atomic<uint64_t> SyncedTime{0};
+
+    std::atomic<uint64_t> PressureEvents;
+
     struct {
         bool TaintCounted;
         bool RootOnLoop;
@@ -241,6 +311,7 @@ public:
     } TaintFlags;
 
     bool RecvOomEvents();
+    void RecvPressureEvent(int fd);
 
     TPath RootPath; /* path in host namespace */
     std::vector<std::string> PlacePolicy;
@@ -349,10 +420,17 @@ public:
     bool HasPidFor(const TContainer &ct) const;
     TError GetPidFor(pid_t pidns, pid_t &pid) const;
 
+    TError CountThreads(uint64_t &count) const;
+    TError CountProcesses(uint64_t &count) const;
     TError GetThreadCount(uint64_t &count) const;
     TError GetProcessCount(uint64_t &count) const;
-    TError GetVmStat(TVmStat &stat) const;
+    bool GetStatsSample(TStatsHistory::TSample &sample) const;
+    void SampleStats();
+    void SyncCounts();
+    TError GetVmStat(TVmStat &stat, bool brief = false) const;
     void CollectOomKills(bool event = false);
+    void SyncOomKills();
+    void SyncOomKills(uint64_t stamp, bool valid);
 
     TError StartTask();
     TError StartParents();
@@ -369,6 +447,7 @@ public:
     /* Refresh cached counters */
     void SyncProperty(const std::string &name);
     static void SyncPropertiesAll();
+    static void SyncProperties(const std::list<std::shared_ptr<TContainer>> &containers);
 
     TError ApplyResolvConf() const;
     TError SetSymlink(const TPath &symlink, const TPath &target);
@@ -379,6 +458,7 @@ public:
                                     std::string &name, std::string &index);
     TError HasProperty(const std::string &property) const;
     TError GetProperty(const std::string &property, std::string &value) const;
+    TError GetProperty(const TPropertyRef &property, std::string &value) const;
     TError SetProperty(const std::string &property, const std::string &value);
 
     TError GetIntProperty(const std::string &property,
@@ -389,13 +469,17 @@ public:
                           uint64_t value);
 
     TError Load(const Porto::TContainer &spec);
-    void Dump(const std::vector<std::string> &props, Porto::TContainer &spec);
+    void Dump(const std::vector<TPropertyRef> &props, Porto::TContainer &spec);
 
     /* Protected with ContainersLock */
     static TError ValidLabel(const std::string &label, const std::string &value);
     TError GetLabel(const std::string &label, std::string &value) const;
     void SetLabel(const std::string &label, const std::string &value);
     TError IncLabel(const std::string &label, int64_t &result, int64_t add = 1);
+    void IndexLabel(const std::string &label, const std::string &value, bool add);
+    static const std::map<std::string, TContainer *> *FindLabel(const std::string &label);
+    static const std::map<std::string, TContainer *> *FindLabel(const std::string &label,
+                                                                const std::string &value);
 
     void ForgetPid();
     void SyncState();
@@ -435,6 +519,10 @@ public:
     static TError Restore(const TKeyValue &kv, std::shared_ptr<TContainer> &ct);
 
     static void Event(const TEvent &event);
+
+    static void StatsSampler();
+    static void StartStatsSampler();
+    static void StopStatsSampler();
 };
 
 extern std::mutex ContainersMutex;
@@ -74,7 +74,11 @@ TError TEpollLoop::AddSource(std::shared_ptr<TEpollSource> source) {
     Statistics->EpollSources++;
 
     struct epoll_event ev;
-    ev.events = EPOLLIN | EPOLLHUP;
+    /* PSI triggers signal only priority events */
+    if (source->Flags & EPOLL_EVENT_PRESSURE)
+        ev.events = EPOLLPRI;
+    else
+        ev.events = EPOLLIN | EPOLLHUP;
     ev.data.fd = fd;
     if (epoll_ctl(EpollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
         return TError::System("epoll_add {}", fd);
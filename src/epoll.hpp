@@ -7,6 +7,11 @@
 #include "util/locks.hpp"
 
 constexpr int EPOLL_EVENT_OOM = 1;
+constexpr int EPOLL_EVENT_PRESSURE = 2;
+constexpr int EPOLL_EVENT_STREAM = 4;
+constexpr int EPOLL_EVENT_STDOUT = 8;
+constexpr int EPOLL_EVENT_STDERR = 16;
+constexpr int EPOLL_EVENT_ROTATE = 32;
 
 class TContainer;
 class TEpollLoop;
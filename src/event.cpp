@@ -66,6 +66,10 @@ std::string TEvent::GetMsg() const {
             return "destroy aged container";
         case EEventType::DestroyWeakContainer:
             return "destroy weak container";
+        case EEventType::Pressure:
+            return Pressure.Resource + " pressure";
+        case EEventType::StreamFollow:
+            return "stream follow " + std::to_string(Stream.Id);
         default:
             return "unknown event";
     }
@@ -17,6 +17,8 @@ enum class EEventType {
     WaitTimeout,
     DestroyAgedContainer,
     DestroyWeakContainer,
+    Pressure,
+    StreamFollow,
 };
 
 class TEventWorker;
@@ -35,6 +37,15 @@ public:
         std::weak_ptr<TContainerWaiter> Waiter;
     } WaitTimeout;
 
+    struct {
+        std::string Resource;
+        std::string Action;
+    } Pressure;
+
+    struct {
+        uint64_t Id = 0;
+    } Stream;
+
     uint64_t DueMs = 0;
 
     TEvent(EEventType type, std::shared_ptr<TContainer> container = nullptr) :
@@ -1,17 +1,38 @@
 #include "helpers.hpp"
 #include "common.hpp"
+#include "config.hpp"
 #include "util/path.hpp"
 #include "util/log.hpp"
 #include "util/unix.hpp"
+#include "util/checksum.hpp"
+
+#include <climits>
+#include <map>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 extern "C" {
 #include <unistd.h>
 #include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
 #include <linux/loop.h>
+#include <linux/fs.h>
 }
 
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
 static void HelperError(TFile &err, const std::string &text, TError error) __attribute__ ((noreturn));
 
 static void HelperError(TFile &err, const std::string &text, TError error) {
@@ -20,6 +41,106 @@ static void HelperError(TFile &err, const std::string &text, TError error) {
     _exit(EXIT_FAILURE);
 }
 
+/* Unshare and remount everything except dir read-only, chdir into it */
+static TError EnterSandbox(const TFile &dir) {
+    TPath path = dir.RealPath();
+    TPath root("/");
+    TPath dot(".");
+    TError error;
+
+    if (!dir || path.IsRoot())
+        return root.Chdir();
+
+    error = dir.Chdir();
+    if (error)
+        return TError(error, "chdir");
+
+    if (unshare(CLONE_NEWNS))
+        return TError::System("unshare newns");
+
+    error = root.Remount(MS_PRIVATE | MS_REC);
+    if (!error)
+        error = root.Remount(MS_BIND | MS_REC | MS_RDONLY);
+    if (error)
+        return TError(error, "remount");
+
+    error = dot.Bind(dot, MS_REC);
+    if (error)
+        return TError(error, "bind");
+
+    error = TPath("../" + path.BaseName()).Chdir();
+    if (error)
+        return TError(error, "chdir bind");
+
+    error = dot.Remount(MS_BIND | MS_REC | MS_ALLOW_WRITE);
+    if (error)
+        return TError(error, "remount bind");
+
+    return OK;
+}
+
+/*
+ * Run function in forked helper isolated like external commands: in
+ * helpers cgroup and namespace where only dir is writable. Descriptors
+ * except listed are closed. Function passes its output back through
+ * unnamed result file.
+ */
+static TError RunHelper(const std::string &name, const TFile &dir,
+                        std::vector<int> fds, TFile &result,
+                        const std::function<TError()> &func) {
+    TCgroup memcg = MemorySubsystem.Cgroup(PORTO_HELPERS_CGROUP);
+    TError error;
+    TFile err;
+    TTask task;
+
+    error = err.CreateUnnamed("/tmp");
+    if (!error)
+        error = result.CreateUnnamed("/tmp");
+    if (error)
+        return error;
+
+    L_ACT("Call helper: {} in {}", name, dir.RealPath());
+
+    error = task.Fork();
+    if (error)
+        return error;
+
+    if (task.Pid) {
+        TError status = task.Wait();
+        if (lseek(err.Fd, 0, SEEK_SET) || lseek(result.Fd, 0, SEEK_SET))
+            return TError::System("lseek");
+        if (!TError::Deserialize(err.Fd, error))
+            error = status ? TError(status, "helper: {}", name) :
+                             TError("helper: {} exited without result", name);
+        if (error)
+            L_WRN("Helper {} failed: {}", name, error);
+        return error;
+    }
+
+    SetProcessName("portod-" + name);
+
+    error = memcg.Attach(GetPid());
+    if (error)
+        error = TError(error, "Cannot attach to helper cgroup");
+
+    SetDieOnParentExit(SIGKILL);
+
+    if (!error)
+        error = EnterSandbox(dir);
+
+    if (!error)
+        error = HelperCapabilities.ApplyLimit();
+
+    fds.push_back(err.Fd);
+    fds.push_back(result.Fd);
+    TFile::CloseAll(fds);
+
+    if (!error)
+        error = func();
+
+    _exit(error.Serialize(err.Fd) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
 TError RunCommand(const std::vector<std::string> &command,
                   const TFile &dir, const TFile &in, const TFile &out,
                   const TCapabilities &caps) {
@@ -85,71 +206,1683 @@ TError RunCommand(const std::vector<std::string> &command,
     if (dup2(err.Fd, STDERR_FILENO) != STDERR_FILENO)
         HelperError(err, "stderr", TError::System("dup2"));
 
-    TPath root("/");
-    TPath dot(".");
+    error = EnterSandbox(dir);
+    if (error)
+        HelperError(err, "sandbox", error);
+
+    error = caps.ApplyLimit();
+    if (error)
+        HelperError(err, "caps", error);
+
+    TFile::CloseAll({STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO});
+
+    const char **argv = (const char **)malloc(sizeof(*argv) * (command.size() + 1));
+    for (size_t i = 0; i < command.size(); i++)
+        argv[i] = command[i].c_str();
+    argv[command.size()] = nullptr;
+
+    execvp(argv[0], (char **)argv);
+
+    err.SetFd = STDERR_FILENO;
+    HelperError(err, fmt::format("Cannot execute {}", argv[0]), TError::System("exec"));
+}
+
+/* Shared extents if filesystem could, then in-kernel copy, then read-write */
+static TError CopyData(const TFile &src, const TFile &dst, uint64_t total, bool &cloned) {
+    uint64_t size = total;
+
+    if (!size)
+        return OK;
+
+    if (!ioctl(dst.Fd, FICLONE, src.Fd)) {
+        cloned = true;
+        return OK;
+    }
+
+#ifdef __NR_copy_file_range
+    while (size) {
+        ssize_t len = syscall(__NR_copy_file_range, src.Fd, nullptr,
+                              dst.Fd, nullptr, std::min(size, (uint64_t)1 << 30), 0);
+        if (len > 0) {
+            size -= len;
+            continue;
+        }
+        if (len == 0)
+            return OK;
+        if (size == total &&
+                (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+            break;
+        return TError::System("copy_file_range");
+    }
+    if (!size)
+        return OK;
+#endif
+
+    std::vector<char> buf(1 << 20);
+    ssize_t len;
+
+    while ((len = read(src.Fd, buf.data(), buf.size())) > 0) {
+        for (ssize_t off = 0; off < len; ) {
+            ssize_t ret = write(dst.Fd, buf.data() + off, len - off);
+            if (ret < 0)
+                return TError::System("write");
+            off += ret;
+        }
+    }
+    if (len < 0)
+        return TError::System("read");
+
+    return OK;
+}
+
+/*
+ * In-process "cp --archive --force --one-file-system": directories are
+ * walked by one thread, file data is copied by bounded pool of workers.
+ */
+class TTreeCopier {
+    struct TJob {
+        TFile Src, Dst;
+        struct stat St;
+    };
+
+    TCopyStat &Stat;
+    TFile Root;
+    dev_t RootDev = 0;
+    std::map<std::pair<dev_t, ino_t>, TPath> Links;
+    std::vector<std::pair<TPath, struct stat>> Dirs;
+
+    std::vector<std::thread> Workers;
+    std::deque<std::unique_ptr<TJob>> Queue;
+    std::mutex Mutex;
+    std::condition_variable Wakeup;
+    size_t MaxQueue;
+    bool Finished = false;
+    TError Error;
+
+    TError GetError() {
+        std::lock_guard<std::mutex> guard(Mutex);
+        return Error;
+    }
+
+    static void CopyXattrs(int src, int dst) {
+        std::string list, value;
+        ssize_t size;
+
+        size = syscall(SYS_flistxattr, src, nullptr, 0);
+        if (size <= 0)
+            return;
+        list.resize(size);
+        size = syscall(SYS_flistxattr, src, &list[0], size);
+        if (size <= 0)
+            return;
+        list.resize(size);
+
+        /* Preserving is best effort like in cp --preserve=all */
+        for (size_t pos = 0; pos < list.size(); pos += strlen(&list[pos]) + 1) {
+            const char *name = &list[pos];
+            size = syscall(SYS_fgetxattr, src, name, nullptr, 0);
+            if (size < 0)
+                continue;
+            value.resize(size);
+            size = syscall(SYS_fgetxattr, src, name, &value[0], size);
+            if (size >= 0)
+                (void)syscall(SYS_fsetxattr, dst, name, value.c_str(), size, 0);
+        }
+    }
+
+    static void CopyXattrs(const char *src, const char *dst) {
+        std::string list, value;
+        ssize_t size;
+
+        size = syscall(SYS_listxattr, src, nullptr, 0);
+        if (size <= 0)
+            return;
+        list.resize(size);
+        size = syscall(SYS_listxattr, src, &list[0], size);
+        if (size <= 0)
+            return;
+        list.resize(size);
+
+        for (size_t pos = 0; pos < list.size(); pos += strlen(&list[pos]) + 1) {
+            const char *name = &list[pos];
+            size = syscall(SYS_getxattr, src, name, nullptr, 0);
+            if (size < 0)
+                continue;
+            value.resize(size);
+            size = syscall(SYS_getxattr, src, name, &value[0], size);
+            if (size >= 0)
+                (void)syscall(SYS_setxattr, dst, name, value.c_str(), size, 0);
+        }
+    }
+
+    static TError CopyAttrs(const TFile &src, const TFile &dst, const struct stat &st) {
+        if (fchown(dst.Fd, st.st_uid, st.st_gid))
+            return TError::System("fchown");
+        if (fchmod(dst.Fd, st.st_mode & 07777))
+            return TError::System("fchmod");
+        CopyXattrs(src.Fd, dst.Fd);
+        return OK;
+    }
+
+    static TError SetTimes(int dir, const char *name, const struct stat &st) {
+        struct timespec ts[2] = { st.st_atim, st.st_mtim };
+
+        if (utimensat(dir, name, ts, AT_SYMLINK_NOFOLLOW))
+            return TError::System("utimensat {}", name);
+        return OK;
+    }
+
+    static TError RunJob(TJob &job, bool &cloned) {
+        struct timespec ts[2] = { job.St.st_atim, job.St.st_mtim };
+
+        TError error = CopyData(job.Src, job.Dst, job.St.st_size, cloned);
+        if (!error)
+            error = CopyAttrs(job.Src, job.Dst, job.St);
+        if (!error && futimens(job.Dst.Fd, ts))
+            error = TError::System("futimens");
+        return error;
+    }
+
+    void Worker() {
+        std::unique_lock<std::mutex> lock(Mutex);
+
+        while (true) {
+            Wakeup.wait(lock, [&]{ return Finished || !Queue.empty(); });
+            if (Queue.empty())
+                break;
+            auto job = std::move(Queue.front());
+            bool cloned = false;
+            Queue.pop_front();
+            Wakeup.notify_all();
+            lock.unlock();
+            TError error = RunJob(*job, cloned);
+            uint64_t size = job->St.st_size;
+            job = nullptr;
+            lock.lock();
+            if (error && !Error)
+                Error = error;
+            if (cloned)
+                Stat.Cloned += size;
+        }
+    }
+
+    void Submit(std::unique_ptr<TJob> job) {
+        std::unique_lock<std::mutex> lock(Mutex);
+
+        Stat.Files++;
+        Stat.Bytes += job->St.st_size;
+
+        if (Workers.empty()) {
+            bool cloned = false;
+            lock.unlock();
+            TError error = RunJob(*job, cloned);
+            lock.lock();
+            if (error && !Error)
+                Error = error;
+            if (cloned)
+                Stat.Cloned += job->St.st_size;
+            return;
+        }
+
+        Wakeup.wait(lock, [&]{ return Queue.size() < MaxQueue; });
+        Queue.push_back(std::move(job));
+        Wakeup.notify_all();
+    }
+
+    TError CopyEntry(const TFile &src, const TFile &dst, const TPath &path,
+                     const char *name);
+    TError CopyDir(const TFile &src, const TFile &dst, const TPath &path);
+
+public:
+    TTreeCopier(TCopyStat &stat, int threads) : Stat(stat), MaxQueue(threads * 16) {
+        for (int i = 0; i < threads; i++)
+            Workers.emplace_back(&TTreeCopier::Worker, this);
+    }
+
+    ~TTreeCopier() {
+        Mutex.lock();
+        Finished = true;
+        Mutex.unlock();
+        Wakeup.notify_all();
+        for (auto &thread: Workers)
+            thread.join();
+    }
+
+    TError Copy(const TPath &src, const TPath &dst);
+};
 
-    if (dir && !path.IsRoot()) {
-        /* Unshare and remount everything except CWD Read-Only */
-        error = dir.Chdir();
+TError TTreeCopier::CopyEntry(const TFile &src, const TFile &dst,
+                              const TPath &path, const char *name) {
+    struct stat st, dst_st;
+    TError error;
+
+    if (fstatat(src.Fd, name, &st, AT_SYMLINK_NOFOLLOW))
+        return TError::System("stat {}", path);
+
+    bool exists = !fstatat(dst.Fd, name, &dst_st, AT_SYMLINK_NOFOLLOW);
+
+    if (S_ISDIR(st.st_mode)) {
+        TFile src_dir, dst_dir;
+
+        if (exists && !S_ISDIR(dst_st.st_mode))
+            return TError(EError::InvalidValue, "Cannot overwrite non-directory {} with directory", path);
+
+        if (!exists && mkdirat(dst.Fd, name, 0700))
+            return TError::System("mkdir {}", path);
+
+        error = src_dir.OpenAt(src, name, O_RDONLY | O_CLOEXEC | O_DIRECTORY | O_NOCTTY | O_NOFOLLOW, 0);
+        if (!error)
+            error = dst_dir.OpenAt(dst, name, O_RDONLY | O_CLOEXEC | O_DIRECTORY | O_NOCTTY | O_NOFOLLOW, 0);
+        if (!error)
+            error = CopyAttrs(src_dir, dst_dir, st);
         if (error)
-            HelperError(err, "chdir", error);
+            return error;
+
+        Dirs.emplace_back(path, st);
+
+        /* Mountpoints are copied without content */
+        if (st.st_dev != RootDev)
+            return OK;
+
+        return CopyDir(src_dir, dst_dir, path);
+    }
+
+    if (exists) {
+        if (S_ISDIR(dst_st.st_mode))
+            return TError(EError::InvalidValue, "Cannot overwrite directory {} with non-directory", path);
+        if (unlinkat(dst.Fd, name, 0))
+            return TError::System("unlink {}", path);
+    }
+
+    if (st.st_nlink > 1) {
+        auto link = Links.find(std::make_pair(st.st_dev, st.st_ino));
+        if (link != Links.end()) {
+            if (linkat(Root.Fd, link->second.c_str(), dst.Fd, name, 0))
+                return TError::System("link {}", path);
+            return OK;
+        }
+        Links[std::make_pair(st.st_dev, st.st_ino)] = path;
+    }
 
-        if (unshare(CLONE_NEWNS))
-            HelperError(err, "newns", TError::System("unshare"));
+    if (S_ISREG(st.st_mode)) {
+        std::unique_ptr<TJob> job(new TJob);
 
-        error = root.Remount(MS_PRIVATE | MS_REC);
+        job->St = st;
+        error = job->Src.OpenAt(src, name, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NOFOLLOW, 0);
+        if (!error)
+            error = job->Dst.OpenAt(dst, name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC |
+                                    O_NOCTTY | O_NOFOLLOW, 0600);
         if (error)
-            HelperError(err, "remont", error);
+            return error;
 
-        error = root.Remount(MS_BIND | MS_REC | MS_RDONLY);
+        Submit(std::move(job));
+        return OK;
+    }
+
+    if (S_ISLNK(st.st_mode)) {
+        std::string target(st.st_size + 1, '\0');
+        ssize_t len = readlinkat(src.Fd, name, &target[0], target.size());
+        if (len < 0)
+            return TError::System("readlink {}", path);
+        target.resize(len);
+        if (symlinkat(target.c_str(), dst.Fd, name))
+            return TError::System("symlink {}", path);
+    } else if (mknodat(dst.Fd, name, st.st_mode, st.st_rdev))
+        return TError::System("mknod {}", path);
+
+    if (fchownat(dst.Fd, name, st.st_uid, st.st_gid, AT_SYMLINK_NOFOLLOW))
+        return TError::System("chown {}", path);
+
+    if (!S_ISLNK(st.st_mode) && fchmodat(dst.Fd, name, st.st_mode & 07777, 0))
+        return TError::System("chmod {}", path);
+
+    /* Xattrs of special files are copied by path, symlinks are not followed */
+    if (!S_ISLNK(st.st_mode)) {
+        TFile src_file, dst_file;
+        if (!src_file.OpenAt(src, name, O_PATH | O_CLOEXEC | O_NOFOLLOW, 0) &&
+                !dst_file.OpenAt(dst, name, O_PATH | O_CLOEXEC | O_NOFOLLOW, 0))
+            CopyXattrs(src_file.ProcPath().c_str(), dst_file.ProcPath().c_str());
+    }
+
+    Stat.Files++;
+
+    return SetTimes(dst.Fd, name, st);
+}
+
+TError TTreeCopier::CopyDir(const TFile &src, const TFile &dst, const TPath &path) {
+    TError error;
+
+    int fd = dup(src.Fd);
+    if (fd < 0)
+        return TError::System("dup");
+
+    DIR *dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return TError::System("fdopendir {}", path);
+    }
+
+    struct dirent *de;
+    while (!error && (de = readdir(dir))) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+            continue;
+        error = CopyEntry(src, dst, path / de->d_name, de->d_name);
+        if (!error)
+            error = GetError();
+    }
+
+    closedir(dir);
+    return error;
+}
+
+TError TTreeCopier::Copy(const TPath &src, const TPath &dst) {
+    struct stat st;
+    TFile source;
+    TError error;
+
+    error = source.OpenDir(src);
+    if (!error)
+        error = Root.OpenDir(dst);
+    if (!error)
+        error = source.Stat(st);
+    if (error)
+        return error;
+
+    RootDev = st.st_dev;
+
+    error = CopyAttrs(source, Root, st);
+    if (!error)
+        error = CopyDir(source, Root, ".");
+
+    /* Wait workers, then fix directory times changed by creating entries */
+    Mutex.lock();
+    Finished = true;
+    Mutex.unlock();
+    Wakeup.notify_all();
+    for (auto &thread: Workers)
+        thread.join();
+    Workers.clear();
+
+    if (!error)
+        error = GetError();
+
+    for (auto it = Dirs.rbegin(); !error && it != Dirs.rend(); ++it)
+        error = SetTimes(Root.Fd, it->first.c_str(), it->second);
+
+    if (!error)
+        error = SetTimes(AT_FDCWD, dst.c_str(), st);
+
+    return error;
+}
+
+/* Copier runs in helper like cp: in helpers cgroup, only dst is writable */
+TError CopyRecursive(const TPath &src, const TPath &dst, TCopyStat *stat) {
+    int threads = config().volumes().copy_threads();
+    TFile dir, result;
+    TCopyStat local;
+    TError error;
+
+    if (!stat)
+        stat = &local;
+
+    error = dir.OpenDir(dst);
+    if (error)
+        return error;
+
+    if (threads <= 0)
+        return RunCommand({ "cp", "--archive", "--force",
+                            "--one-file-system", "--no-target-directory",
+                            src.ToString(), "." }, dir);
+
+    TPath root = dir.RealPath();
+
+    error = RunHelper("copy", dir, {}, result, [&]() -> TError {
+        TTreeCopier copier(*stat, threads - 1);
+        TError err = copier.Copy(src, root);
+        TError err2 = result.WriteAll(std::string((const char *)stat, sizeof(*stat)));
+        return err ? err : err2;
+    });
+
+    TCopyStat copied;
+    if (pread(result.Fd, &copied, sizeof(copied), 0) == sizeof(copied))
+        *stat = copied;
+
+    return error;
+}
+
+TError CopyFile(const TFile &src, const TFile &dst, TCopyStat *stat) {
+    struct stat st;
+    bool cloned = false;
+    TError error;
+
+    error = src.Stat(st);
+    if (error)
+        return error;
+
+    /* Pipes and sockets are copied until end of stream */
+    if (!S_ISREG(st.st_mode)) {
+        error = CopyData(src, dst, UINT64_MAX, cloned);
+        if (!error)
+            error = dst.Stat(st);
+        if (!error && !S_ISREG(st.st_mode))
+            st.st_size = 0;
+    } else
+        error = CopyData(src, dst, st.st_size, cloned);
+
+    if (!error && stat) {
+        stat->Files++;
+        stat->Bytes += st.st_size;
+        if (cloned)
+            stat->Cloned += st.st_size;
+    }
+    return error;
+}
+
+/*
+ * In-process "tar --extract --numeric-owner --preserve-permissions --xattrs"
+ * for ustar, gnu and pax archives. Headers are parsed and names are created
+ * by one thread, data of small files is written by bounded pool of workers.
+ * For layers aufs whiteouts are converted in the same pass.
+ */
+class TTarExtractor {
+    static constexpr size_t BLOCK = 512;
+    static constexpr uint64_t SMALL_FILE = 1 << 20;
+
+    struct TEntry {
+        std::string Path, Link;
+        char Type = '0';
+        mode_t Mode = 0;
+        uid_t Uid = 0;
+        gid_t Gid = 0;
+        uint64_t Size = 0;
+        struct timespec Mtime = { 0, 0 };
+        dev_t Dev = 0;
+        std::vector<std::pair<std::string, std::string>> Xattrs;
+    };
+
+    struct TJob {
+        TFile File;
+        TEntry Entry;
+        std::string Data;
+        std::string Key;
+        uint64_t Seq = 0;
+    };
+
+    const TFile &Input;
+    TCopyStat &Stat;
+    bool Layer, Merge;
+    /* Checksum of regular files, saved into xattr and Sums */
+    std::string Algo;
+    TChecksumMap *Sums;
+    TFile Root;
+
+    /* Archive may repeat path, only sum of the last entry is kept */
+    std::unordered_map<std::string, uint64_t> SumSeq;
+    uint64_t LastSeq = 0;
+
+    std::vector<char> Buffer;
+    size_t BufferPos = 0, BufferEnd = 0;
+
+    /* Headers of current entry, replayed into tar if it is not supported */
+    std::string Raw;
+    bool Capture = false;
+    /* Payload skipped after headers, tar ignores it and gets zeros instead */
+    uint64_t RawSkipped = 0;
+
+    /* Parent of last entry, archives are usually sorted by directory */
+    std::string LastDir;
+    TFile LastDirFd;
+
+    /* Chain of directories which could get more entries */
+    struct TDirTime {
+        std::string Path;
+        struct timespec Mtime;
+        TFile Dir;
+    };
+    std::vector<std::unique_ptr<TDirTime>> Dirs;
+
+    std::vector<std::thread> Workers;
+    std::deque<std::unique_ptr<TJob>> Queue;
+    std::mutex Mutex;
+    std::condition_variable Wakeup;
+    size_t MaxQueue;
+    bool Finished = false;
+    TError Error;
+
+    TError GetError() {
+        std::lock_guard<std::mutex> guard(Mutex);
+        return Error;
+    }
+
+    TError Read(char *data, size_t len) {
+        while (len) {
+            if (BufferPos == BufferEnd) {
+                ssize_t ret = read(Input.Fd, Buffer.data(), Buffer.size());
+                if (ret < 0 && errno == EINTR)
+                    continue;
+                if (ret < 0)
+                    return TError::System("read archive");
+                if (ret == 0)
+                    return TError(EError::InvalidValue, "Unexpected end of archive");
+                BufferPos = 0;
+                BufferEnd = ret;
+            }
+            size_t size = std::min(len, BufferEnd - BufferPos);
+            memcpy(data, Buffer.data() + BufferPos, size);
+            if (Capture)
+                Raw.append(data, size);
+            BufferPos += size;
+            data += size;
+            len -= size;
+        }
+        return OK;
+    }
+
+    TError Skip(uint64_t len) {
+        char block[BLOCK];
+        TError error;
+
+        while (!error && len) {
+            size_t size = std::min(len, (uint64_t)BLOCK);
+            error = Read(block, size);
+            len -= size;
+        }
+        return error;
+    }
+
+    /* Payload which is never extracted is not kept in captured headers */
+    TError SkipData(uint64_t len) {
+        if (Capture)
+            RawSkipped += len;
+        Capture = false;
+        return Skip(len);
+    }
+
+    static uint64_t Padding(uint64_t size) {
+        return (BLOCK - size % BLOCK) % BLOCK;
+    }
+
+    TError ReadString(uint64_t size, std::string &text, bool terminated) {
+        if (size > (64 << 20))
+            return TError(EError::InvalidValue, "Too big tar extended header: {}", size);
+        text.resize(size);
+        TError error = Read(&text[0], size);
+        if (!error)
+            error = Skip(Padding(size));
+        /* GNU long names are zero-terminated */
+        if (!error && terminated)
+            text.resize(strnlen(text.c_str(), text.size()));
+        return error;
+    }
+
+    static uint64_t ParseNumber(const char *field, size_t len) {
+        uint64_t value = 0;
+        size_t i = 0;
+
+        /* Base-256 for values which do not fit into octal */
+        if ((unsigned char)field[0] & 0x80) {
+            value = (unsigned char)field[0] & 0x3f;
+            for (i = 1; i < len; i++)
+                value = (value << 8) | (unsigned char)field[i];
+            return value;
+        }
+
+        while (i < len && (field[i] == ' ' || field[i] == '\0'))
+            i++;
+        for (; i < len && field[i] >= '0' && field[i] <= '7'; i++)
+            value = value * 8 + field[i] - '0';
+        return value;
+    }
+
+    static std::string ParseString(const char *field, size_t len) {
+        return std::string(field, strnlen(field, len));
+    }
+
+    static TError ParsePax(const std::string &data, std::map<std::string, std::string> &pax) {
+        size_t pos = 0;
+
+        /* Records are "<length> <key>=<value>\n" */
+        while (pos < data.size()) {
+            size_t sep = data.find(' ', pos);
+            uint64_t len;
+
+            if (sep == std::string::npos ||
+                    StringToUint64(data.substr(pos, sep - pos), len) ||
+                    len <= sep - pos || pos + len > data.size() ||
+                    data[pos + len - 1] != '\n')
+                return TError(EError::InvalidValue, "Broken pax header");
+
+            std::string record = data.substr(sep + 1, pos + len - sep - 2);
+            size_t eq = record.find('=');
+            if (eq == std::string::npos)
+                return TError(EError::InvalidValue, "Broken pax record {}", record);
+
+            pax[record.substr(0, eq)] = record.substr(eq + 1);
+            pos += len;
+        }
+
+        return OK;
+    }
+
+    static TError ApplyPax(const std::map<std::string, std::string> &pax, TEntry &entry) {
+        for (auto &it: pax) {
+            const std::string &key = it.first, &value = it.second;
+            uint64_t number;
+
+            if (key == "path")
+                entry.Path = value;
+            else if (key == "linkpath")
+                entry.Link = value;
+            else if (key == "size" || key == "uid" || key == "gid") {
+                if (StringToUint64(value, number))
+                    return TError(EError::InvalidValue, "Broken pax {}={}", key, value);
+                if (key == "size")
+                    entry.Size = number;
+                else if (key == "uid")
+                    entry.Uid = number;
+                else
+                    entry.Gid = number;
+            } else if (key == "mtime") {
+                /* Times before epoch are negative: -1.25 is -2 s + 0.75 s */
+                bool negative = StringStartsWith(value, "-");
+                size_t dot = value.find('.');
+                if (StringToUint64(value.substr(negative, dot - negative), number))
+                    return TError(EError::InvalidValue, "Broken pax {}={}", key, value);
+                entry.Mtime.tv_sec = negative ? -(time_t)number : number;
+                entry.Mtime.tv_nsec = 0;
+                if (dot != std::string::npos) {
+                    std::string nsec = value.substr(dot + 1, 9);
+                    nsec.resize(9, '0');
+                    if (!StringToUint64(nsec, number) && number) {
+                        entry.Mtime.tv_nsec = negative ? 1000000000 - number : number;
+                        if (negative)
+                            entry.Mtime.tv_sec--;
+                    }
+                }
+            } else if (StringStartsWith(key, "SCHILY.xattr."))
+                entry.Xattrs.emplace_back(key.substr(13), value);
+            else if (StringStartsWith(key, "GNU.sparse."))
+                return TError(EError::NotSupported, "Sparse files in archive");
+        }
+        return OK;
+    }
+
+    /* Same set as --xattrs-include in tar command line */
+    static bool KeepXattr(const std::string &name) {
+        return name == "security.capability" ||
+               StringStartsWith(name, "trusted.overlay.") ||
+               StringStartsWith(name, "user.");
+    }
+
+    static TError SplitPath(const std::string &path, std::vector<std::string> &names) {
+        names.clear();
+        if (StringStartsWith(path, "/"))
+            return TError(EError::InvalidValue, "Absolute path in archive: {}", path);
+        for (auto &name: SplitString(path, '/')) {
+            if (name == "" || name == ".")
+                continue;
+            if (name == "..")
+                return TError(EError::InvalidValue, "Unsafe path in archive: {}", path);
+            names.push_back(name);
+        }
+        return OK;
+    }
+
+    /* Resolve parent without following symlinks, missing directories are created like in tar */
+    TError OpenParent(const std::vector<std::string> &names, TFile &dir, bool create) {
+        int fd = Root.Fd;
+
+        for (size_t i = 0; i + 1 < names.size(); i++) {
+            const char *name = names[i].c_str();
+            int flags = O_RDONLY | O_CLOEXEC | O_DIRECTORY | O_NOCTTY | O_NOFOLLOW;
+            int next = openat(fd, name, flags);
+
+            if (next < 0 && errno == ENOENT && create) {
+                if (mkdirat(fd, name, 0755) && errno != EEXIST)
+                    return TError::System("mkdir {}", names[i]);
+                next = openat(fd, name, flags);
+            }
+
+            if (next < 0) {
+                if (errno == ELOOP || errno == ENOTDIR)
+                    return TError(EError::NotSupported, "Path in archive goes through non-directory {}", names[i]);
+                return TError::System("open {}", names[i]);
+            }
+
+            dir.Close();
+            dir.SetFd = next;
+            fd = next;
+        }
+
+        if (fd == Root.Fd) {
+            fd = dup(Root.Fd);
+            if (fd < 0)
+                return TError::System("dup");
+            dir.Close();
+            dir.SetFd = fd;
+        }
+
+        return OK;
+    }
+
+    TError OpenParent(const std::vector<std::string> &names, std::string &dir_path) {
+        dir_path.clear();
+        for (size_t i = 0; i + 1 < names.size(); i++)
+            dir_path += names[i] + "/";
+        if (LastDirFd && dir_path == LastDir)
+            return OK;
+        LastDir.clear();
+        TError error = OpenParent(names, LastDirFd, true);
+        if (!error)
+            LastDir = dir_path;
+        return error;
+    }
+
+    /* Replace existing entry like tar does, directories are kept */
+    TError RemoveExisting(const char *name, bool recursive) {
+        struct stat st;
+
+        if (fstatat(LastDirFd.Fd, name, &st, AT_SYMLINK_NOFOLLOW))
+            return errno == ENOENT ? OK : TError::System("stat {}{}", LastDir, name);
+
+        if (!S_ISDIR(st.st_mode)) {
+            if (unlinkat(LastDirFd.Fd, name, 0))
+                return TError::System("unlink {}{}", LastDir, name);
+            return OK;
+        }
+
+        /* Cached parent might be inside */
+        std::string dir_path = LastDir;
+        TFile dir;
+        TError error = dir.Dup(LastDirFd);
+        if (error)
+            return error;
+        LastDir.clear();
+        LastDirFd.Close();
+
+        if (recursive)
+            return dir.RemoveAt(name);
+        if (unlinkat(dir.Fd, name, AT_REMOVEDIR))
+            return TError::System("Cannot overwrite directory {}{}", dir_path, name);
+        return OK;
+    }
+
+    static TError SetAttrs(int fd, const TEntry &entry) {
+        if (fchown(fd, entry.Uid, entry.Gid))
+            return TError::System("fchown {}", entry.Path);
+        if (fchmod(fd, entry.Mode & 07777))
+            return TError::System("fchmod {}", entry.Path);
+        /* Like tar only warns about xattrs */
+        for (auto &xattr: entry.Xattrs)
+            (void)syscall(SYS_fsetxattr, fd, xattr.first.c_str(),
+                          xattr.second.data(), xattr.second.size(), 0);
+        return OK;
+    }
+
+    static TError SetTimes(int dir, const char *name, const struct timespec &mtime) {
+        struct timespec ts[2] = { { 0, UTIME_NOW }, mtime };
+
+        if (utimensat(dir, name, ts, AT_SYMLINK_NOFOLLOW))
+            return TError::System("utimensat {}", name);
+        return OK;
+    }
+
+    static TError WriteData(int fd, const char *data, size_t len) {
+        while (len) {
+            ssize_t ret = write(fd, data, len);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret < 0)
+                return TError::System("write");
+            data += ret;
+            len -= ret;
+        }
+        return OK;
+    }
+
+    /* Sum of large file is computed while it is streamed */
+    TError RunJob(TJob &job, std::string &sum) {
+        struct timespec ts[2] = { { 0, UTIME_NOW }, job.Entry.Mtime };
+
+        TError error = WriteData(job.File.Fd, job.Data.data(), job.Data.size());
+        if (!error)
+            error = SetAttrs(job.File.Fd, job.Entry);
+        if (!error && !Algo.empty()) {
+            if (sum.empty()) {
+                TChecksum checksum(Algo);
+                checksum.Update(job.Data.data(), job.Data.size());
+                sum = checksum.Hex();
+            }
+            error = SaveChecksum(job.File, Algo, sum);
+        }
+        if (!error && futimens(job.File.Fd, ts))
+            error = TError::System("futimens {}", job.Entry.Path);
+        return error;
+    }
+
+    /* Called under Mutex */
+    void SaveSum(const std::string &key, uint64_t seq, const std::string &sum) {
+        auto it = SumSeq.find(key);
+        if (it == SumSeq.end() || it->second != seq)
+            return;
+        if (!sum.empty())
+            (*Sums)[key] = sum;
+        SumSeq.erase(it);
+    }
+
+    void Worker() {
+        std::unique_lock<std::mutex> lock(Mutex);
+
+        while (true) {
+            Wakeup.wait(lock, [&]{ return Finished || !Queue.empty(); });
+            if (Queue.empty())
+                break;
+            auto job = std::move(Queue.front());
+            std::string sum;
+            Queue.pop_front();
+            Wakeup.notify_all();
+            lock.unlock();
+            TError error = RunJob(*job, sum);
+            lock.lock();
+            if (error && !Error)
+                Error = error;
+            if (!job->Key.empty())
+                SaveSum(job->Key, job->Seq, sum);
+            job = nullptr;
+        }
+    }
+
+    void Submit(std::unique_ptr<TJob> job) {
+        std::unique_lock<std::mutex> lock(Mutex);
+
+        if (Workers.empty()) {
+            std::string sum;
+            lock.unlock();
+            TError error = RunJob(*job, sum);
+            lock.lock();
+            if (error && !Error)
+                Error = error;
+            if (!job->Key.empty())
+                SaveSum(job->Key, job->Seq, sum);
+            return;
+        }
+
+        Wakeup.wait(lock, [&]{ return Queue.size() < MaxQueue; });
+        Queue.push_back(std::move(job));
+        Wakeup.notify_all();
+    }
+
+    /* Like in tar times are set when next entry is outside of directory */
+    TError FlushDirs(const char *path) {
+        while (!Dirs.empty()) {
+            auto &dir = Dirs.back();
+            if (path && (dir->Path.empty() ||
+                         (!strncmp(path, dir->Path.c_str(), dir->Path.size()) &&
+                          path[dir->Path.size()] == '/')))
+                break;
+            struct timespec ts[2] = { { 0, UTIME_NOW }, dir->Mtime };
+            if (futimens(dir->Dir.Fd, ts))
+                return TError::System("futimens {}", dir->Path);
+            Dirs.pop_back();
+        }
+        return OK;
+    }
+
+    TError ExtractFile(TFile &file, TEntry &entry, const std::string &key, uint64_t seq);
+    TError ExtractDir(const char *name, const std::string &path, TEntry &entry);
+    TError ExtractEntry(TEntry &entry);
+
+public:
+    TTarExtractor(const TFile &input, TCopyStat &stat, bool layer, bool merge,
+                  const std::string &algo, TChecksumMap *sums, int threads) :
+        Input(input), Stat(stat), Layer(layer), Merge(merge), Algo(algo), Sums(sums),
+        Buffer(1 << 20), MaxQueue(threads * 16)
+    {
+        for (int i = 0; i < threads; i++)
+            Workers.emplace_back(&TTarExtractor::Worker, this);
+    }
+
+    ~TTarExtractor() {
+        Mutex.lock();
+        Finished = true;
+        Mutex.unlock();
+        Wakeup.notify_all();
+        for (auto &thread: Workers)
+            thread.join();
+    }
+
+    TError Extract(const TPath &dst);
+
+    /* Archive from the entry which failed, without bytes left in input */
+    std::string Unconsumed() const {
+        return Raw + std::string(RawSkipped, '\0') + std::string(Buffer.data() + BufferPos, BufferEnd - BufferPos);
+    }
+};
+
+TError TTarExtractor::ExtractFile(TFile &file, TEntry &entry,
+                                  const std::string &key, uint64_t seq) {
+    std::string sum;
+    TError error;
+
+    Capture = false;
+
+    Stat.Files++;
+    Stat.Bytes += entry.Size;
+
+    if (entry.Size <= SMALL_FILE) {
+        std::unique_ptr<TJob> job(new TJob);
+
+        job->Data.resize(entry.Size);
+        error = Read(&job->Data[0], entry.Size);
+        if (!error)
+            error = Skip(Padding(entry.Size));
         if (error)
-            HelperError(err, "remont", error);
+            return error;
+        job->File.Swap(file);
+        job->Entry = std::move(entry);
+        job->Key = key;
+        job->Seq = seq;
+        Submit(std::move(job));
+        return OK;
+    }
 
-        error = dot.Bind(dot, MS_REC);
+    /* Large files are streamed without buffering */
+    std::vector<char> chunk(1 << 20);
+    TChecksum checksum(Algo);
+    for (uint64_t left = entry.Size; left; ) {
+        size_t size = std::min(left, (uint64_t)chunk.size());
+        error = Read(chunk.data(), size);
+        if (!error)
+            error = WriteData(file.Fd, chunk.data(), size);
         if (error)
-            HelperError(err, "bind", error);
+            return TError(error, "extract {}", entry.Path);
+        if (!Algo.empty())
+            checksum.Update(chunk.data(), size);
+        left -= size;
+    }
+
+    error = Skip(Padding(entry.Size));
+    if (error)
+        return error;
+
+    TJob job;
+    job.File.Swap(file);
+    job.Entry = std::move(entry);
+    if (!Algo.empty())
+        sum = checksum.Hex();
+    error = RunJob(job, sum);
+    if (!error && !key.empty()) {
+        std::lock_guard<std::mutex> guard(Mutex);
+        SaveSum(key, seq, sum);
+    }
+    return error;
+}
+
+TError TTarExtractor::ExtractDir(const char *name, const std::string &path,
+                                 TEntry &entry) {
+    std::unique_ptr<TDirTime> dir(new TDirTime);
+    int flags = O_RDONLY | O_CLOEXEC | O_DIRECTORY | O_NOCTTY | O_NOFOLLOW;
+    TError error;
+
+    if (mkdirat(LastDirFd.Fd, name, 0700) && errno != EEXIST)
+        return TError::System("mkdir {}", entry.Path);
+
+    error = dir->Dir.OpenAt(LastDirFd, name, flags, 0);
+
+    /* Replace non-directory */
+    if (error && (error.Errno == ENOTDIR || error.Errno == ELOOP)) {
+        if (unlinkat(LastDirFd.Fd, name, 0) || mkdirat(LastDirFd.Fd, name, 0700))
+            return TError::System("replace {}", entry.Path);
+        error = dir->Dir.OpenAt(LastDirFd, name, flags, 0);
+    }
+
+    if (!error)
+        error = SetAttrs(dir->Dir.Fd, entry);
+    if (error)
+        return error;
+
+    dir->Path = path;
+    dir->Mtime = entry.Mtime;
+    Dirs.push_back(std::move(dir));
+    return OK;
+}
 
-        error = TPath("../" + path.BaseName()).Chdir();
+TError TTarExtractor::ExtractEntry(TEntry &entry) {
+    std::vector<std::string> names, target;
+    std::string dir_path;
+    TFile file, target_dir;
+    TError error;
+
+    error = SplitPath(entry.Path, names);
+    if (error)
+        return error;
+
+    bool data = entry.Type == '0' || entry.Type == '7';
+
+    /* Payload of unknown entries must be replayed into tar as is */
+    if (entry.Type < '0' || entry.Type > '7')
+        return TError(EError::NotSupported, "Unsupported tar entry type '{}' for {}", entry.Type, entry.Path);
+
+    if (!data || names.empty()) {
+        error = SkipData(entry.Size + Padding(entry.Size));
         if (error)
-            HelperError(err, "chdir bind", error);
+            return error;
+    }
 
-        error = dot.Remount(MS_BIND | MS_REC | MS_ALLOW_WRITE);
+    if (names.empty()) {
+        if (entry.Type != '5')
+            return TError(EError::InvalidValue, "Non-directory root entry in archive");
+        error = FlushDirs("");
         if (error)
-            HelperError(err, "remount bind", error);
-    } else {
-        error = root.Chdir();
+            return error;
+        std::unique_ptr<TDirTime> dir(new TDirTime);
+        error = dir->Dir.Dup(Root);
+        if (!error)
+            error = SetAttrs(Root.Fd, entry);
         if (error)
-            HelperError(err, "root chdir", error);
+            return error;
+        dir->Mtime = entry.Mtime;
+        Dirs.push_back(std::move(dir));
+        return OK;
     }
 
-    error = caps.ApplyLimit();
+    if (Layer) {
+        /* Content of whiteouted directories is dropped */
+        for (size_t i = 0; i + 1 < names.size(); i++)
+            if (StringStartsWith(names[i], ".wh."))
+                return data ? SkipData(entry.Size + Padding(entry.Size)) : OK;
+    }
+
+    error = OpenParent(names, dir_path);
     if (error)
-        HelperError(err, "caps", error);
+        return error;
 
-    TFile::CloseAll({STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO});
+    const std::string &base = names.back();
+    const char *name = base.c_str();
 
-    const char **argv = (const char **)malloc(sizeof(*argv) * (command.size() + 1));
-    for (size_t i = 0; i < command.size(); i++)
-        argv[i] = command[i].c_str();
-    argv[command.size()] = nullptr;
+    error = FlushDirs((dir_path + base).c_str());
+    if (error)
+        return error;
 
-    execvp(argv[0], (char **)argv);
+    /* Handle aufs whiteouts and metadata */
+    if (Layer && StringStartsWith(base, ".wh.")) {
+        if (data) {
+            error = SkipData(entry.Size + Padding(entry.Size));
+            if (error)
+                return error;
+        }
 
-    err.SetFd = STDERR_FILENO;
-    HelperError(err, fmt::format("Cannot execute {}", argv[0]), TError::System("exec"));
+        /* Opaque directory - hide entries in lower layers */
+        if (base == ".wh..wh..opq") {
+            if (syscall(SYS_fsetxattr, LastDirFd.Fd, "trusted.overlay.opaque", "y", 1, 0))
+                return TError::System("setxattr trusted.overlay.opaque {}", dir_path);
+            return OK;
+        }
+
+        /* Metadata is done */
+        if (StringStartsWith(base, ".wh..wh."))
+            return OK;
+
+        std::string real = base.substr(4);
+        error = RemoveExisting(real.c_str(), true);
+        if (error || Merge)
+            return error;
+
+        error = OpenParent(names, dir_path);
+        if (error)
+            return error;
+
+        /* Convert into overlayfs whiteout */
+        if (mknodat(LastDirFd.Fd, real.c_str(), S_IFCHR, 0))
+            return TError::System("mknod {}{}", dir_path, real);
+        return OK;
+    }
+
+    if (entry.Type == '5')
+        return ExtractDir(name, dir_path + base, entry);
+
+    if (entry.Type == '1') {
+        error = SplitPath(entry.Link, target);
+        if (!error && target.empty())
+            error = TError(EError::InvalidValue, "Hardlink {} without target", entry.Path);
+        if (!error)
+            error = OpenParent(target, target_dir, false);
+        if (error)
+            return error;
+    }
+
+    mode_t type = entry.Type == '3' ? S_IFCHR : entry.Type == '4' ? S_IFBLK : S_IFIFO;
+
+    auto create = [&]() -> int {
+        switch (entry.Type) {
+        case '0':
+        case '7':
+            file.SetFd = openat(LastDirFd.Fd, name, O_WRONLY | O_CREAT | O_EXCL |
+                                O_CLOEXEC | O_NOCTTY | O_NOFOLLOW, 0600);
+            return file ? 0 : -1;
+        case '1':
+            return linkat(target_dir.Fd, target.back().c_str(), LastDirFd.Fd, name, 0);
+        case '2':
+            return symlinkat(entry.Link.c_str(), LastDirFd.Fd, name);
+        default:
+            return mknodat(LastDirFd.Fd, name, type | (entry.Mode & 07777), entry.Dev);
+        }
+    };
+
+    if (entry.Type == '5')
+        return TError(EError::NotSupported, "Unsupported tar entry type '{}' for {}", entry.Type, entry.Path);
+
+    /* Replace existing entry like tar does, directories are kept */
+    int ret = create();
+    if (ret && errno == EEXIST) {
+        error = RemoveExisting(name, false);
+        if (!error && !LastDirFd)
+            error = OpenParent(names, dir_path);
+        if (error)
+            return error;
+        ret = create();
+    }
+    if (ret)
+        return TError::System("create {}", entry.Path);
+
+    /* Content of regular files is hashed while it is in memory */
+    std::string key = Sums ? dir_path + base : "";
+    uint64_t seq = 0;
+
+    if (!key.empty()) {
+        std::lock_guard<std::mutex> guard(Mutex);
+        Sums->erase(key);
+        if (data)
+            SumSeq[key] = seq = ++LastSeq;
+        else
+            SumSeq.erase(key);
+    }
+
+    if (data)
+        return ExtractFile(file, entry, key, seq);
+
+    Stat.Files++;
+
+    if (entry.Type == '1')
+        return OK;
+
+    if (fchownat(LastDirFd.Fd, name, entry.Uid, entry.Gid, AT_SYMLINK_NOFOLLOW))
+        return TError::System("chown {}", entry.Path);
+
+    if (entry.Type != '2') {
+        if (fchmodat(LastDirFd.Fd, name, entry.Mode & 07777, 0))
+            return TError::System("chmod {}", entry.Path);
+
+        /* Xattrs of special files are set by path, symlinks are not followed */
+        if (!entry.Xattrs.empty() &&
+                !file.OpenAt(LastDirFd, name, O_PATH | O_CLOEXEC | O_NOFOLLOW, 0)) {
+            for (auto &xattr: entry.Xattrs)
+                (void)syscall(SYS_setxattr, file.ProcPath().c_str(), xattr.first.c_str(),
+                              xattr.second.data(), xattr.second.size(), 0);
+        }
+    }
+
+    return SetTimes(LastDirFd.Fd, name, entry.Mtime);
 }
 
-TError CopyRecursive(const TPath &src, const TPath &dst) {
+TError TTarExtractor::Extract(const TPath &dst) {
+    std::map<std::string, std::string> pax;
+    std::string long_name, long_link;
+    char header[BLOCK];
     TError error;
-    TFile dir;
+
+    error = Root.OpenDir(dst);
+    if (error)
+        return error;
+
+    while (!error) {
+        if (long_name.empty() && long_link.empty() && pax.empty()) {
+            Raw.clear();
+            RawSkipped = 0;
+            Capture = true;
+        }
+
+        error = Read(header, BLOCK);
+        if (error)
+            break;
+
+        /* Archive ends with zero blocks */
+        unsigned sum = 0;
+        bool zero = true;
+        for (size_t i = 0; i < BLOCK; i++) {
+            sum += (i >= 148 && i < 156) ? ' ' : (unsigned char)header[i];
+            zero = zero && !header[i];
+        }
+        if (zero)
+            break;
+
+        if (sum != ParseNumber(header + 148, 8)) {
+            error = TError(EError::InvalidValue, "Broken tar header checksum");
+            break;
+        }
+
+        TEntry entry;
+
+        entry.Type = header[156] ? header[156] : '0';
+        entry.Size = ParseNumber(header + 124, 12);
+
+        switch (entry.Type) {
+        case 'L':
+            error = ReadString(entry.Size, long_name, true);
+            continue;
+        case 'K':
+            error = ReadString(entry.Size, long_link, true);
+            continue;
+        case 'x':
+        {
+            std::string data;
+            error = ReadString(entry.Size, data, false);
+            if (!error)
+                error = ParsePax(data, pax);
+            continue;
+        }
+        case 'g':
+        case 'V':
+        {
+            /* Global headers are kept for tar, size is limited like pax */
+            std::string data;
+            error = ReadString(entry.Size, data, false);
+            continue;
+        }
+        case 'S':
+        case 'M':
+            error = TError(EError::NotSupported, "Sparse and multi-volume archives are not supported");
+            continue;
+        }
+
+        entry.Path = ParseString(header, 100);
+        /* POSIX ustar keeps long names in prefix, GNU uses this space differently */
+        if (!memcmp(header + 257, "ustar\0", 6) && header[345])
+            entry.Path = ParseString(header + 345, 155) + "/" + entry.Path;
+        entry.Link = ParseString(header + 157, 100);
+        entry.Mode = ParseNumber(header + 100, 8);
+        entry.Uid = ParseNumber(header + 108, 8);
+        entry.Gid = ParseNumber(header + 116, 8);
+        entry.Mtime.tv_sec = ParseNumber(header + 136, 12);
+        entry.Dev = makedev(ParseNumber(header + 329, 8), ParseNumber(header + 337, 8));
+
+        if (!long_name.empty())
+            entry.Path = long_name;
+        if (!long_link.empty())
+            entry.Link = long_link;
+        long_name.clear();
+        long_link.clear();
+
+        if (!pax.empty()) {
+            error = ApplyPax(pax, entry);
+            pax.clear();
+            if (error)
+                break;
+        }
+
+        /* Old archives mark directories with trailing slash */
+        if (entry.Type == '0' && StringEndsWith(entry.Path, "/"))
+            entry.Type = '5';
+
+        auto xattrs = std::move(entry.Xattrs);
+        entry.Xattrs.clear();
+        for (auto &xattr: xattrs)
+            if (KeepXattr(xattr.first))
+                entry.Xattrs.push_back(std::move(xattr));
+
+        error = ExtractEntry(entry);
+        if (!error)
+            error = GetError();
+    }
+
+    /* Consume trailing blocks, otherwise decompressor would get EPIPE */
+    if (!error) {
+        ssize_t ret;
+        while ((ret = read(Input.Fd, Buffer.data(), Buffer.size())) > 0 ||
+               (ret < 0 && errno == EINTR));
+    }
+
+    /* Wait workers, then set times of remaining directories */
+    Mutex.lock();
+    Finished = true;
+    Mutex.unlock();
+    Wakeup.notify_all();
+    for (auto &thread: Workers)
+        thread.join();
+    Workers.clear();
+
+    if (!error)
+        error = GetError();
+
+    if (!error)
+        error = FlushDirs(nullptr);
+
+    return error;
+}
+
+/* Feeds tar with unsupported part of archive */
+static TError ExtractRest(const TFile &input, const std::string &head,
+                          const std::function<TError(const TFile &rest)> &fallback) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC))
+        return TError::System("pipe2");
+
+    TFile rest(fds[0]), output(fds[1]);
+
+    std::thread writer([&] {
+        std::vector<char> buf(1 << 20);
+        ssize_t len;
+
+        if (output.WriteAll(head))
+            return;
+        while ((len = read(input.Fd, buf.data(), buf.size())) > 0 ||
+               (len < 0 && errno == EINTR)) {
+            if (len > 0 && output.WriteAll(std::string(buf.data(), len)))
+                break;
+        }
+        output.Close();
+    });
+
+    TError error = fallback(rest);
+
+    /* Unblock writer if tar failed in the middle */
+    rest.Close();
+    writer.join();
+
+    return error;
+}
+
+TError ExtractTar(const TFile &input, const TPath &dst, bool layer, bool merge,
+                  TCopyStat *stat, const std::string &algo, TChecksumMap *sums,
+                  const std::function<TError(const TFile &rest)> &fallback) {
+    int threads = std::min(config().volumes().extract_threads(), GetNumCores());
+    std::string text, head;
+    TCopyStat local;
+    TFile dir, result;
+    TError error;
+
+    if (!stat)
+        stat = &local;
 
     error = dir.OpenDir(dst);
     if (error)
         return error;
 
-    return RunCommand({ "cp", "--archive", "--force",
-                        "--one-file-system", "--no-target-directory",
-                        src.ToString(), "." }, dir);
+    /* Helper works in the same place by absolute path */
+    TPath root = dir.RealPath();
+
+    /* Result: stat, unsupported part of archive, "path\0sum\0" records */
+    error = RunHelper("extract", dir, { input.Fd }, result, [&]() -> TError {
+        TTarExtractor extractor(input, *stat, layer, merge, algo, sums, std::max(threads - 1, 0));
+        TError err = extractor.Extract(root);
+
+        std::string rest = err == EError::NotSupported ? extractor.Unconsumed() : "";
+        uint64_t header[4] = { stat->Files, stat->Bytes, stat->Cloned, rest.size() };
+        std::string out((const char *)header, sizeof(header));
+
+        out += rest;
+        if (sums) {
+            for (auto &it: *sums)
+                out += it.first + '\0' + it.second + '\0';
+        }
+
+        if (!err)
+            err = result.WriteAll(out);
+        else
+            (void)result.WriteAll(out);
+        return err;
+    });
+
+    if (!error || error == EError::NotSupported) {
+        uint64_t header[4];
+        TError error2 = result.ReadAll(text, 1ull << 40);
+
+        if (!error2 && text.size() < sizeof(header))
+            error2 = TError("Broken extract result");
+        if (error2)
+            return error2;
+
+        memcpy(header, text.data(), sizeof(header));
+        stat->Files = header[0];
+        stat->Bytes = header[1];
+        stat->Cloned = header[2];
+
+        size_t pos = sizeof(header) + header[3];
+        if (pos > text.size())
+            return TError("Broken extract result");
+        head = text.substr(sizeof(header), header[3]);
+
+        while (sums && pos < text.size()) {
+            size_t sep = text.find('\0', pos);
+            size_t end = sep == std::string::npos ? sep : text.find('\0', sep + 1);
+            if (end == std::string::npos)
+                return TError("Broken extract result");
+            (*sums)[text.substr(pos, sep - pos)] = text.substr(sep + 1, end - sep - 1);
+            pos = end + 1;
+        }
+    }
+
+    /* Hand over the rest of archive starting from failed entry */
+    if (error == EError::NotSupported && fallback) {
+        L_ACT("Cannot extract {} in-process: {}, continue with tar", dst, error);
+        Statistics->LayerExtractFallback++;
+        if (sums)
+            sums->clear();
+        error = ExtractRest(input, head, fallback);
+    }
+
+    return error;
+}
+
+TError TStreamRelay::Start(const TFile &stream, bool input, uint64_t timeout_ms, TFile &end) {
+    int fds[2];
+    TError error;
+
+    error = Stream.Dup(stream);
+    if (error)
+        return error;
+
+    if (pipe2(fds, O_CLOEXEC))
+        return TError::System("pipe2");
+
+    TFile rd(fds[0]), wr(fds[1]);
+
+    Input = input;
+    Timeout = timeout_ms;
+    Pipe.Swap(input ? wr : rd);
+    end.Swap(input ? rd : wr);
+
+    Thread = std::thread(&TStreamRelay::Relay, this);
+
+    return OK;
+}
+
+void TStreamRelay::Relay() {
+    int timeout = Timeout ? std::min(Timeout, (uint64_t)INT_MAX) : -1;
+    std::vector<char> buf(Input ? (1 << 20) : PIPE_BUF);
+    ssize_t len = 0, off = 0;
+
+    while (!Error) {
+        struct pollfd pfd[2] = {
+            { Stream.Fd, (short)(Input ? POLLIN : POLLOUT), 0 },
+            { Pipe.Fd, 0, 0 },
+        };
+
+        if (!Input && off == len) {
+            /* Helpers write into pipe, EOF when they are done */
+            len = read(Pipe.Fd, buf.data(), buf.size());
+            if (len < 0 && errno == EINTR)
+                continue;
+            if (len < 0)
+                Error = TError::System("read pipe");
+            if (len <= 0)
+                break;
+            off = 0;
+        }
+
+        int ret = poll(pfd, Input ? 2 : 1, timeout);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0) {
+            Error = TError::System("poll");
+        } else if (!ret) {
+            Error = TError(EError::Busy, "Client stream stalled for {} ms", Timeout);
+        } else if (Input && pfd[1].revents) {
+            /* Helpers are gone and do not need the rest */
+            break;
+        } else if (Input) {
+            len = read(Stream.Fd, buf.data(), buf.size());
+            if (len < 0 && (errno == EINTR || errno == EAGAIN))
+                continue;
+            if (len < 0)
+                Error = TError::System("read stream");
+            else if (!len)
+                break;
+            else
+                Error = Pipe.WriteAll(std::string(buf.data(), len));
+            /* Reader closed pipe after end of archive, rest is not needed */
+            if (Error && Error.Errno == EPIPE) {
+                Error = OK;
+                break;
+            }
+        } else if (pfd[0].revents & (POLLERR | POLLHUP)) {
+            Error = TError(EError::Unknown, EPIPE, "Client stream closed");
+        } else {
+            /* Write at most PIPE_BUF after POLLOUT to never block */
+            ret = write(Stream.Fd, buf.data() + off, len - off);
+            if (ret < 0 && errno != EINTR && errno != EAGAIN)
+                Error = TError::System("write stream");
+            else if (ret > 0)
+                off += ret;
+        }
+    }
+
+    /* Helpers see EOF or EPIPE */
+    Pipe.Close();
+    Stream.Close();
+}
+
+TError TStreamRelay::Finish() {
+    if (Thread.joinable())
+        Thread.join();
+    return Error;
+}
+
+TStreamRelay::~TStreamRelay() {
+    (void)Finish();
+}
+
+/*
+ * Checksums are saved into xattrs of regular files: tree is walked by one
+ * thread, content is read and hashed by bounded pool of workers.
+ */
+class TTreeHasher {
+    const std::string &Algo;
+
+    std::vector<std::thread> Workers;
+    std::deque<TPath> Queue;
+    std::mutex Mutex;
+    std::condition_variable Wakeup;
+    size_t MaxQueue;
+    bool Finished = false;
+    TError Error;
+
+    TError RunJob(const TPath &path) {
+        std::string sum;
+        TFile file;
+
+        TError error = file.OpenRead(path);
+        if (!error)
+            error = FileChecksum(file, Algo, sum);
+        if (!error)
+            error = SaveChecksum(file, Algo, sum);
+        return error;
+    }
+
+    void Worker() {
+        std::unique_lock<std::mutex> lock(Mutex);
+
+        while (true) {
+            Wakeup.wait(lock, [&]{ return Finished || !Queue.empty(); });
+            if (Queue.empty())
+                break;
+            TPath path = std::move(Queue.front());
+            Queue.pop_front();
+            Wakeup.notify_all();
+            lock.unlock();
+            TError error = RunJob(path);
+            lock.lock();
+            if (error && !Error)
+                Error = error;
+        }
+    }
+
+    TError Submit(const TPath &path) {
+        std::unique_lock<std::mutex> lock(Mutex);
+
+        if (Workers.empty()) {
+            lock.unlock();
+            return RunJob(path);
+        }
+
+        Wakeup.wait(lock, [&]{ return Queue.size() < MaxQueue; });
+        Queue.push_back(path);
+        Wakeup.notify_all();
+        return Error;
+    }
+
+public:
+    TTreeHasher(const std::string &algo, int threads) : Algo(algo), MaxQueue(threads * 16) {
+        for (int i = 0; i < threads; i++)
+            Workers.emplace_back(&TTreeHasher::Worker, this);
+    }
+
+    ~TTreeHasher() {
+        Mutex.lock();
+        Finished = true;
+        Mutex.unlock();
+        Wakeup.notify_all();
+        for (auto &thread: Workers)
+            thread.join();
+    }
+
+    TError Run(const TPath &root, uint64_t &space) {
+        TPathWalk walk;
+        TError error;
+
+        space = 0;
+
+        error = walk.OpenScan(root);
+        while (!error) {
+            error = walk.Next();
+            if (error || !walk.Path)
+                break;
+            if (!walk.Postorder)
+                space += walk.Stat->st_blocks * 512ull;
+            if (S_ISREG(walk.Stat->st_mode))
+                error = Submit(walk.Path);
+        }
+
+        Mutex.lock();
+        Finished = true;
+        Mutex.unlock();
+        Wakeup.notify_all();
+        for (auto &thread: Workers)
+            thread.join();
+        Workers.clear();
+
+        if (!error)
+            error = Error;
+
+        return error;
+    }
+};
+
+TError ChecksumRecursive(const TPath &root, const std::string &algo, uint64_t &space) {
+    int threads = std::min(config().volumes().checksum_threads(), GetNumCores());
+    TTreeHasher hasher(algo, std::max(threads - 1, 0));
+
+    return hasher.Run(root, space);
 }
 
 TError ClearRecursive(const TPath &path) {
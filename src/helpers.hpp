@@ -1,13 +1,54 @@
 #include <cgroup.hpp>
+#include <functional>
 #include <string>
+#include <thread>
 #include <vector>
 #include "util/path.hpp"
+#include "util/checksum.hpp"
 
 TError RunCommand(const std::vector<std::string> &command,
                   const TFile &dir = TFile(),
                   const TFile &input = TFile(),
                   const TFile &output = TFile(),
                   const TCapabilities &caps = HelperCapabilities);
-TError CopyRecursive(const TPath &src, const TPath &dst);
+struct TCopyStat {
+    uint64_t Files = 0;
+    uint64_t Bytes = 0;
+    uint64_t Cloned = 0;
+};
+
+TError CopyRecursive(const TPath &src, const TPath &dst, TCopyStat *stat = nullptr);
+TError CopyFile(const TFile &src, const TFile &dst, TCopyStat *stat = nullptr);
+
+/*
+ * Unsupported rest of archive is passed to fallback, usually tar.
+ * With algo regular files get checksum xattr, sums are collected by path.
+ */
+TError ExtractTar(const TFile &input, const TPath &dst, bool layer, bool merge,
+                  TCopyStat *stat = nullptr, const std::string &algo = "",
+                  TChecksumMap *sums = nullptr,
+                  const std::function<TError(const TFile &rest)> &fallback = nullptr);
+/* Pumps client stream through pipe, stalled client breaks the pipe */
+class TStreamRelay {
+    TFile Stream;
+    TFile Pipe;
+    bool Input = false;
+    uint64_t Timeout = 0;
+    std::thread Thread;
+    TError Error;
+
+    void Relay();
+
+public:
+    ~TStreamRelay();
+
+    /* Returns pipe end for helpers: readable for input, writable otherwise */
+    TError Start(const TFile &stream, bool input, uint64_t timeout_ms, TFile &end);
+
+    /* Helpers end must be closed before */
+    TError Finish();
+};
+
+TError ChecksumRecursive(const TPath &root, const std::string &algo, uint64_t &space);
 TError ClearRecursive(const TPath &path);
 TError RemoveRecursive(const TPath &path);
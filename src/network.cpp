@@ -1808,25 +1808,45 @@ void TNetwork::SyncStatLocked() {
     }
 }
 
+/*
+ * Statistics are synced if they are older than this request
+ * and were not refreshed by concurrent request within share window.
+ */
+bool TNetwork::NeedSyncStat(int gen) const {
+    return gen - StatGen > 0 &&
+        GetCurrentTimeMs() - StatTime >= config().daemon().sync_share_ms();
+}
+
 void TNetwork::SyncStat() {
     auto ourGen = GlobalStatGen.fetch_add(1) + 1;
     auto net_lock = LockNet();
-    if (ourGen - StatGen > 0)
+    if (NeedSyncStat(ourGen))
         SyncStatLocked();
 }
 
-void TNetwork::SyncAllStat() {
-    auto nets = Networks();
+/* Class statistics for all containers are collected in host network */
+void TNetwork::SyncStats(std::list<std::shared_ptr<TNetwork>> nets) {
     auto ourGen = GlobalStatGen.fetch_add(1) + 1;
-    for (auto &net: *nets) {
-        if (ourGen - net->StatGen > 0) {
+
+    if (HostNetwork)
+        nets.push_front(HostNetwork);
+    nets.sort();
+    nets.unique();
+
+    for (auto &net: nets) {
+        if (net->NeedSyncStat(ourGen)) {
             auto lock = net->LockNet();
-            if (ourGen - net->StatGen > 0)
+            if (net->NeedSyncStat(ourGen))
                 net->SyncStatLocked();
         }
     }
 }
 
+void TNetwork::SyncAllStat() {
+    auto nets = Networks();
+    SyncStats(std::list<std::shared_ptr<TNetwork>>(nets->begin(), nets->end()));
+}
+
 TError TNetwork::StartNetwork(TContainer &ct, TTaskEnv &task) {
     TNetEnv env;
 
@@ -2394,7 +2414,7 @@ void TNetEnv::FormatIp(TMultiTuple &ip_settings) {
             ip_settings.push_back({ dev.Name , ip.Format() });
 }
 
-TError TNetEnv::ParseGw(TMultiTuple &gw_settings) {
+TError TNetEnv::ParseGw(const TMultiTuple &gw_settings) {
     TError error;
     TNlAddr ip;
 
@@ -2828,11 +2848,11 @@ TError TNetEnv::Parse(TContainer &ct) {
     if (error)
         return error;
 
-    error = ParseGw(ct.DefaultGw);
+    error = ParseGw(ct.Sparse().DefaultGw);
     if (error)
         return error;
 
-    for (const auto &it: ct.Sysctl) {
+    for (const auto &it: ct.Sparse().Sysctl) {
         if (TNetwork::NetworkSysctl(it.first))
             NetSysctl[it.first] = it.second;
     }
@@ -158,6 +158,7 @@ class TNetwork : public TPortoNonCopyable {
 
     TError TrySetupClasses(TNetClass &cls, bool safe = false);
 
+    bool NeedSyncStat(int gen) const;
     void SyncStatLocked();
     TError Reconnect();
     TError RepairLocked();
@@ -218,6 +219,7 @@ public:
     TError SetupPolice(TNetDevice &dev);
 
     void SyncStat();
+    static void SyncStats(std::list<std::shared_ptr<TNetwork>> nets);
     static void SyncAllStat();
 
     TError GetL3Gate(TNetDeviceConfig &dev);
@@ -318,7 +320,7 @@ struct TNetEnv {
     TError ParseNet(TMultiTuple &net_settings);
     TError ParseIp(TMultiTuple &ip_settings);
     void FormatIp(TMultiTuple &ip_settings);
-    TError ParseGw(TMultiTuple &gw_settings);
+    TError ParseGw(const TMultiTuple &gw_settings);
 
     TError CheckIpLimit();
 
@@ -2157,6 +2157,7 @@ public:
         "    -Q <volume> <squashfs>   export upper layer into squashfs\n"
         "    -c compression           override compression\n"
         "    -G <layer>               retrieve layer stored private value\n"
+        "    tarball \"-\" streams archive from stdin or into stdout\n"
         "    -v                       be verbose\n"
         ) {}
 
@@ -2195,27 +2196,39 @@ public:
             compression = "squashfs";
 
         std::string path;
-        if (args.size() >= 2)
+        bool stream = false;
+        if (args.size() >= 2) {
+            stream = args[1] == "-";
             path = TPath(args[1]).AbsolutePath().ToString();
+        }
 
         if (import) {
             if (args.size() < 2)
                 return EXIT_FAILURE;
-            ret = Api->ImportLayer(args[0], path, false, place, private_value);
+            if (stream)
+                ret = Api->ImportLayerFd(args[0], STDIN_FILENO, compression, false, place, private_value);
+            else
+                ret = Api->ImportLayer(args[0], path, false, place, private_value);
             if (ret)
                 PrintError("Cannot import layer");
 
         } else if (export_ || squash) {
             if (args.size() < 2)
                 return EXIT_FAILURE;
-            ret = Api->ExportLayer(args[0], path, compression);
+            if (stream)
+                ret = Api->ExportLayerFd(args[0], STDOUT_FILENO, compression);
+            else
+                ret = Api->ExportLayer(args[0], path, compression);
             if (ret)
                 PrintError("Cannot export layer");
 
         } else if (merge) {
             if (args.size() < 2)
                 return EXIT_FAILURE;
-            ret = Api->ImportLayer(args[0], path, true, place, private_value);
+            if (stream)
+                ret = Api->ImportLayerFd(args[0], STDIN_FILENO, compression, true, place, private_value);
+            else
+                ret = Api->ImportLayer(args[0], path, true, place, private_value);
             if (ret)
                 PrintError("Cannot merge layer");
 
@@ -384,6 +384,9 @@ static void PortodServer() {
 
     StartRpcQueue();
     EventQueue->Start();
+    TContainer::StartStatsSampler();
+    TStorage::StartTrash();
+    TStorage::StartLayerCache();
 
     if (config().daemon().log_rotate_ms()) {
         TEvent ev(EEventType::RotateLogs);
@@ -470,6 +473,31 @@ static void PortodServer() {
                     EventQueue->Add(0, e);
                 }
 
+            } else if (source->Flags & EPOLL_EVENT_PRESSURE) {
+                auto container = source->Container.lock();
+
+                if (!container) {
+                    L_WRN("Container not found for pressure fd {}", source->Fd);
+                    EpollLoop->StopInput(source->Fd);
+                } else
+                    container->RecvPressureEvent(source->Fd);
+
+            } else if (source->Flags & EPOLL_EVENT_STREAM) {
+                TStdStream::RecvFollowEvents(source->Fd);
+
+            } else if (source->Flags & EPOLL_EVENT_ROTATE) {
+                TStdStream::RecvRotateEvents(source->Fd);
+
+            } else if (source->Flags & (EPOLL_EVENT_STDOUT | EPOLL_EVENT_STDERR)) {
+                auto container = source->Container.lock();
+
+                if (!container)
+                    EpollLoop->StopInput(source->Fd);
+                else if (source->Flags & EPOLL_EVENT_STDOUT)
+                    container->Stdout.RecvRing(container, source->Fd);
+                else
+                    container->Stderr.RecvRing(container, source->Fd);
+
             } else if (Clients.find(source->Fd) != Clients.end()) {
                 auto client = Clients[source->Fd];
                 error = client->Event(ev.events);
@@ -503,6 +531,9 @@ exit:
     Clients.clear();
 
     L_SYS("Stop threads...");
+    TContainer::StopStatsSampler();
+    TStorage::StopLayerCache();
+    TStorage::StopTrash();
     EventQueue->Stop();
     StopRpcQueue();
 }
@@ -12,6 +12,7 @@
 #include "util/proc.hpp"
 #include "util/cred.hpp"
 #include <sstream>
+#include <type_traits>
 
 extern "C" {
 #include <sys/sysinfo.h>
@@ -28,6 +29,35 @@ TProperty::TProperty(std::string name, EProperty prop, std::string desc) {
     ContainerProperties[name] = this;
 }
 
+TError TPropertyRef::Resolve(const std::string &property) {
+    Property = property;
+    Prop = nullptr;
+    IsLabel = false;
+    Type.clear();
+
+    Error = TContainer::ParsePropertyName(property, Name, Index);
+    if (Error)
+        return Error;
+
+    if (Index.empty()) {
+        auto dot = property.find('.');
+
+        if (dot != std::string::npos) {
+            Type = property.substr(0, dot);
+            IsLabel = Type.find_first_not_of(PORTO_LABEL_PREFIX_CHARS) == std::string::npos;
+            return OK;
+        }
+    }
+
+    auto it = ContainerProperties.find(Name);
+    if (it == ContainerProperties.end())
+        Error = TError(EError::InvalidProperty, "Unknown container property: " + Name);
+    else
+        Prop = it->second;
+
+    return Error;
+}
+
 TError TProperty::Has() {
     return OK;
 }
@@ -118,6 +148,20 @@ TError TProperty::Start(void) {
     return OK;
 }
 
+/* Write number right into destination without temporary string */
+template <typename T>
+static typename std::enable_if<std::is_integral<T>::value>::type
+FormatNumber(T val, std::string &str) {
+    fmt::FormatInt num(val);
+    str.assign(num.data(), num.size());
+}
+
+template <typename T>
+static typename std::enable_if<std::is_floating_point<T>::value>::type
+FormatNumber(T val, std::string &str) {
+    str = std::to_string(val);
+}
+
 template <typename T>
 class TReferenceProperty : public TProperty {
 public:
@@ -164,7 +208,7 @@ public:
         auto it = val.find(index);
         if (it == val.end())
             return TError(EError::InvalidValue, "Index not found {}", index);
-        value = std::to_string(it->second);
+        FormatNumber(it->second, value);
         return OK;
     }
     TError GetIntIndexed(const std::string &index, uint64_t &value) {
@@ -217,8 +261,8 @@ class TTypedProperty : public TProperty {
 public:
     TTypedProperty(std::string name, EProperty prop, std::string desc) :
         TProperty(name, prop, desc) {}
-    virtual std::string Format(T val) {
-        return std::to_string(val);
+    virtual void Format(T val, std::string &str) {
+        FormatNumber(val, str);
     }
     virtual TError Parse(const std::string &str, T &val) = 0;
     virtual TError Get(T &val) = 0;
@@ -236,7 +280,7 @@ public:
         TError error = Get(val);
         if (error)
             return error;
-        str = Format(val);
+        Format(val, str);
         return OK;
     }
     TError Set(const std::string &str) {
@@ -251,7 +295,7 @@ public:
         TError error = Get(index, val);
         if (error)
             return error;
-        str = Format(val);
+        Format(val, str);
         return OK;
     }
     TError SetIndexed(const std::string &index, const std::string &str) {
@@ -301,8 +345,8 @@ class TBoolProperty : public TTypedProperty<bool> {
 public:
     TBoolProperty(std::string name, EProperty prop, std::string desc) :
         TTypedProperty<bool> (name, prop, desc) {}
-    std::string Format(bool val) {
-        return BoolToString(val);
+    void Format(bool val, std::string &str) {
+        str = BoolToString(val);
     }
     TError Parse(const std::string &str, bool &val) {
         return StringToBool(str, val);
@@ -352,8 +396,11 @@ class TDateTimeProperty : public TTypedProperty<uint64_t> {
 public:
     TDateTimeProperty(std::string name, EProperty prop, std::string desc) :
         TTypedProperty<uint64_t>(name, prop, desc) {}
-    std::string Format(uint64_t val) {
-        return val ? FormatTime(val) : "";
+    void Format(uint64_t val, std::string &str) {
+        if (val)
+            str = FormatTime(val);
+        else
+            str.clear();
     }
     TError Parse(const std::string &str, uint64_t &val) {
         return StringToUint64(str, val);
@@ -365,7 +412,7 @@ public:
         TError error = Get(val);
         if (error)
             return error;
-        value = std::to_string(val);
+        FormatNumber(val, value);
         return OK;
     }
     TError GetInt(uint64_t &value) {
@@ -380,8 +427,8 @@ class TCpuPowerProperty : public TTypedProperty<uint64_t> {
 public:
     TCpuPowerProperty(std::string name, EProperty prop, std::string desc) :
         TTypedProperty<uint64_t>(name, prop, desc) {}
-    std::string Format(uint64_t val) {
-        return fmt::format("{:g}c", (double)val / NSEC_PER_SEC);
+    void Format(uint64_t val, std::string &str) {
+        str = fmt::format("{:g}c", (double)val / NSEC_PER_SEC);
     }
     TError Parse(const std::string &str, uint64_t &value) {
         std::string unit;
@@ -432,8 +479,8 @@ class TWeightProperty : public TTypedProperty<double> {
 public:
     TWeightProperty(std::string name, EProperty prop, std::string desc) :
         TTypedProperty<double>(name, prop, desc) {}
-    std::string Format(double val) {
-        return fmt::format("{:g}", val);
+    void Format(double val, std::string &str) {
+        str = fmt::format("{:g}", val);
     }
     TError Parse(const std::string &str, double &val) {
         std::string unit;
@@ -1468,6 +1515,31 @@ public:
     }
 } static StdoutLimit;
 
+class TStdoutRing : public TBoolProperty {
+public:
+    TStdoutRing() : TBoolProperty(P_STDOUT_RING, EProperty::STDOUT_RING,
+            "Keep stdout and stderr in memory ring of stdout_limit bytes") {}
+    TError Get(bool &val) {
+        val = CT->Stdout.Ring;
+        return OK;
+    }
+    TError Set(bool val) {
+        CT->Stdout.Ring = val;
+        CT->Stderr.Ring = val;
+        CT->SetProp(EProperty::STDOUT_RING);
+        return OK;
+    }
+    void Dump(Porto::TContainer &spec, bool val) {
+        spec.set_stdout_ring(val);
+    }
+    bool Has(const Porto::TContainer &spec) {
+        return spec.has_stdout_ring();
+    }
+    void Load(const Porto::TContainer &spec, bool &val) {
+        val = spec.stdout_ring();
+    }
+} static StdoutRing;
+
 class TStdoutOffset : public TSizeProperty {
 public:
     TStdoutOffset() : TSizeProperty(P_STDOUT_OFFSET, EProperty::NONE,
@@ -1770,8 +1842,8 @@ public:
         CT->SetProp(EProperty::UMASK);
         return OK;
     }
-    std::string Format(unsigned val) {
-        return fmt::format("{:#o}", val);
+    void Format(unsigned val, std::string &str) {
+        str = fmt::format("{:#o}", val);
     }
     TError Parse(const std::string &str, unsigned &val) {
         return StringToOct(str, val);
@@ -2056,14 +2128,14 @@ public:
         IsDynamic = true;
     }
     TError Get(std::string &value) {
-        for (auto &link: CT->Symlink)
+        for (auto &link: CT->Sparse().Symlink)
             value += fmt::format("{}: {}; ", link.first, link.second);
         return OK;
     }
     TError GetIndexed(const std::string &key, std::string &value) {
         TPath sym = TPath(key).NormalPath();
-        auto it = CT->Symlink.find(sym);
-        if (it == CT->Symlink.end())
+        auto it = CT->Sparse().Symlink.find(sym);
+        if (it == CT->Sparse().Symlink.end())
             return TError(EError::NoValue, "Symlink {} not set", key);
         value = it->second.ToString();
         return OK;
@@ -2084,7 +2156,7 @@ public:
             auto tgt = TPath(link.second).NormalPath();
             symlink[sym] = tgt;
         }
-        for (auto &link: CT->Symlink) {
+        for (auto &link: CT->Sparse().Symlink) {
             if (!symlink.count(link.first))
                 symlink[link.first] = "";
         }
@@ -2097,7 +2169,7 @@ public:
     }
     void Dump(Porto::TContainer &spec) {
         auto out = spec.mutable_symlink();
-        for (auto &link: CT->Symlink) {
+        for (auto &link: CT->Sparse().Symlink) {
             auto sym = out->add_map();
             sym->set_key(link.first.ToString());
             sym->set_val(link.second.ToString());
@@ -2114,7 +2186,7 @@ public:
             map[sym.key()] = sym.val();
 
         if (!spec.symlink().merge())
-            for (auto &sym: CT->Symlink)
+            for (auto &sym: CT->Sparse().Symlink)
                 if (!map.count(sym.first.ToString()))
                         map[sym.first.ToString()] = "";
 
@@ -2225,21 +2297,21 @@ class TDefaultGw : public TConfigProperty {
 public:
     TDefaultGw() : TConfigProperty(P_DEFAULT_GW, EProperty::DEFAULT_GW,
             "Default gateway: <interface> <ip>; ...") {}
-    TMultiTuple &Get() {
-        return CT->DefaultGw;
+    const TMultiTuple &Get() {
+        return CT->Sparse().DefaultGw;
     }
     TError Set(TMultiTuple &val) {
         TNetEnv NetEnv;
         TError error = NetEnv.ParseGw(val);
         if (error)
             return error;
-        CT->DefaultGw = val;
+        CT->MutableSparse().DefaultGw = val;
         CT->SetProp(EProperty::DEFAULT_GW);
         return OK;
     }
     void Dump(Porto::TContainer &spec) {
         auto out = spec.mutable_default_gw();
-        for (auto &line: CT->DefaultGw) {
+        for (auto &line: CT->Sparse().DefaultGw) {
             auto ip = out->add_cfg();
             ip->set_dev(line[0]);
             ip->set_ip(line[1]);
@@ -2315,16 +2387,16 @@ public:
     {
     }
     TError Get(std::string &value) {
-        value = CT->EtcHosts;
+        value = CT->Sparse().EtcHosts;
         return OK;
     }
     TError Set(const std::string &value) {
-        CT->EtcHosts = value;
+        CT->MutableSparse().EtcHosts = value;
         CT->SetProp(EProperty::ETC_HOSTS);
         return OK;
     }
     void Dump(Porto::TContainer &spec) {
-        spec.set_etc_hosts(CT->EtcHosts);
+        spec.set_etc_hosts(CT->Sparse().EtcHosts);
     }
     bool Has(const Porto::TContainer &spec) {
         return spec.has_etc_hosts();
@@ -3331,8 +3403,8 @@ public:
         IsSupported = MemorySubsystem.SupportIoLimit() ||
          BlkioSubsystem.HasThrottler;
     }
-    TUintMap &Get() {
-        return CT->IoBpsLimit;
+    const TUintMap &Get() {
+        return CT->Sparse().IoBpsLimit;
     }
     TError Set(TUintMap &map) {
         TError error;
@@ -3349,7 +3421,7 @@ public:
                 return error;
         }
 
-        CT->IoBpsLimit = map;
+        CT->MutableSparse().IoBpsLimit = map;
         CT->SetProp(EProperty::IO_LIMIT);
         return OK;
     }
@@ -3375,8 +3447,8 @@ public:
         IsSupported = MemorySubsystem.SupportIoLimit() ||
          BlkioSubsystem.HasThrottler;
     }
-    TUintMap &Get() {
-        return CT->IoOpsLimit;
+    const TUintMap &Get() {
+        return CT->Sparse().IoOpsLimit;
     }
     TError Set(TUintMap &map) {
         TError error;
@@ -3393,7 +3465,7 @@ public:
                 return error;
         }
 
-        CT->IoOpsLimit = map;
+        CT->MutableSparse().IoOpsLimit = map;
         CT->SetProp(EProperty::IO_OPS_LIMIT);
         return OK;
     }
@@ -3667,6 +3739,8 @@ public:
     TError Set(int64_t val) {
         CT->AgingTime = val * 1000;
         CT->SetProp(EProperty::AGING_TIME);
+        if (CT->State == EContainerState::DEAD)
+            CT->ScheduleAgedDestroy();
         return OK;
     }
     void Dump(Porto::TContainer &spec, int64_t val) {
@@ -3899,7 +3973,7 @@ public:
         IsReadOnly = true;
     }
     TError Get(std::string &value) {
-        value = std::to_string((unsigned)CT->State);
+        FormatNumber((unsigned)CT->State, value);
         return OK;
     }
     TError GetInt(uint64_t &value) {
@@ -4370,40 +4444,32 @@ public:
     }
     TError Get(std::string &value) {
         TError error;
+        TUintMap map;
         TVmStat st;
 
         error = CT->GetVmStat(st);
         if (error)
             return error;
 
-        UintMapToString(st.Stat, value);
+        st.Get(map);
+        UintMapToString(map, value);
         return OK;
     }
     TError GetIndexed(const std::string &index, std::string &value) {
-        TError error;
-        TVmStat st;
-
-        error = CT->GetVmStat(st);
-        if (error)
-            return error;
-        auto it = st.Stat.find(index);
-        if (it == st.Stat.end())
-            return TError(EError::InvalidProperty, "Unknown {}", index);
-        value = std::to_string(it->second);
-        return OK;
+        uint64_t val;
+        TError error = GetIntIndexed(index, val);
+        if (!error)
+            FormatNumber(val, value);
+        return error;
     }
     TError GetIntIndexed(const std::string &index, uint64_t &value) {
         TError error;
         TVmStat st;
 
-        error = CT->GetVmStat(st);
+        error = CT->GetVmStat(st, TVmStat::Brief(index));
         if (error)
             return error;
-        auto it = st.Stat.find(index);
-        if (it == st.Stat.end())
-            return TError(EError::InvalidProperty, "Unknown {}", index);
-        value = it->second;
-        return OK;
+        return st.Get(index, value);
     }
     void Dump(Porto::TContainer &spec) {
         TVmStat st;
@@ -4477,6 +4543,135 @@ public:
     }
 } static CpuSystem;
 
+class TStatsRate : public TProperty {
+public:
+    const TStatsHistory::EColumn Column;
+
+    TStatsRate(std::string name, TStatsHistory::EColumn column, std::string desc) :
+        TProperty(name, EProperty::NONE, desc), Column(column)
+    {
+        IsReadOnly = true;
+        IsRuntimeOnly = true;
+    }
+    void Init(void) {
+        IsSupported = config().daemon().stats_sample_ms() != 0;
+    }
+    TError GetIntIndexed(const std::string &index, uint64_t &value) {
+        uint64_t window = 0;
+        TError error;
+
+        /* plain number is seconds */
+        if (index.find_first_not_of("0123456789") == std::string::npos) {
+            error = StringToUint64(index, window);
+            window *= 1000;
+        } else {
+            error = StringToNsec(index, window);
+            window /= 1000000;
+        }
+        if (error)
+            return error;
+
+        value = CT->Stats.Rate(Column, window);
+        return OK;
+    }
+    TError GetIndexed(const std::string &index, std::string &value) {
+        uint64_t val;
+        TError error = GetIntIndexed(index, val);
+        if (!error)
+            FormatNumber(val, value);
+        return error;
+    }
+    TError GetInt(uint64_t &value) {
+        value = CT->Stats.Rate(Column, 0);
+        return OK;
+    }
+    TError Get(std::string &value) {
+        FormatNumber((uint64_t)CT->Stats.Rate(Column, 0), value);
+        return OK;
+    }
+    virtual void Dump(Porto::TContainer &spec, uint64_t value) = 0;
+    void Dump(Porto::TContainer &spec) {
+        Dump(spec, CT->Stats.Rate(Column, 0));
+    }
+};
+
+class TCpuUsageRate : public TStatsRate {
+public:
+    TCpuUsageRate() : TStatsRate(P_CPU_USAGE_RATE, TStatsHistory::CPU_USAGE,
+            "CPU usage rate [nanoseconds per second], index: [window]") {}
+    void Dump(Porto::TContainer &spec, uint64_t value) {
+        spec.set_cpu_usage_rate(value);
+    }
+} static CpuUsageRate;
+
+class TCpuSystemRate : public TStatsRate {
+public:
+    TCpuSystemRate() : TStatsRate(P_CPU_SYSTEM_RATE, TStatsHistory::CPU_SYSTEM,
+            "System CPU usage rate [nanoseconds per second], index: [window]") {}
+    void Dump(Porto::TContainer &spec, uint64_t value) {
+        spec.set_cpu_usage_system_rate(value);
+    }
+} static CpuSystemRate;
+
+class TIoReadRate : public TStatsRate {
+public:
+    TIoReadRate() : TStatsRate(P_IO_READ_RATE, TStatsHistory::IO_READ,
+            "Disk read rate [bytes per second], index: [window]") {}
+    void Dump(Porto::TContainer &spec, uint64_t value) {
+        spec.set_io_read_rate(value);
+    }
+} static IoReadRate;
+
+class TIoWriteRate : public TStatsRate {
+public:
+    TIoWriteRate() : TStatsRate(P_IO_WRITE_RATE, TStatsHistory::IO_WRITE,
+            "Disk write rate [bytes per second], index: [window]") {}
+    void Dump(Porto::TContainer &spec, uint64_t value) {
+        spec.set_io_write_rate(value);
+    }
+} static IoWriteRate;
+
+class TIoOpsRate : public TStatsRate {
+public:
+    TIoOpsRate() : TStatsRate(P_IO_OPS_RATE, TStatsHistory::IO_OPS,
+            "Disk operations rate [operations per second], index: [window]") {}
+    void Dump(Porto::TContainer &spec, uint64_t value) {
+        spec.set_io_ops_rate(value);
+    }
+} static IoOpsRate;
+
+class TStatsHistoryProperty : public TProperty {
+public:
+    TStatsHistoryProperty() : TProperty(P_STATS_HISTORY, EProperty::NONE,
+            "Sampled counters, index: <counter>, format: <time ms>: <value>;...")
+    {
+        IsReadOnly = true;
+        IsRuntimeOnly = true;
+    }
+    void Init(void) {
+        IsSupported = config().daemon().stats_sample_ms() != 0;
+    }
+    TError Get(std::string &value) {
+        for (int i = 1; i < TStatsHistory::NR_COLUMNS; i++)
+            value += fmt::format("{}{}", i > 1 ? ";" : "", TStatsHistory::ColumnName[i]);
+        return OK;
+    }
+    TError GetIndexed(const std::string &index, std::string &value) {
+        std::vector<std::pair<uint64_t, uint64_t>> series;
+
+        for (int i = 1; i < TStatsHistory::NR_COLUMNS; i++) {
+            if (index != TStatsHistory::ColumnName[i])
+                continue;
+            CT->Stats.Series(TStatsHistory::EColumn(i), series);
+            for (auto &it: series)
+                value += fmt::format("{}{}: {}", value.empty() ? "" : "; ", it.first, it.second);
+            return OK;
+        }
+
+        return TError(EError::InvalidProperty, "Unknown counter {}", index);
+    }
+} static StatsHistory;
+
 class TCpuWait : public TNsecProperty {
 public:
     TCpuWait() : TNsecProperty(P_CPU_WAIT, EProperty::NONE,
@@ -4524,6 +4719,139 @@ public:
     }
 } static CpuThrottled;
 
+class TPressureProperty : public TProperty {
+public:
+    const std::string Resource;
+
+    TPressureProperty(std::string name, std::string resource, std::string desc) :
+        TProperty(name, EProperty::NONE, desc), Resource(resource)
+    {
+        IsReadOnly = true;
+        IsRuntimeOnly = true;
+        RequireControllers = CGROUP_CPUACCT;
+    }
+    void Init(void) {
+        IsSupported = CpuacctSubsystem.SupportPressure();
+    }
+    TError GetPressure(TPressure &pressure) {
+        auto cg = CT->GetCgroup(CpuacctSubsystem);
+        return CpuacctSubsystem.GetPressure(cg, Resource, pressure);
+    }
+    TError Get(std::string &value) {
+        TPressure pressure;
+        TError error = GetPressure(pressure);
+        if (!error)
+            value = pressure.Format();
+        return error;
+    }
+    TError GetIndexed(const std::string &index, std::string &value) {
+        TPressure pressure;
+        TError error = GetPressure(pressure);
+        if (!error)
+            error = pressure.Get(index, value);
+        return error;
+    }
+    virtual Porto::TPressure *Mutable(Porto::TContainer &spec) = 0;
+    void Dump(Porto::TContainer &spec) {
+        TPressure pressure;
+        if (!GetPressure(pressure))
+            pressure.Dump(*Mutable(spec));
+    }
+};
+
+class TCpuPressure : public TPressureProperty {
+public:
+    TCpuPressure() : TPressureProperty(P_CPU_PRESSURE, "cpu",
+            "CPU pressure stall: <some|full>_<avg10|avg60|avg300|total>: <value>;...") {}
+    Porto::TPressure *Mutable(Porto::TContainer &spec) {
+        return spec.mutable_cpu_pressure();
+    }
+} static CpuPressure;
+
+class TMemoryPressure : public TPressureProperty {
+public:
+    TMemoryPressure() : TPressureProperty(P_MEMORY_PRESSURE, "memory",
+            "Memory pressure stall: <some|full>_<avg10|avg60|avg300|total>: <value>;...") {}
+    Porto::TPressure *Mutable(Porto::TContainer &spec) {
+        return spec.mutable_memory_pressure();
+    }
+} static MemoryPressure;
+
+class TIoPressure : public TPressureProperty {
+public:
+    TIoPressure() : TPressureProperty(P_IO_PRESSURE, "io",
+            "IO pressure stall: <some|full>_<avg10|avg60|avg300|total>: <value>;...") {}
+    Porto::TPressure *Mutable(Porto::TContainer &spec) {
+        return spec.mutable_io_pressure();
+    }
+} static IoPressure;
+
+class TPressureTrigger : public TConfigProperty {
+public:
+    TPressureTrigger() : TConfigProperty(P_PRESSURE_TRIGGER, EProperty::PRESSURE_TRIGGER,
+            "Pressure stall triggers: <cpu|memory|io> <some|full> <stall usec> <window usec> [event|kill]; ...")
+    {
+        RequireControllers = CGROUP_CPUACCT;
+    }
+    void Init(void) {
+        IsSupported = CpuacctSubsystem.SupportPressure();
+    }
+    const TMultiTuple &Get() {
+        return CT->Sparse().PressureTrigger;
+    }
+    TError Set(TMultiTuple &cfg) {
+        std::set<std::string> seen;
+
+        for (auto &line: cfg) {
+            uint64_t stall, window;
+
+            if (line.size() != 4 && line.size() != 5)
+                return TError(EError::InvalidValue, "wrong format");
+            if (line[0] != "cpu" && line[0] != "memory" && line[0] != "io")
+                return TError(EError::InvalidValue, "Invalid pressure resource: {}", line[0]);
+            if (line[1] != "some" && line[1] != "full")
+                return TError(EError::InvalidValue, "Invalid pressure type: {}", line[1]);
+            if (StringToUint64(line[2], stall) || StringToUint64(line[3], window) ||
+                    !stall || stall > window)
+                return TError(EError::InvalidValue, "Invalid pressure stall or window");
+            /* Kernel accepts window from 500ms to 10s */
+            if (window < 500000 || window > 10000000)
+                return TError(EError::InvalidValue, "Pressure window {} out of range 500000..10000000 us", window);
+            if (line.size() > 4 && line[4] != "event" && line[4] != "kill")
+                return TError(EError::InvalidValue, "Invalid pressure action: {}", line[4]);
+            if (!seen.insert(line[0] + " " + line[1]).second)
+                return TError(EError::InvalidValue, "Duplicate pressure trigger {} {}", line[0], line[1]);
+        }
+
+        CT->MutableSparse().PressureTrigger = cfg;
+        CT->SetProp(EProperty::PRESSURE_TRIGGER);
+        return OK;
+    }
+    void Dump(Porto::TContainer &spec) {
+        auto out = spec.mutable_pressure_trigger();
+        for (auto &line: CT->Sparse().PressureTrigger) {
+            auto trigger = out->add_trigger();
+            trigger->set_resource(line[0]);
+            trigger->set_type(line[1]);
+            trigger->set_stall(std::stoull(line[2]));
+            trigger->set_window(std::stoull(line[3]));
+            trigger->set_action(line.size() > 4 ? line[4] : "event");
+        }
+    }
+    bool Has(const Porto::TContainer &spec) {
+        return spec.has_pressure_trigger();
+    }
+    TError Load(const Porto::TContainer &spec) {
+        TMultiTuple cfg;
+        for (auto &trigger: spec.pressure_trigger().trigger())
+            cfg.push_back({trigger.resource(), trigger.type(),
+                           std::to_string(trigger.stall()),
+                           std::to_string(trigger.window()),
+                           trigger.has_action() ? trigger.action() : "event"});
+        return Set(cfg);
+    }
+} static PressureTrigger;
+
 class TNetClassId : public TProperty {
 public:
     TNetClassId() : TProperty(P_NET_CLASS_ID, EProperty::NONE,
@@ -4673,7 +5001,7 @@ public:
         auto it = cur.find(index);
         if (it == cur.end())
             return TError(EError::InvalidValue, "invalid index " + index);
-        value = std::to_string(it->second);
+        FormatNumber(it->second, value);
         return OK;
     }
 
@@ -4801,7 +5129,7 @@ public:
     TError GetIndexed(const std::string &index, std::string &value) {
         uint64_t val;
         TError error = GetIntIndexed(index, val);
-        value = std::to_string(val);
+        FormatNumber(val, value);
         return error;
     }
 
@@ -4923,7 +5251,7 @@ public:
     TError GetIndexed(const std::string &index, std::string &value) {
         uint64_t val;
         TError error = GetIntIndexed(index, val);
-        value = std::to_string(val);
+        FormatNumber(val, value);
         return error;
     }
     void DumpMap(Porto::TUintMap &dump) {
@@ -5165,6 +5493,14 @@ void TPortoStat::Populate(TUintMap &m) {
         L_ERR("Can't get memory usage of portod");
     m["memory_usage_mb"] = usage / 1024 / 1024;
 
+    TVmStat vm;
+    if (!vm.ParseStatm(getpid())) {
+        m["porto_rss"] = vm.Stat[TVmStat::VM_USED];
+        m["porto_rss_per_container"] = vm.Stat[TVmStat::VM_USED] /
+            std::max<uint64_t>(Statistics->ContainersCount, 1);
+    }
+    m["container_struct_size"] = sizeof(TContainer);
+
     m["epoll_sources"] = Statistics->EpollSources;
 
     m["log_lines"] = Statistics->LogLines;
@@ -5182,6 +5518,7 @@ void TPortoStat::Populate(TUintMap &m) {
     m["containers_started"] = Statistics->ContainersStarted;
     m["containers_failed_start"] = Statistics->ContainersFailedStart;
     m["containers_oom"] = Statistics->ContainersOOM;
+    m["containers_pressure"] = Statistics->ContainersPressure;
     m["containers_tainted"] = Statistics->ContainersTainted;
 
     m["running"] = RootContainer->RunningChildren;
@@ -5191,6 +5528,17 @@ void TPortoStat::Populate(TUintMap &m) {
     m["layer_import"] = Statistics->LayerImport;
     m["layer_export"] = Statistics->LayerExport;
     m["layer_remove"] = Statistics->LayerRemove;
+    m["layer_dedup_files"] = Statistics->LayerDedupFiles;
+    m["layer_dedup_bytes"] = Statistics->LayerDedupBytes;
+    m["layer_objects_removed"] = Statistics->LayerObjectsRemoved;
+    m["layer_extract_fallback"] = Statistics->LayerExtractFallback;
+    m["layer_cache_hits"] = Statistics->LayerCacheHits;
+    m["layer_cache_misses"] = Statistics->LayerCacheMisses;
+    m["layer_cache_evictions"] = Statistics->LayerCacheEvictions;
+
+    m["trash_entries"] = Statistics->TrashEntries;
+    m["trash_space"] = Statistics->TrashSpace;
+    m["trash_removed"] = Statistics->TrashRemoved;
 
     m["volumes"] = Statistics->VolumesCount;
     m["volumes_created"] = Statistics->VolumesCreated;
@@ -5211,11 +5559,14 @@ void TPortoStat::Populate(TUintMap &m) {
 
     m["container_clients"] = CT->ClientsCount;
     m["container_oom"] = CT->OomEvents;
+    m["container_pressure"] = CT->PressureEvents;
     m["container_requests"] = CT->ContainerRequests;
 
     m["requests_queued"] = Statistics->RequestsQueued;
     m["requests_completed"] = Statistics->RequestsCompleted;
     m["requests_failed"] = Statistics->RequestsFailed;
+    m["get_values"] = Statistics->GetValues;
+    m["get_value_allocs"] = Statistics->GetValueAllocs;
 
     m["fail_system"] = Statistics->FailSystem;
     m["fail_invalid_value"] = Statistics->FailInvalidValue;
@@ -5255,7 +5606,7 @@ TError TPortoStat::GetIndexed(const std::string &index,
     if (m.find(index) == m.end())
         return TError(EError::InvalidValue, "Invalid subscript for property");
 
-    value = std::to_string(m[index]);
+    FormatNumber(m[index], value);
 
     return OK;
 }
@@ -5329,13 +5680,13 @@ public:
             "Sysctl, format: name: value;...") {}
 
     TError Get(std::string &value) {
-        value = StringMapToString(CT->Sysctl);
+        value = StringMapToString(CT->Sparse().Sysctl);
         return OK;
     }
 
     TError GetIndexed(const std::string &index, std::string &value) {
-        auto it = CT->Sysctl.find(index);
-        if (it != CT->Sysctl.end())
+        auto it = CT->Sparse().Sysctl.find(index);
+        if (it != CT->Sparse().Sysctl.end())
             value = it->second;
         else
             value = "";
@@ -5347,23 +5698,23 @@ public:
         TError error = StringToStringMap(value, map);
         if (error)
             return error;
-        CT->Sysctl = map;
+        CT->MutableSparse().Sysctl = map;
         CT->SetProp(EProperty::SYSCTL);
         return OK;
     }
 
     TError SetIndexed(const std::string &index, const std::string &value) {
         if (value == "")
-            CT->Sysctl.erase(index);
+            CT->MutableSparse().Sysctl.erase(index);
         else
-            CT->Sysctl[index] = value;
+            CT->MutableSparse().Sysctl[index] = value;
         CT->SetProp(EProperty::SYSCTL);
         return OK;
     }
 
     void Dump(Porto::TContainer &spec) {
         auto out = spec.mutable_sysctl();
-        for (auto &it: CT->Sysctl) {
+        for (auto &it: CT->Sparse().Sysctl) {
             auto s = out->add_map();
             s->set_key(it.first);
             s->set_val(it.second);
@@ -5374,12 +5725,12 @@ public:
     }
     TError Load(const Porto::TContainer &spec) {
         if (!spec.sysctl().merge())
-            CT->Sysctl.clear();
+            CT->MutableSparse().Sysctl.clear();
         for (auto &it: spec.sysctl().map()) {
             if (it.has_val())
-                CT->Sysctl[it.key()] = it.val();
+                CT->MutableSparse().Sysctl[it.key()] = it.val();
             else
-                CT->Sysctl.erase(it.key());
+                CT->MutableSparse().Sysctl.erase(it.key());
         }
         CT->SetProp(EProperty::SYSCTL);
         return OK;
@@ -33,6 +33,7 @@ constexpr const char *P_STDIN_PATH = "stdin_path";
 constexpr const char *P_STDOUT_PATH = "stdout_path";
 constexpr const char *P_STDERR_PATH = "stderr_path";
 constexpr const char *P_STDOUT_LIMIT = "stdout_limit";
+constexpr const char *P_STDOUT_RING = "stdout_ring";
 
 constexpr const char *P_MEM_GUARANTEE = "memory_guarantee";
 constexpr const char *P_MEM_LIMIT = "memory_limit";
@@ -50,6 +51,7 @@ constexpr const char *P_MAX_RSS = "max_rss";
 constexpr const char *P_CACHE_USAGE = "cache_usage";
 constexpr const char *P_SHMEM_USAGE = "shmem_usage";
 constexpr const char *P_MLOCK_USAGE = "mlock_usage";
+constexpr const char *P_MEMORY_PRESSURE = "memory_pressure";
 constexpr const char *P_HUGETLB_USAGE = "hugetlb_usage";
 constexpr const char *P_MINOR_FAULTS = "minor_faults";
 constexpr const char *P_MAJOR_FAULTS = "major_faults";
@@ -69,8 +71,12 @@ constexpr const char *P_CPU_SET = "cpu_set";
 constexpr const char *P_CPU_SET_AFFINITY  = "cpu_set_affinity";
 constexpr const char *P_CPU_USAGE = "cpu_usage";
 constexpr const char *P_CPU_SYSTEM = "cpu_usage_system";
+constexpr const char *P_CPU_USAGE_RATE = "cpu_usage_rate";
+constexpr const char *P_CPU_SYSTEM_RATE = "cpu_usage_system_rate";
+constexpr const char *P_STATS_HISTORY = "stats_history";
 constexpr const char *P_CPU_WAIT = "cpu_wait";
 constexpr const char *P_CPU_THROTTLED = "cpu_throttled";
+constexpr const char *P_CPU_PRESSURE = "cpu_pressure";
 
 constexpr const char *P_IO_POLICY = "io_policy";
 constexpr const char *P_IO_WEIGHT = "io_weight";
@@ -114,6 +120,7 @@ constexpr const char *P_OOM_SCORE_ADJ = "oom_score_adj";
 constexpr const char *P_THREAD_LIMIT = "thread_limit";
 constexpr const char *P_SYSCTL = "sysctl";
 constexpr const char *P_CORE_COMMAND = "core_command";
+constexpr const char *P_PRESSURE_TRIGGER = "pressure_trigger";
 
 constexpr const char *P_ID = "id";
 constexpr const char *P_LEVEL = "level";
@@ -149,8 +156,12 @@ constexpr const char *P_NET_TX_DROPS = "net_tx_drops";
 constexpr const char *P_IO_READ = "io_read";
 constexpr const char *P_IO_WRITE = "io_write";
 constexpr const char *P_IO_OPS = "io_ops";
+constexpr const char *P_IO_READ_RATE = "io_read_rate";
+constexpr const char *P_IO_WRITE_RATE = "io_write_rate";
+constexpr const char *P_IO_OPS_RATE = "io_ops_rate";
 constexpr const char *P_IO_TIME = "io_time";
 constexpr const char *P_IO_WAIT = "io_wait";
+constexpr const char *P_IO_PRESSURE = "io_pressure";
 constexpr const char *P_TIME = "time";
 constexpr const char *P_CREATION_TIME = "creation_time";
 constexpr const char *P_START_TIME = "start_time";
@@ -251,6 +262,8 @@ enum class EProperty {
     NET_RX_LIMIT,
     CORE_COMMAND,
     REQUIRED_VOLUMES,
+    PRESSURE_TRIGGER,
+    STDOUT_RING,
     NR_PROPERTIES,
 };
 
@@ -298,6 +311,19 @@ public:
 
 void InitContainerProperties(void);
 
+/* Property name resolved once per request and reused for all containers */
+struct TPropertyRef {
+    std::string Property;
+    std::string Name;
+    std::string Index;
+    std::string Type;       /* label prefix or controller for dotted names */
+    bool IsLabel = false;
+    TProperty *Prop = nullptr;
+    TError Error;
+
+    TError Resolve(const std::string &property);
+};
+
 class TContainer;
 extern __thread TContainer *CT;
 extern std::map<std::string, TProperty*> ContainerProperties;
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <functional>
 
 #include "rpc.hpp"
 #include "client.hpp"
@@ -23,6 +24,8 @@ extern "C" {
 #include <sys/stat.h>
 }
 
+static void RunParallel(size_t count, const std::function<void(size_t)> &func);
+
 void TRequest::Classify() {
 
     /* Normally not logged in non-verbose mode */
@@ -38,6 +41,7 @@ void TRequest::Classify() {
         Req.has_getdataproperty() ||
         Req.has_getproperty() ||
         Req.has_getintproperty() ||
+        Req.has_readstream() ||
         Req.has_listdataproperties() ||
         Req.has_listproperties() ||
         Req.has_listvolumeproperties() ||
@@ -102,6 +106,18 @@ void TRequest::Parse() {
             opts = { "property=" + Req.getintproperty().property(), "index=" +  Req.getintproperty().index() };
         else
             opts = { "property=" + Req.getintproperty().property() };
+    } else if (Req.has_readstream()) {
+        Cmd = "ReadStream";
+        Arg = Req.readstream().name();
+        opts = { "stream=" + Req.readstream().stream() };
+        if (Req.readstream().has_offset())
+            opts.push_back("offset=" + std::to_string(Req.readstream().offset()));
+        if (Req.readstream().has_limit())
+            opts.push_back("limit=" + std::to_string(Req.readstream().limit()));
+        if (Req.readstream().has_timeout_ms())
+            opts.push_back("timeout=" + std::to_string(Req.readstream().timeout_ms()));
+        if (Req.readstream().fd())
+            opts.push_back("fd=true");
     } else if (Req.has_setintproperty()) {
         Cmd = "Set";
         Arg = Req.setintproperty().name();
@@ -239,6 +255,8 @@ void TRequest::Parse() {
             opts.push_back("merge=true");
         if (Req.importlayer().has_private_value())
             opts.push_back("private=" + Req.importlayer().private_value());
+        if (Req.importlayer().fd())
+            opts.push_back("fd=true");
     } else if (Req.has_exportlayer()) {
         if (Req.exportlayer().has_layer()) {
             Cmd = "ReexportLayer";
@@ -252,6 +270,8 @@ void TRequest::Parse() {
             opts.push_back("compress=" + Req.exportlayer().compress());
         if (Req.exportlayer().has_place())
             opts.push_back("place=" + Req.exportlayer().place());
+        if (Req.exportlayer().fd())
+            opts.push_back("fd=true");
     } else if (Req.has_removelayer()) {
         Cmd = "RemoveLayer";
         Arg = Req.removelayer().layer();
@@ -364,6 +384,9 @@ static std::string ResponseAsString(const Porto::TPortoResponse &resp) {
         ret = resp.getproperty().value();
     } else if (resp.has_getintproperty()) {
         ret = std::to_string(resp.getintproperty().value());
+    } else if (resp.has_readstream()) {
+        ret = fmt::format("offset={} size={} data={}", resp.readstream().offset(),
+                          resp.readstream().size(), resp.readstream().data().size());
     } else if (resp.has_getdataproperty()) {
         ret = resp.getdataproperty().value();
     } else if (resp.has_get()) {
@@ -510,11 +533,11 @@ noinline TError SetContainer(const Porto::TSetContainerRequest &req,
 noinline TError GetContainer(const Porto::TGetContainerRequest &req,
                              Porto::TGetContainerResponse &rsp) {
     std::list<std::string> masks, names;
-    std::vector<std::string> props;
+    std::vector<TPropertyRef> props(req.property_size());
     TError error;
 
-    for(auto &prop: req.property())
-        props.push_back(prop);
+    for (int i = 0; i < req.property_size(); i++)
+        props[i].Resolve(req.property(i));
 
     for (auto &name: req.name()) {
         if (name.find_first_of("*?") == std::string::npos)
@@ -544,8 +567,16 @@ noinline TError GetContainer(const Porto::TGetContainerRequest &req,
         }
     }
 
-    for (auto &name: names) {
+    std::vector<std::string> list(names.begin(), names.end());
+    std::vector<Porto::TContainer> specs(list.size());
+    std::vector<TError> errors(list.size());
+    std::vector<bool> skip(list.size(), false);
+
+    RunParallel(list.size(), [&](size_t index) {
+        auto &name = list[index];
+        auto &spec = specs[index];
         std::shared_ptr<TContainer> ct;
+        TError error;
 
         auto lock = LockContainers();
 
@@ -566,29 +597,36 @@ noinline TError GetContainer(const Porto::TGetContainerRequest &req,
                 if (match)
                     break;
             }
-            if (!match)
-                continue;
+            if (!match) {
+                skip[index] = true;
+                return;
+            }
         }
 
         lock.unlock();
 
-        if (error && names.size() == 1)
-            return error;
-
-        auto spec = rsp.add_container();
-        spec->set_name(name);
+        spec.set_name(name);
         if (error) {
-            error.Dump(*spec->add_error());
-            continue;
+            errors[index] = error;
+            error.Dump(*spec.add_error());
+            return;
         }
 
         if (req.has_changed_since() && ct->ChangeTime < req.changed_since()) {
-            spec->set_change_time(ct->ChangeTime);
-            spec->set_no_changes(true);
-            continue;
+            spec.set_change_time(ct->ChangeTime);
+            spec.set_no_changes(true);
+            return;
         }
 
-        ct->Dump(props, *spec);
+        ct->Dump(props, spec);
+    });
+
+    if (list.size() == 1 && errors[0] && !skip[0])
+        return errors[0];
+
+    for (size_t index = 0; index < list.size(); index++) {
+        if (!skip[index])
+            rsp.add_container()->Swap(&specs[index]);
     }
 
     rsp.set_absolute_namespace(ROOT_PORTO_NAMESPACE + CL->PortoNamespace);
@@ -708,6 +746,42 @@ noinline TError FindLabel(const Porto::TFindLabelRequest &req, Porto::TFindLabel
     bool wild_label = label.find_first_of("*?") != std::string::npos;
 
     auto lock = LockContainers();
+
+    /* Exact label is served from index, inherited labels need full scan */
+    if (!wild_label && label[0] != '.') {
+        auto found = req.has_value() ? TContainer::FindLabel(label, req.value()) :
+                                       TContainer::FindLabel(label);
+        if (!found)
+            return OK;
+
+        for (auto &it: *found) {
+            auto ct = it.second;
+            std::string name;
+
+            if (!StringStartsWith(ct->Name, CL->PortoNamespace))
+                continue;
+
+            if (req.has_state() && TContainer::StateName(ct->State) != req.state())
+                continue;
+
+            name = ct->Name.substr(CL->PortoNamespace.length());
+            if (req.has_mask() && !StringMatch(name, req.mask()))
+                continue;
+
+            auto val = ct->Labels.find(label);
+            if (val == ct->Labels.end())
+                continue;
+
+            auto l = rsp.add_list();
+            l->set_name(name);
+            l->set_state(TContainer::StateName(ct->State));
+            l->set_label(label);
+            l->set_value(val->second);
+        }
+
+        return OK;
+    }
+
     for (auto &it: Containers) {
         auto &ct = it.second;
         std::string value;
@@ -815,8 +889,6 @@ noinline TError GetContainerProperty(const Porto::TGetPropertyRequest &req,
     std::shared_ptr<TContainer> ct;
     TError error = CL->ReadContainer(req.name(), ct);
     if (!error) {
-        std::string value;
-
         ct->LockStateRead();
 
         if (req.has_real() && req.real()) {
@@ -828,15 +900,51 @@ noinline TError GetContainerProperty(const Porto::TGetPropertyRequest &req,
         if (req.has_sync() && req.sync())
             ct->SyncProperty(req.property());
 
-        error = ct->GetProperty(req.property(), value);
-        if (!error)
-            rsp.mutable_getproperty()->set_value(value);
+        error = ct->GetProperty(req.property(),
+                                *rsp.mutable_getproperty()->mutable_value());
+        if (error)
+            rsp.clear_getproperty();
 out:
         ct->UnlockState();
     }
     return error;
 }
 
+noinline TError ReadStream(const Porto::TReadStreamRequest &req,
+                           Porto::TPortoResponse &rsp) {
+    std::shared_ptr<TContainer> ct;
+    TFile file;
+
+    if (req.stream() != "stdout" && req.stream() != "stderr")
+        return TError(EError::InvalidValue, "Unknown stream: {}", req.stream());
+
+    TError error = CL->ReadContainer(req.name(), ct);
+    if (error)
+        return error;
+
+    auto stream = rsp.mutable_readstream();
+
+    ct->LockStateRead();
+    if (ct->State & (EContainerState::STOPPED | EContainerState::STARTING))
+        error = TError(EError::InvalidState, "{} is not available in {} state",
+                       req.stream(), TContainer::StateName(ct->State));
+    else if (req.stream() == "stdout")
+        error = ct->Stdout.Read(*ct, req, *stream, file);
+    else
+        error = ct->Stderr.Read(*ct, req, *stream, file);
+    ct->UnlockState();
+
+    if (!error && stream->size() <= stream->offset() && req.timeout_ms())
+        error = TStdStream::Follow(ct, CL->shared_from_this(), req, file);
+
+    if (error)
+        rsp.clear_readstream();
+    else if (stream->fd())
+        CL->StreamFd.Swap(file);
+
+    return error;
+}
+
 noinline TError SetContainerProperty(const Porto::TSetPropertyRequest &req) {
     std::string property = req.property();
     std::string value = req.value();
@@ -916,8 +1024,6 @@ noinline TError GetDataProperty(const Porto::TGetDataPropertyRequest &req,
     std::shared_ptr<TContainer> ct;
     TError error = CL->ReadContainer(req.name(), ct);
     if (!error) {
-        std::string value;
-
         ct->LockStateRead();
 
         if (req.has_real() && req.real()) {
@@ -929,9 +1035,10 @@ noinline TError GetDataProperty(const Porto::TGetDataPropertyRequest &req,
         if (req.has_sync() && req.sync())
             ct->SyncProperty(req.data());
 
-        error = ct->GetProperty(req.data(), value);
-        if (!error)
-            rsp.mutable_getdataproperty()->set_value(value);
+        error = ct->GetProperty(req.data(),
+                                *rsp.mutable_getdataproperty()->mutable_value());
+        if (error)
+            rsp.clear_getdataproperty();
 out:
         ct->UnlockState();
     }
@@ -939,15 +1046,17 @@ out:
 }
 
 static void FillGetResponse(const Porto::TGetRequest &req,
-                            Porto::TGetResponse &rsp,
-                            std::string &name) {
+                            const std::vector<TPropertyRef> &vars,
+                            Porto::TGetResponse_TContainerGetListResponse *entry,
+                            const std::string &name) {
     std::shared_ptr<TContainer> ct;
+    static const size_t inlineSize = std::string().capacity();
+    uint64_t values = 0, allocs = 0;
 
     auto lock = LockContainers();
     TError containerError = CL->ResolveContainer(name, ct);
     lock.unlock();
 
-    auto entry = rsp.add_list();
     entry->set_name(name);
 
     if (!containerError) {
@@ -961,30 +1070,37 @@ static void FillGetResponse(const Porto::TGetRequest &req,
         }
     }
 
-    for (int j = 0; j < req.variable_size(); j++) {
-        auto var = req.variable(j);
-
+    for (auto &var: vars) {
         auto keyval = entry->add_keyval();
-        std::string value;
+
+        keyval->set_variable(var.Property);
 
         TError error = containerError;
         if (!error && req.has_real() && req.real())
-            error = ct->HasProperty(var);
-        if (!error)
-            error = ct->GetProperty(var, value);
+            error = ct->HasProperty(var.Property);
+        if (!error) {
+            /* Format value right into response without temporary copy */
+            auto value = keyval->mutable_value();
+            error = ct->GetProperty(var, *value);
+            values++;
+            /* Value did not fit into inline buffer of string */
+            if (value->capacity() > inlineSize)
+                allocs++;
+        }
 
-        keyval->set_variable(var);
         if (error) {
+            keyval->clear_value();
             keyval->set_error(error.Error);
             keyval->set_errormsg(error.Message());
-        } else {
-            keyval->set_value(value);
         }
     }
 
 out:
     if (!containerError)
         ct->UnlockState();
+
+    Statistics->GetValues += values;
+    Statistics->GetValueAllocs += allocs;
 }
 
 noinline TError GetContainerCombined(const Porto::TGetRequest &req,
@@ -1018,11 +1134,30 @@ noinline TError GetContainerCombined(const Porto::TGetRequest &req,
         }
     }
 
-    if (req.has_sync() && req.sync())
-        TContainer::SyncPropertiesAll();
+    if (req.has_sync() && req.sync()) {
+        std::list<std::shared_ptr<TContainer>> containers;
+        auto lock = LockContainers();
+        for (auto &name: names) {
+            std::shared_ptr<TContainer> ct;
+            if (!CL->ResolveContainer(name, ct))
+                containers.push_back(ct);
+        }
+        lock.unlock();
+        TContainer::SyncProperties(containers);
+    }
+
+    std::vector<TPropertyRef> vars(req.variable_size());
+    for (int i = 0; i < req.variable_size(); i++)
+        vars[i].Resolve(req.variable(i));
 
-    for (auto &name: names)
-        FillGetResponse(req, *get, name);
+    /* Entries are preallocated in order and filled by chunks in parallel */
+    std::vector<std::string> list(names.begin(), names.end());
+    for (size_t index = 0; index < list.size(); index++)
+        get->add_list();
+
+    RunParallel(list.size(), [&](size_t index) {
+        FillGetResponse(req, vars, get->mutable_list(index), list[index]);
+    });
 
     return OK;
 }
@@ -1086,6 +1221,9 @@ noinline TError WaitContainers(const Porto::TWaitRequest &req, bool async,
     if (!req.name_size() && !async)
         return TError(EError::InvalidValue, "Containers to wait are not set");
 
+    /* Resumed async wait replays journal instead of current state */
+    bool replay = async && req.has_since_seq();
+
     auto waiter = std::make_shared<TContainerWaiter>(async);
 
     for (auto &label: req.label())
@@ -1114,6 +1252,9 @@ noinline TError WaitContainers(const Porto::TWaitRequest &req, bool async,
 
         waiter->Names.push_back(full_name);
 
+        if (replay)
+            continue;
+
         std::shared_ptr<TContainer> ct;
         error = TContainer::Find(full_name, ct);
         if (error) {
@@ -1141,9 +1282,31 @@ noinline TError WaitContainers(const Porto::TWaitRequest &req, bool async,
         }
     }
 
-    if (!waiter->Wildcards.empty()) {
-        for (auto &it: Containers) {
-            auto &ct = it.second;
+    if (!waiter->Wildcards.empty() && !replay) {
+        std::map<std::string, TContainer *> labeled;
+        std::vector<TContainer *> candidates;
+        bool indexed = !waiter->Labels.empty();
+
+        /* Exact labels select candidates from label index */
+        for (auto &label: waiter->Labels) {
+            if (label.find_first_of("*?[\\") != std::string::npos) {
+                indexed = false;
+                break;
+            }
+            auto found = TContainer::FindLabel(label);
+            if (found)
+                labeled.insert(found->begin(), found->end());
+        }
+
+        if (indexed) {
+            for (auto &it: labeled)
+                candidates.push_back(it.second);
+        } else {
+            for (auto &it: Containers)
+                candidates.push_back(it.second.get());
+        }
+
+        for (auto ct: candidates) {
             if (!waiter->ShouldReport(*ct) || client->ComposeName(ct->Name, name))
                 continue;
 
@@ -1164,9 +1327,11 @@ noinline TError WaitContainers(const Porto::TWaitRequest &req, bool async,
     }
 
     if (req.has_timeout_ms() && req.timeout_ms() == 0) {
+        if (replay)
+            waiter->Replay(*client, req.since_seq());
         client->MakeReport("", EContainerState::UNDEFINED, async);
     } else {
-        waiter->Activate(*client);
+        waiter->Activate(*client, replay, req.since_seq());
         if (req.timeout_ms()) {
             TEvent e(EEventType::WaitTimeout, nullptr);
             e.WaitTimeout.Waiter = waiter;
@@ -1512,6 +1677,17 @@ noinline TError ImportLayer(const Porto::TImportLayerRequest &req) {
 
     layer.Owner = CL->Cred;
 
+    if (req.fd()) {
+        TFile stream;
+
+        if (!CL->RequestFd)
+            return TError(EError::InvalidValue, "No fd attached to request");
+        stream.Swap(CL->RequestFd);
+
+        return layer.ImportArchive(TPath(), req.has_compress() ? req.compress() : "",
+                                   req.merge(), stream);
+    }
+
     return layer.ImportArchive(CL->ResolvePath(req.tarball()),
                                req.has_compress() ? req.compress() : "",
                                req.merge());
@@ -1545,8 +1721,15 @@ noinline TError SetLayerPrivate(const Porto::TSetLayerPrivateRequest &req) {
 
 noinline TError ExportLayer(const Porto::TExportLayerRequest &req) {
     TStorage layer;
+    TFile stream;
     TError error;
 
+    if (req.fd()) {
+        if (!CL->RequestFd)
+            return TError(EError::InvalidValue, "No fd attached to request");
+        stream.Swap(CL->RequestFd);
+    }
+
     if (req.has_layer()) {
         error = layer.Resolve(EStorageType::Layer, req.place(), req.layer());
         if (error)
@@ -1556,8 +1739,8 @@ noinline TError ExportLayer(const Porto::TExportLayerRequest &req) {
         if (error)
             return error;
 
-        return layer.ExportArchive(CL->ResolvePath(req.tarball()),
-                                   req.has_compress() ? req.compress() : "");
+        return layer.ExportArchive(req.fd() ? TPath() : CL->ResolvePath(req.tarball()),
+                                   req.has_compress() ? req.compress() : "", stream);
     }
 
     std::shared_ptr<TVolume> volume;
@@ -1574,8 +1757,8 @@ noinline TError ExportLayer(const Porto::TExportLayerRequest &req) {
     if (error)
         return error;
 
-    return layer.ExportArchive(CL->ResolvePath(req.tarball()),
-                               req.has_compress() ? req.compress() : "");
+    return layer.ExportArchive(req.fd() ? TPath() : CL->ResolvePath(req.tarball()),
+                               req.has_compress() ? req.compress() : "", stream);
 }
 
 noinline TError RemoveLayer(const Porto::TRemoveLayerRequest &req) {
@@ -1599,9 +1782,11 @@ noinline TError ListLayers(const Porto::TListLayersRequest &req,
         return error;
 
     std::list<TStorage> layers;
-    error = place.List(EStorageType::Layer, layers, req.mask());
-    if (error)
-        return error;
+    if (!req.cache_only()) {
+        error = place.List(EStorageType::Layer, layers, req.mask());
+        if (error)
+            return error;
+    }
 
     auto list = rsp.mutable_listlayers();
     for (auto &layer: layers) {
@@ -1613,8 +1798,22 @@ noinline TError ListLayers(const Porto::TListLayersRequest &req,
         desc->set_owner_group(layer.Owner.Group());
         desc->set_private_value(layer.Private);
         desc->set_last_usage(layer.LastUsage());
+        if (layer.Size) {
+            desc->set_space_used(layer.Size);
+            desc->set_space_shared(layer.SharedSize);
+        }
     }
 
+    auto stat = TStorage::LayerCacheStat(place.Place);
+    auto cache = list->mutable_cache();
+    cache->set_place(place.Place.ToString());
+    cache->set_space_limit(stat.Limit);
+    cache->set_space_used(stat.Used);
+    cache->set_hits(stat.Hits);
+    cache->set_misses(stat.Misses);
+    cache->set_evictions(stat.Evictions);
+    cache->set_evicted_bytes(stat.EvictedBytes);
+
     return error;
 }
 
@@ -2036,6 +2235,8 @@ void TRequest::Handle() {
         error = ListContainers(Req.list(), rsp);
     else if (Req.has_getproperty())
         error = GetContainerProperty(Req.getproperty(), rsp);
+    else if (Req.has_readstream())
+        error = ReadStream(Req.readstream(), rsp);
     else if (Req.has_setproperty())
         error = SetContainerProperty(Req.setproperty());
     else if (Req.has_getintproperty())
@@ -2201,11 +2402,7 @@ void TRequest::Handle() {
 
     L_DBG("Raw response: {}", rsp.ShortDebugString());
 
-    auto lock = Client->Lock();
-    Client->Processing = false;
-    error = Client->QueueResponse(rsp);
-    if (!error && !Client->Sending)
-        error = Client->SendResponse(true);
+    error = Client->MakeResponse(rsp);
     if (error)
         L_WRN("Cannot send response for {} : {}", Client->Id, error);
 }
@@ -2213,6 +2410,7 @@ void TRequest::Handle() {
 class TRequestQueue {
     std::vector<std::unique_ptr<std::thread>> Threads;
     std::queue<std::unique_ptr<TRequest>> Queue;
+    std::queue<std::function<void()>> Tasks;
     std::condition_variable Wakeup;
     std::mutex Mutex;
     bool ShouldStop = false;
@@ -2244,14 +2442,31 @@ public:
         Wakeup.notify_one();
     }
 
+    /* Parts of requests in progress, served before new requests */
+    void Spawn(const std::function<void()> &task) {
+        Mutex.lock();
+        Tasks.push(task);
+        Mutex.unlock();
+        Wakeup.notify_one();
+    }
+
     void Run(int index) {
         SetProcessName(fmt::format("{}{}", Name, index));
         auto lock = std::unique_lock<std::mutex>(Mutex);
         while (true) {
-            while (Queue.empty() && !ShouldStop)
+            while (Queue.empty() && Tasks.empty() && !ShouldStop)
                 Wakeup.wait(lock);
             if (ShouldStop)
                 break;
+            if (!Tasks.empty()) {
+                auto task = std::move(Tasks.front());
+                Tasks.pop();
+                lock.unlock();
+                task();
+                task = nullptr;
+                lock.lock();
+                continue;
+            }
             auto request = std::unique_ptr<TRequest>(std::move(Queue.front()));
             Queue.pop();
             lock.unlock();
@@ -2267,6 +2482,74 @@ static TRequestQueue RwQueue("portod-RW");
 static TRequestQueue RoQueue("portod-RO");
 static TRequestQueue IoQueue("portod-IO");
 
+/*
+ * Split work into chunks of given size and run them at most at given
+ * parallelism. Caller processes chunks too, helpers from RO pool pick up
+ * the rest, thus caller never waits for chunks which are not started yet.
+ */
+void RunParallel(size_t count, size_t chunk, size_t parallelism,
+                 const std::function<void(size_t)> &func) {
+    chunk = std::max(chunk, (size_t)1);
+    size_t chunks = (count + chunk - 1) / chunk;
+    size_t helpers = std::min(chunks, parallelism);
+
+    if (helpers < 2) {
+        for (size_t index = 0; index < count; index++)
+            func(index);
+        return;
+    }
+
+    struct TJob {
+        std::atomic<size_t> Next;
+        size_t Done = 0;
+        std::mutex Mutex;
+        std::condition_variable Cv;
+    };
+
+    auto job = std::make_shared<TJob>();
+    job->Next = 0;
+
+    /*
+     * Helpers keep own copy of func: ones which start after the caller has
+     * returned find no chunks left and never call it, but must not touch
+     * the caller's stack.
+     */
+    auto client = CL;
+    auto worker = [=]() {
+        size_t done = 0;
+        for (size_t c = job->Next++; c < chunks; c = job->Next++) {
+            for (size_t index = c * chunk; index < std::min(count, (c + 1) * chunk); index++)
+                func(index);
+            done++;
+        }
+        if (done) {
+            std::unique_lock<std::mutex> lock(job->Mutex);
+            job->Done += done;
+            if (job->Done == chunks)
+                job->Cv.notify_all();
+        }
+    };
+
+    for (size_t i = 1; i < helpers; i++) {
+        RoQueue.Spawn([=]() {
+            CL = client;
+            worker();
+            CL = nullptr;
+        });
+    }
+
+    worker();
+
+    std::unique_lock<std::mutex> lock(job->Mutex);
+    job->Cv.wait(lock, [&]{ return job->Done == chunks; });
+}
+
+/* Split large read-only request into chunks of get_chunk_size items */
+static void RunParallel(size_t count, const std::function<void(size_t)> &func) {
+    RunParallel(count, config().daemon().get_chunk_size(),
+                config().daemon().get_parallelism(), func);
+}
+
 void StartRpcQueue() {
     RwQueue.Start(config().daemon().rw_threads());
     RoQueue.Start(config().daemon().ro_threads());
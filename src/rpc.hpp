@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 #include "common.hpp"
 
 class TClient;
@@ -26,6 +28,9 @@ public:
     void Handle();
 };
 
+void RunParallel(size_t count, size_t chunk, size_t parallelism,
+                 const std::function<void(size_t)> &func);
+
 void StartRpcQueue();
 void StopRpcQueue();
 void QueueRpcRequest(std::unique_ptr<TRequest> &req);
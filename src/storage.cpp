@@ -5,15 +5,21 @@
 #include "filesystem.hpp"
 #include "client.hpp"
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <set>
+#include <thread>
+#include <tuple>
 #include "util/unix.hpp"
 #include "util/log.hpp"
 #include "util/string.hpp"
-#include "util/md5.hpp"
+#include "util/checksum.hpp"
 #include "util/quota.hpp"
 
 extern "C" {
 #include <sys/stat.h>
+#include <sys/xattr.h>
 #include <fcntl.h>
 #include <unistd.h>
 }
@@ -23,6 +29,7 @@ static const char WEAK_PREFIX[] = "_weak_";
 static const char IMPORT_PREFIX[] = "_import_";
 static const char REMOVE_PREFIX[] = "_remove_";
 static const char PRIVATE_PREFIX[] = "_private_";
+static const char SQUASH_PREFIX[] = "_squash_";
 static const char META_PREFIX[] = "_meta_";
 static const char META_LAYER[] = "_layer_";
 
@@ -41,6 +48,7 @@ static std::condition_variable StorageCv;
 
 static TUintMap PlaceLoad;
 static TUintMap PlaceLoadLimit;
+static TStringMap PlaceChecksum;
 
 TError TStorage::Resolve(EStorageType type, const TPath &place, const std::string &name) {
     TError error;
@@ -96,6 +104,26 @@ void TStorage::Open(EStorageType type, const TPath &place, const std::string &na
 void TStorage::Init() {
     if (StringToUintMap(config().volumes().place_load_limit(), PlaceLoadLimit))
         PlaceLoadLimit = {{"default", 1}};
+
+    if (StringToStringMap(config().volumes().layer_checksum(), PlaceChecksum))
+        PlaceChecksum.clear();
+    for (auto it = PlaceChecksum.begin(); it != PlaceChecksum.end(); ) {
+        if (TChecksum::Supported(it->second)) {
+            ++it;
+        } else {
+            L_WRN("Unknown checksum {} for place {}", it->second, it->first);
+            it = PlaceChecksum.erase(it);
+        }
+    }
+    if (!PlaceChecksum.count("default"))
+        PlaceChecksum["default"] = "md5";
+}
+
+static std::string PlaceChecksumAlgo(const TPath &place) {
+    auto it = PlaceChecksum.find(place.ToString());
+    if (it == PlaceChecksum.end())
+        it = PlaceChecksum.find("default");
+    return it->second;
 }
 
 void TStorage::IncPlaceLoad(const TPath &place) {
@@ -117,6 +145,577 @@ void TStorage::DecPlaceLoad(const TPath &place) {
     StorageCv.notify_all();
 }
 
+/*
+ * Trash: directories are renamed into /place/porto_trash and removed
+ * by background threads with idle io priority. Space is reported as
+ * pending free until then. Failed entries are retried with backoff.
+ */
+
+struct TTrashEntry {
+    TPath Path;
+    dev_t Dev;
+    uint64_t Space;
+    bool Collect;
+    unsigned Retries;
+    uint64_t Deadline;
+};
+
+static std::mutex TrashMutex;
+static std::condition_variable TrashCv;
+static std::deque<TTrashEntry> TrashQueue;
+static std::map<dev_t, uint64_t> TrashPending;
+static std::set<std::string> TrashPlaces;
+static std::vector<std::thread> TrashThreads;
+static std::atomic<bool> TrashRun(false);
+static unsigned TrashSeq = 0;
+
+static constexpr uint64_t TRASH_RETRY_MS = 1000;
+static constexpr uint64_t TRASH_RETRY_MAX_MS = 600000;
+
+static void QueueTrash(const TPath &path, dev_t dev, uint64_t space, bool collect) {
+    TrashQueue.push_back({path, dev, space, collect, 0, 0});
+    TrashPending[dev] += space;
+    Statistics->TrashEntries++;
+    Statistics->TrashSpace += space;
+    TrashCv.notify_one();
+}
+
+void TStorage::ScanTrash(const TPath &place) {
+    TPath trash = place / PORTO_TRASH;
+    std::vector<std::string> list;
+
+    auto lock = std::unique_lock<std::mutex>(TrashMutex);
+
+    if (!TrashPlaces.insert(place.ToString()).second)
+        return;
+
+    if (!trash.IsDirectoryStrict() || trash.ReadDirectory(list))
+        return;
+
+    dev_t dev = trash.GetDev();
+    for (auto &name: list) {
+        L_ACT("Found trash {}", trash / name);
+        if (config().volumes().trash_threads() > 0)
+            QueueTrash(trash / name, dev, 0, true);
+    }
+
+    if (config().volumes().trash_threads() > 0)
+        return;
+
+    /* Without reclaimers leftovers are removed synchronously */
+    lock.unlock();
+
+    for (auto &name: list) {
+        TError error = RemoveRecursive(trash / name);
+        if (error)
+            L_WRN("Cannot remove trash {}: {}", trash / name, error);
+    }
+}
+
+TError TStorage::MoveToTrash(const TPath &place, const TPath &path, uint64_t space, bool collect) {
+    TPath trash = place / PORTO_TRASH;
+    TError error;
+
+    if (config().volumes().trash_threads() <= 0)
+        return TError(EError::NotSupported, "Trash is disabled");
+
+    ScanTrash(place);
+
+    auto lock = std::unique_lock<std::mutex>(TrashMutex);
+
+    if (!trash.IsDirectoryStrict()) {
+        error = trash.Mkdir(0700);
+        if (error)
+            return error;
+    }
+
+    TPath dst = trash / fmt::format("{}_{}", GetCurrentTimeMs(), TrashSeq++);
+    error = path.Rename(dst);
+    if (error)
+        return error;
+
+    L_ACT("Move {} to trash {} pending {}", path, dst, StringFormatSize(space));
+    QueueTrash(dst, trash.GetDev(), space, collect);
+
+    return OK;
+}
+
+/* Move directory into trash or remove it synchronously if not possible */
+TError TStorage::RemoveTree(const TPath &place, const TPath &path, uint64_t space) {
+    TError error;
+
+    error = MoveToTrash(place, path, space);
+    if (!error)
+        return OK;
+
+    if (error != EError::NotSupported)
+        L_VERBOSE("Cannot move {} to trash: {}", path, error);
+
+    error = RemoveRecursive(path);
+    if (error) {
+        L_VERBOSE("Cannot remove {}: {}", path, error);
+        error = path.RemoveAll();
+    }
+
+    return error;
+}
+
+uint64_t TStorage::TrashSpace(dev_t dev) {
+    auto lock = std::unique_lock<std::mutex>(TrashMutex);
+    auto it = TrashPending.find(dev);
+    return it != TrashPending.end() ? it->second : 0;
+}
+
+/* Remove entry in-process, checks for shutdown at each file */
+static TError ReclaimTrash(const TPath &path) {
+    TPathWalk walk;
+    TError error;
+
+    if (!path.IsDirectoryStrict())
+        return path.Unlink();
+
+    error = walk.OpenNoStat(path);
+    while (!error) {
+        if (!TrashRun)
+            return TError(EError::Busy, "Porto is stopping");
+        error = walk.Next();
+        if (error || !walk.Path)
+            break;
+        if (walk.Directory) {
+            if (walk.Postorder)
+                error = walk.Path.Rmdir();
+        } else
+            error = walk.Path.Unlink();
+    }
+
+    return error;
+}
+
+void TStorage::TrashWorker() {
+    SetProcessName("portod-trash");
+
+    /* Idle class, inherited by helpers */
+    if (SetIoPrio(0, 3 << 13))
+        L_WRN("Cannot set trash ioprio: {}", TError::System("ioprio_set"));
+
+    auto lock = std::unique_lock<std::mutex>(TrashMutex);
+    while (TrashRun) {
+        uint64_t now = GetCurrentTimeMs();
+        uint64_t deadline = UINT64_MAX;
+        auto it = TrashQueue.begin();
+
+        for (; it != TrashQueue.end() && it->Deadline > now; it++)
+            deadline = std::min(deadline, it->Deadline);
+
+        if (it == TrashQueue.end()) {
+            if (TrashQueue.empty())
+                TrashCv.wait(lock);
+            else
+                TrashCv.wait_for(lock, std::chrono::milliseconds(deadline - now));
+            continue;
+        }
+
+        TTrashEntry entry = *it;
+        TrashQueue.erase(it);
+        lock.unlock();
+
+        uint64_t start = GetCurrentTimeMs();
+        TError error = ReclaimTrash(entry.Path);
+
+        if (error == EError::Busy)
+            break;
+
+        if (error) {
+            uint64_t delay = std::min(TRASH_RETRY_MS << std::min(entry.Retries, 10u),
+                                      TRASH_RETRY_MAX_MS);
+            L_WRN("Cannot reclaim trash {}: {}, retry in {} ms", entry.Path, error, delay);
+            entry.Retries++;
+            entry.Deadline = GetCurrentTimeMs() + delay;
+            lock.lock();
+            TrashQueue.push_back(entry);
+            continue;
+        }
+
+        L_ACT("Reclaimed trash {} {} in {} ms", entry.Path,
+              StringFormatSize(entry.Space), GetCurrentTimeMs() - start);
+
+        /* Trash lives in /place/porto_trash, pool is scanned after last layer */
+        TPath place = entry.Path.DirName().DirName();
+        bool collect = entry.Collect;
+
+        lock.lock();
+
+        for (auto &next: TrashQueue)
+            if (next.Collect && !next.Retries && next.Path.DirName().DirName() == place)
+                collect = false;
+
+        if (collect) {
+            lock.unlock();
+            CollectObjects(place);
+            lock.lock();
+        }
+
+        TrashPending[entry.Dev] -= entry.Space;
+        if (!TrashPending[entry.Dev])
+            TrashPending.erase(entry.Dev);
+        Statistics->TrashEntries--;
+        Statistics->TrashSpace -= entry.Space;
+        Statistics->TrashRemoved++;
+    }
+}
+
+void TStorage::StartTrash() {
+    int threads = config().volumes().trash_threads();
+    std::set<TPath> places = { PORTO_PLACE };
+
+    auto lock = std::unique_lock<std::mutex>(TrashMutex);
+    TrashRun = true;
+    for (int i = 0; i < threads; i++)
+        TrashThreads.emplace_back(&TStorage::TrashWorker);
+    lock.unlock();
+
+    /* Leftovers at places in use or in config, other places are scanned at first use */
+    auto volumes_lock = LockVolumes();
+    for (auto &it: Volumes)
+        places.insert(it.second->Place);
+    volumes_lock.unlock();
+
+    for (auto &it: PlaceLoadLimit)
+        places.insert(it.first);
+    for (auto &it: PlaceChecksum)
+        places.insert(it.first);
+
+    for (auto &place: places) {
+        if (place.IsAbsolute() && place.IsDirectoryStrict())
+            ScanTrash(place);
+    }
+}
+
+void TStorage::StopTrash() {
+    auto lock = std::unique_lock<std::mutex>(TrashMutex);
+    TrashRun = false;
+    TrashCv.notify_all();
+    lock.unlock();
+
+    for (auto &thread: TrashThreads)
+        thread.join();
+    TrashThreads.clear();
+}
+
+/*
+ * Layer cache: when space used by layers at place exceeds high watermark
+ * of volumes.layer_cache_limit unused layers are removed in order of last
+ * usage until it drops below low watermark.
+ */
+
+static std::mutex LayerCacheMutex;
+static std::condition_variable LayerCacheCv;
+static std::map<std::string, TLayerCacheStat> LayerCaches;
+static TUintMap LayerCacheLimit;
+static std::thread LayerCacheThread;
+static bool LayerCacheRun = false;
+static bool LayerCacheKick = false;
+
+/* Place -> collection requested while pool is scanned */
+static std::mutex ObjectsMutex;
+static std::map<std::string, bool> ObjectsScan;
+
+/* Place -> bytes in objects linked into several layers, at last scan, also kept in xattr of pool */
+static TUintMap ObjectsShared;
+
+/* Called under LayerCacheMutex */
+static uint64_t GetLayerCacheLimit(const std::string &place) {
+    auto it = LayerCacheLimit.find(place);
+    if (it == LayerCacheLimit.end())
+        it = LayerCacheLimit.find("default");
+    return it != LayerCacheLimit.end() ? it->second : 0;
+}
+
+void TStorage::LayerCacheAccess(const TPath &place, bool hit) {
+    auto lock = std::unique_lock<std::mutex>(LayerCacheMutex);
+    auto &cache = LayerCaches[place.ToString()];
+
+    if (hit) {
+        cache.Hits++;
+        Statistics->LayerCacheHits++;
+    } else {
+        cache.Misses++;
+        Statistics->LayerCacheMisses++;
+    }
+}
+
+/* Add new layer to usage at last scan, rescan place soon if it is over budget */
+void TStorage::CheckLayerCache(const TPath &place, uint64_t size) {
+    auto lock = std::unique_lock<std::mutex>(LayerCacheMutex);
+    auto &cache = LayerCaches[place.ToString()];
+    uint64_t limit = GetLayerCacheLimit(place.ToString());
+
+    cache.Used += size;
+    if (limit && cache.Used > limit / 100 * config().volumes().layer_cache_high_watermark()) {
+        LayerCacheKick = true;
+        LayerCacheCv.notify_all();
+    }
+}
+
+TLayerCacheStat TStorage::LayerCacheStat(const TPath &place) {
+    auto lock = std::unique_lock<std::mutex>(LayerCacheMutex);
+    TLayerCacheStat stat;
+
+    auto it = LayerCaches.find(place.ToString());
+    if (it != LayerCaches.end())
+        stat = it->second;
+    stat.Limit = GetLayerCacheLimit(place.ToString());
+
+    return stat;
+}
+
+/*
+ * Hardlinks are counted once. Shared are inodes which have links outside
+ * of layer besides one in object pool, i.e. linked into other layers.
+ */
+static TError CountLayerSpace(const TPath &layer, uint64_t &size, uint64_t &shared) {
+    /* inode -> links seen, links total, bytes */
+    std::unordered_map<ino_t, std::tuple<nlink_t, nlink_t, uint64_t>> links;
+    TPathWalk walk;
+    TError error;
+
+    size = 0;
+    shared = 0;
+
+    error = walk.OpenScan(layer);
+    while (!error) {
+        error = walk.Next();
+        if (error || !walk.Path)
+            break;
+        if (walk.Postorder)
+            continue;
+        if (S_ISDIR(walk.Stat->st_mode) || walk.Stat->st_nlink <= 1) {
+            size += walk.Stat->st_blocks * 512ull;
+        } else {
+            auto &link = links[walk.Stat->st_ino];
+            std::get<0>(link)++;
+            std::get<1>(link) = walk.Stat->st_nlink;
+            std::get<2>(link) = walk.Stat->st_blocks * 512ull;
+        }
+    }
+    if (error)
+        return error;
+
+    for (auto &it: links) {
+        size += std::get<2>(it.second);
+        if (std::get<1>(it.second) > std::get<0>(it.second) + 1)
+            shared += std::get<2>(it.second);
+    }
+
+    return OK;
+}
+
+/* Space used by layer, saved into private like after dedup */
+TError TStorage::CountSpace() {
+    struct stat st;
+    TError error;
+
+    Size = 0;
+    SharedSize = 0;
+
+    if (SquashLayer()) {
+        error = TempPath(SQUASH_PREFIX).StatStrict(st);
+        if (error)
+            return error;
+        Size = st.st_blocks * 512ull;
+    } else {
+        error = CountLayerSpace(Path, Size, SharedSize);
+        if (error)
+            return error;
+    }
+
+    return SaveSpace();
+}
+
+TError TStorage::SaveSpace() {
+    TFile priv;
+    TError error;
+
+    if (!priv.Open(TempPath(PRIVATE_PREFIX), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NOFOLLOW)) {
+        error = priv.SetXAttr("user.porto.space", std::to_string(Size));
+        if (!error)
+            error = priv.SetXAttr("user.porto.shared", std::to_string(SharedSize));
+        if (error)
+            L_WRN("Cannot save layer usage: {}", error);
+    }
+
+    return OK;
+}
+
+void TStorage::EvictLayers(const TPath &place, uint64_t limit) {
+    uint64_t high = limit / 100 * config().volumes().layer_cache_high_watermark();
+    uint64_t low = limit / 100 * config().volumes().layer_cache_low_watermark();
+    uint64_t min_age = config().volumes().layer_cache_period_ms() / 1000;
+    uint64_t used = 0, shared = 0, evicted = 0, count = 0;
+    TPath objects = place / PORTO_OBJECTS;
+    std::list<TStorage> layers;
+    std::vector<TStorage *> lru;
+    bool scanned = false;
+    TStorage storage;
+    TError error;
+
+    if (!TPath(place / PORTO_LAYERS).IsDirectoryStrict())
+        return;
+
+    storage.Open(EStorageType::Place, place);
+    error = storage.List(EStorageType::Layer, layers);
+    if (error) {
+        L_WRN("Cannot list layers at {}: {}", place, error);
+        return;
+    }
+
+    /* Objects shared between layers are counted once, pool is scanned by trash reclaimer */
+    if (objects.IsDirectoryStrict()) {
+        auto lock = std::unique_lock<std::mutex>(ObjectsMutex);
+        auto it = ObjectsShared.find(place.ToString());
+        if (it != ObjectsShared.end()) {
+            shared = it->second;
+            scanned = true;
+        }
+        lock.unlock();
+
+        std::string value;
+        if (!scanned && !objects.GetXAttr("user.porto.shared", value) &&
+                !StringToUint64(value, shared)) {
+            lock.lock();
+            ObjectsShared[place.ToString()] = shared;
+            scanned = true;
+        }
+    } else
+        scanned = true;
+
+    for (auto &layer: layers) {
+        /* Layers in meta storages are limited by its quota */
+        if (!layer.Meta.empty() || layer.Load())
+            continue;
+        if (!layer.Size && layer.CountSpace())
+            continue;
+        /* Never scanned pool is at least as large as shared part of any layer */
+        if (!scanned)
+            shared = std::max(shared, layer.SharedSize);
+        /* Space freed by removal, without objects of other layers */
+        layer.Size -= std::min(layer.Size, layer.SharedSize);
+        used += layer.Size;
+        lru.push_back(&layer);
+    }
+
+    used += shared;
+
+    if (used > high) {
+        std::sort(lru.begin(), lru.end(), [](const TStorage *a, const TStorage *b) {
+            return a->LastChange < b->LastChange;
+        });
+
+        L_ACT("Layers at {} use {} of {}, evict down to {}", place,
+              StringFormatSize(used), StringFormatSize(limit), StringFormatSize(low));
+
+        for (auto layer: lru) {
+            if (used <= low || !LayerCacheRun)
+                break;
+
+            /* Give new layers chance to be used */
+            if (layer->LastUsage() < min_age)
+                continue;
+
+            error = layer->Remove(true);
+            if (error) {
+                if (error != EError::Busy && error != EError::LayerNotFound)
+                    L_WRN("Cannot evict layer {} at {}: {}", layer->Name, place, error);
+                continue;
+            }
+
+            L_ACT("Evicted layer {} at {} unused for {} s, {}", layer->Name, place,
+                  layer->LastUsage(), StringFormatSize(layer->Size));
+
+            used -= std::min(used, layer->Size);
+            evicted += layer->Size;
+            count++;
+            Statistics->LayerCacheEvictions++;
+        }
+
+        if (used > high)
+            L_WRN("Layers at {} still use {} of {}", place,
+                  StringFormatSize(used), StringFormatSize(limit));
+    }
+
+    auto lock = std::unique_lock<std::mutex>(LayerCacheMutex);
+    auto &cache = LayerCaches[place.ToString()];
+    cache.Used = used;
+    cache.Evictions += count;
+    cache.EvictedBytes += evicted;
+}
+
+void TStorage::LayerCacheWorker() {
+    auto period = std::chrono::milliseconds(config().volumes().layer_cache_period_ms());
+    TClient client("<layer-cache>");
+
+    SetProcessName("portod-cache");
+
+    /* Eviction works as internal client */
+    client.StartRequest();
+
+    auto lock = std::unique_lock<std::mutex>(LayerCacheMutex);
+    while (LayerCacheRun) {
+        LayerCacheCv.wait_for(lock, period, [&]{ return !LayerCacheRun || LayerCacheKick; });
+        if (!LayerCacheRun)
+            break;
+        LayerCacheKick = false;
+
+        std::vector<std::pair<TPath, uint64_t>> places;
+        for (auto &it: LayerCaches) {
+            uint64_t limit = GetLayerCacheLimit(it.first);
+            if (limit)
+                places.emplace_back(it.first, limit);
+        }
+
+        lock.unlock();
+        for (auto &it: places)
+            EvictLayers(it.first, it.second);
+        lock.lock();
+    }
+    lock.unlock();
+
+    client.FinishRequest();
+}
+
+void TStorage::StartLayerCache() {
+    auto lock = std::unique_lock<std::mutex>(LayerCacheMutex);
+    bool enabled = false;
+
+    if (StringToUintMap(config().volumes().layer_cache_limit(), LayerCacheLimit))
+        LayerCacheLimit.clear();
+
+    /* Other places are checked after first usage */
+    LayerCaches[PORTO_PLACE];
+    for (auto &it: LayerCacheLimit) {
+        if (it.first != "default" && TPath(it.first).IsAbsolute())
+            LayerCaches[it.first];
+        enabled |= it.second != 0;
+    }
+
+    if (!enabled || !config().volumes().layer_cache_period_ms())
+        return;
+
+    LayerCacheRun = true;
+    LayerCacheKick = true;
+    LayerCacheThread = std::thread(&TStorage::LayerCacheWorker);
+}
+
+void TStorage::StopLayerCache() {
+    auto lock = std::unique_lock<std::mutex>(LayerCacheMutex);
+    LayerCacheRun = false;
+    LayerCacheCv.notify_all();
+    lock.unlock();
+
+    if (LayerCacheThread.joinable())
+        LayerCacheThread.join();
+}
+
 /* FIXME racy. rewrite with openat... etc */
 TError TStorage::Cleanup(const TPath &place, EStorageType type, unsigned perms) {
     TPath base;
@@ -198,8 +797,10 @@ TError TStorage::Cleanup(const TPath &place, EStorageType type, unsigned perms)
             path = dirent.RealPath();
 
         } else if (path.IsRegularStrict()) {
-            if (type != EStorageType::Volume && StringStartsWith(name, PRIVATE_PREFIX)) {
-                std::string tail = name.substr(std::string(PRIVATE_PREFIX).size());
+            std::string prefix = StringStartsWith(name, SQUASH_PREFIX) ?
+                                 SQUASH_PREFIX : PRIVATE_PREFIX;
+            if (type != EStorageType::Volume && StringStartsWith(name, prefix)) {
+                std::string tail = name.substr(prefix.size());
                 if ((base / tail).IsDirectoryStrict() ||
                         (base / (std::string(IMPORT_PREFIX) + tail)).IsDirectoryStrict())
                     continue;
@@ -212,13 +813,17 @@ TError TStorage::Cleanup(const TPath &place, EStorageType type, unsigned perms)
 
         lock.unlock();
         L_ACT("Remove junk: {}", path);
-        error = RemoveRecursive(path);
-        if (error) {
-            L_VERBOSE("Cannot remove junk {}: {}", path, error);
-            error = path.RemoveAll();
-            if (error)
-                L_WRN("cannot remove junk {}: {}", path, error);
+        if (type != EStorageType::Meta) {
+            error = RemoveTree(place, path);
+        } else {
+            error = RemoveRecursive(path);
+            if (error) {
+                L_VERBOSE("Cannot remove junk {}: {}", path, error);
+                error = path.RemoveAll();
+            }
         }
+        if (error)
+            L_WRN("cannot remove junk {}: {}", path, error);
     }
 
     return OK;
@@ -248,6 +853,8 @@ TError TStorage::CheckPlace(const TPath &place) {
     if (error)
         return error;
 
+    ScanTrash(place);
+
     return OK;
 }
 
@@ -268,6 +875,7 @@ TError TStorage::CheckName(const std::string &name, bool meta) {
             StringStartsWith(name, IMPORT_PREFIX) ||
             StringStartsWith(name, REMOVE_PREFIX) ||
             StringStartsWith(name, PRIVATE_PREFIX) ||
+            StringStartsWith(name, SQUASH_PREFIX) ||
             StringStartsWith(name, META_PREFIX) ||
             StringStartsWith(name, META_LAYER))
         return TError(EError::InvalidValue, "invalid layer name '" + name + "'");
@@ -453,6 +1061,13 @@ TError TStorage::Load() {
 
     Owner = TCred(st.st_uid, st.st_gid);
     LastChange = st.st_mtime;
+
+    std::string value;
+    if (!priv.GetXAttr("user.porto.space", value))
+        (void)StringToUint64(value, Size);
+    if (!priv.GetXAttr("user.porto.shared", value))
+        (void)StringToUint64(value, SharedSize);
+
     error = priv.ReadAll(Private, 4096);
     if (error)
         Private = "";
@@ -525,7 +1140,12 @@ static TError Compression(const TPath &archive, const TFile &arc,
     if (arc.Fd >= 0) {
         char magic[8];
 
-        if (pread(arc.Fd, magic, sizeof(magic), 0) == sizeof(magic)) {
+        ssize_t len = pread(arc.Fd, magic, sizeof(magic), 0);
+
+        if (len < 0 && errno == ESPIPE)
+            return TError(EError::InvalidValue, "Cannot detect compression of archive stream");
+
+        if (len == sizeof(magic)) {
             if (!strncmp(magic, "\xFD" "7zXZ\x00", 6))
                 goto xz;
             if (!strncmp(magic, "\x1F\x8B\x08", 3))
@@ -613,44 +1233,456 @@ static bool TarSupportsXattrs() {
     return result;
 }
 
+static TError ExtractTarHelper(const TFile &arc, const std::string &option,
+                               const TFile &dir) {
+    TTuple args = { "tar",
+                    "--numeric-owner",
+                    "--preserve-permissions",
+                    option,
+                    "--extract" };
+
+    if (TarSupportsXattrs())
+        args.insert(args.begin() + 3, {
+                    "--xattrs",
+                    "--xattrs-include=security.capability",
+                    "--xattrs-include=trusted.overlay.*",
+                    "--xattrs-include=user.*"});
+
+    return RunCommand(args, dir, arc, TFile());
+}
+
+/* Decompress by helper into pipe, unpack tar by forked extractor */
+static TError ExtractArchive(const TFile &arc, const std::string &option,
+                             const TPath &dst, bool layer, bool merge,
+                             TCopyStat &stat, const std::string &algo, TChecksumMap *sums,
+                             const std::function<TError(const TFile &rest)> &fallback) {
+    TTuple cmd;
+    TError error;
+
+    if (option == "--no-auto-compress")
+        return ExtractTar(arc, dst, layer, merge, &stat, algo, sums, fallback);
+
+    if (option == "--gzip") {
+        cmd = { "gzip", "--decompress", "--stdout" };
+        if (config().volumes().parallel_compression() && TPath("/usr/bin/pigz").Exists())
+            cmd[0] = "pigz";
+    } else if (option == "--xz") {
+        cmd = { "xz", "--decompress", "--stdout" };
+        if (config().volumes().parallel_compression() && TPath("/usr/bin/pixz").Exists())
+            cmd = { "pixz", "-d" };
+    } else if (StringStartsWith(option, "--use-compress-program=zstd"))
+        cmd = { "zstd", "--decompress", "--stdout" };
+    else
+        return TError(EError::NotSupported, "Unsupported compression {}", option);
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC))
+        return TError::System("pipe2");
+
+    TFile input(fds[0]), output(fds[1]);
+    TError helper_error;
+
+    std::thread helper([&] {
+        helper_error = RunCommand(cmd, TFile(), arc, output);
+        output.Close();
+    });
+
+    error = ExtractTar(input, dst, layer, merge, &stat, algo, sums, fallback);
+
+    /* Unblock helper if extraction failed in the middle */
+    input.Close();
+    helper.join();
+
+    if (!error)
+        error = helper_error;
+
+    return error;
+}
+
 TError TStorage::SaveChecksums() {
+    return ChecksumRecursive(Path, PlaceChecksumAlgo(Place), Size);
+}
+
+/*
+ * Squashfs layers: image is kept in /place/porto_layers/_squash_<name>
+ * and mounted at layer directory while any volume uses it.
+ */
+
+struct TSquashMount {
+    unsigned Refs = 0;
+    int Loop = -1;
+};
+
+static std::mutex SquashMutex;
+static std::map<std::string, TSquashMount> SquashMounts;
+
+bool TStorage::SquashLayer() {
+    return Type == EStorageType::Layer && TempPath(SQUASH_PREFIX).IsRegularStrict();
+}
+
+/* Layer directory is mountpoint of squashfs from loop device */
+static bool SquashMounted(const TPath &path, int &loop) {
+    TMount mount;
+
+    if (path.GetDev() == path.DirName().GetDev() ||
+            path.FindMount(mount, true) || mount.Type != "squashfs")
+        return false;
+
+    loop = -1;
+    if (StringStartsWith(mount.Source.ToString(), "/dev/loop"))
+        (void)StringToInt(mount.Source.ToString().substr(9), loop);
+
+    return true;
+}
+
+TError TStorage::MountLayer() {
+    TPath image = TempPath(SQUASH_PREFIX);
+    TError error;
+    TFile file;
+    int loop;
+
+    if (!SquashLayer())
+        return OK;
+
+    auto lock = std::unique_lock<std::mutex>(SquashMutex);
+    auto &mnt = SquashMounts[Path.ToString()];
+
+    if (mnt.Refs) {
+        mnt.Refs++;
+        return OK;
+    }
+
+    /* Left mounted by previous instance */
+    if (SquashMounted(Path, loop)) {
+        mnt.Refs = 1;
+        mnt.Loop = loop;
+        return OK;
+    }
+
+    error = file.OpenRead(image);
+    if (!error)
+        error = SetupLoopDev(file, image, loop);
+    if (!error) {
+        error = Path.Mount("/dev/loop" + std::to_string(loop), "squashfs",
+                           MS_RDONLY | MS_NODEV | MS_NOSUID, {});
+        if (error)
+            (void)PutLoopDev(loop);
+    }
+
+    if (error) {
+        SquashMounts.erase(Path.ToString());
+        return TError(error, "Cannot mount layer {}", Name);
+    }
+
+    L_ACT("Mount squashfs layer {} loop {}", Name, loop);
+    mnt.Refs = 1;
+    mnt.Loop = loop;
+
+    return OK;
+}
+
+static void UmountSquash(const TPath &path, int loop) {
+    L_ACT("Umount squashfs layer {} loop {}", path, loop);
+
+    TError error = path.UmountAll();
+    if (error)
+        L_WRN("Cannot umount layer {}: {}", path, error);
+    else if (loop >= 0) {
+        error = PutLoopDev(loop);
+        if (error)
+            L_WRN("Cannot put loop {}: {}", loop, error);
+    }
+}
+
+void TStorage::UmountLayer() {
+    if (!SquashLayer())
+        return;
+
+    auto lock = std::unique_lock<std::mutex>(SquashMutex);
+    auto it = SquashMounts.find(Path.ToString());
+    if (it == SquashMounts.end() || --it->second.Refs)
+        return;
+
+    UmountSquash(Path, it->second.Loop);
+    SquashMounts.erase(it);
+}
+
+/* Umount layer if no volumes use it, for example after restart */
+void TStorage::UmountUnused() {
+    int loop;
+
+    auto lock = std::unique_lock<std::mutex>(SquashMutex);
+    if (!SquashMounts.count(Path.ToString()) && SquashMounted(Path, loop))
+        UmountSquash(Path, loop);
+}
+
+/* Only checksum saved by porto could be shared with object */
+static TError DedupXattrs(const TPath &path, bool &shareable, std::string &algo) {
+    std::vector<char> list(4096);
+
+    ssize_t len = llistxattr(path.c_str(), list.data(), list.size());
+    if (len < 0) {
+        shareable = false;
+        return errno == ERANGE ? OK : TError::System("llistxattr {}", path);
+    }
+
+    shareable = true;
+    algo = "";
+    for (ssize_t off = 0; off < len; off += strlen(list.data() + off) + 1) {
+        const char *name = list.data() + off;
+        if (algo.empty() && !strcmp(name, "user.porto.md5sum"))
+            algo = "md5";
+        else if (algo.empty() && !strcmp(name, "user.porto.xxh64sum"))
+            algo = "xxh64";
+        else
+            shareable = false;
+    }
+
+    return OK;
+}
+
+static TError CompareContent(const TFile &a, const TFile &b, bool &equal) {
+    std::vector<char> bufa(1 << 16), bufb(1 << 16);
+    off_t off = 0;
+
+    equal = false;
+    while (1) {
+        ssize_t lena = pread(a.Fd, bufa.data(), bufa.size(), off);
+        if (lena < 0)
+            return TError::System("pread");
+        ssize_t lenb = pread(b.Fd, bufb.data(), lena ? lena : 1, off);
+        if (lenb < 0)
+            return TError::System("pread");
+        if (lena != lenb || memcmp(bufa.data(), bufb.data(), lena))
+            return OK;
+        if (!lena)
+            break;
+        off += lena;
+    }
+
+    equal = true;
+    return OK;
+}
+
+/*
+ * Replace files in layer with hardlinks to shared objects
+ * /place/porto_objects/xx/<sum>-<size>-<uid>-<gid>-<mode>-<mtime>[-<algo>]
+ * Sum is md5 or checksum saved in xattr, suffix tells which one.
+ * Content is compared byte by byte before linking. Files which already
+ * have hardlinks or foreign xattrs are kept as is, each object is linked
+ * at most once per layer to not create new hardlinks inside it.
+ */
+TError TStorage::DedupLayer(const TPath &layer, const TChecksumMap *sums) {
+    std::string place_algo = PlaceChecksumAlgo(Place);
+    TPath objects = Place / PORTO_OBJECTS;
+    uint64_t files = 0, linked = 0, start = GetCurrentTimeMs();
+    std::set<std::string> seen;
     TPathWalk walk;
     TError error;
 
-    error = walk.OpenScan(Path);
+    if (!objects.IsDirectoryStrict()) {
+        error = objects.Mkdir(0700);
+        if (error && error.Errno != EEXIST)
+            return error;
+    }
+
+    error = walk.OpenScan(layer);
     if (error)
         return error;
 
-    Size = 0;
-
     while (1) {
         error = walk.Next();
         if (error)
             return error;
         if (!walk.Path)
             break;
-        if (!walk.Postorder)
-            Size += walk.Stat->st_blocks * 512ull;
-        if (!S_ISREG(walk.Stat->st_mode))
+        if (walk.Postorder)
+            continue;
+
+        struct stat st = *walk.Stat;
+        uint64_t space = st.st_blocks * 512ull;
+
+        /* Hardlinks are left as is */
+        if (!S_ISREG(st.st_mode) || !st.st_size || st.st_nlink > 1)
+            continue;
+
+        std::string algo;
+        bool shareable;
+        error = DedupXattrs(walk.Path, shareable, algo);
+        if (error)
+            return error;
+        if (!shareable)
             continue;
+
         TFile file;
         error = file.OpenRead(walk.Path);
         if (error)
             return error;
-        std::string sum;
-        error = Md5Sum(file, sum);
+
+        /* Extractor saves sums by place algorithm, files are not read again */
+        std::string sum, saved;
+        if (sums && algo == place_algo) {
+            auto it = sums->find(layer.InnerPath(walk.Path, false).ToString());
+            if (it != sums->end())
+                sum = it->second;
+        }
+        if (sum.empty()) {
+            error = FileChecksum(file, algo.empty() ? "md5" : algo, sum);
+            if (error)
+                return error;
+        }
+
+        if (!algo.empty() && (file.GetXAttr(ChecksumXattr(algo), saved) || saved != sum))
+            continue;
+
+        std::string key = fmt::format("{}-{}-{}-{}-{:o}-{}.{:09}{}", sum,
+                                      st.st_size, st.st_uid, st.st_gid,
+                                      st.st_mode & 07777, st.st_mtim.tv_sec,
+                                      st.st_mtim.tv_nsec,
+                                      algo.empty() ? "" : algo == "md5" ? "-x" : "-" + algo);
+        if (!seen.insert(key).second)
+            continue;
+
+        TPath shard = objects / sum.substr(0, 2);
+        TPath object = shard / key;
+        TFile obj;
+
+        if (obj.Open(object, O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NOCTTY)) {
+            /* New object, this file becomes its first link */
+            error = shard.Mkdir(0700);
+            if (error && error.Errno != EEXIST)
+                return error;
+            if (!object.Hardlink(walk.Path))
+                files++;
+            continue;
+        }
+
+        bool equal;
+        error = CompareContent(file, obj, equal);
         if (error)
             return error;
-        error = file.SetXAttr("user.porto.md5sum", sum);
-        if (error)
+        if (!equal) {
+            L_WRN("Object {} content differs from {}", object, walk.Path);
+            continue;
+        }
+
+        TPath temp = walk.Path.DirName() / ("." + walk.Path.BaseName() + ".porto_dedup");
+        error = temp.Hardlink(object);
+        if (error) {
+            /* Too many links or object just collected */
+            L_VERBOSE("Cannot link object {}: {}", object, error);
+            continue;
+        }
+
+        error = temp.Rename(walk.Path);
+        if (error) {
+            (void)temp.Unlink();
             return error;
+        }
+
+        linked += space;
+        files++;
     }
 
-    return OK;
+    Statistics->LayerDedupFiles += files;
+    Statistics->LayerDedupBytes += linked;
+
+    /* Shared are only files linked to objects of other layers */
+    error = CountLayerSpace(layer, Size, SharedSize);
+    if (error)
+        return error;
+
+    L("Dedup layer {}: {} of {} shared, {} saved in {} files, {} ms", Name,
+      StringFormatSize(SharedSize), StringFormatSize(Size),
+      StringFormatSize(linked), files, GetCurrentTimeMs() - start);
+
+    return SaveSpace();
 }
 
-TError TStorage::ImportArchive(const TPath &archive, const std::string &compress, bool merge) {
+/*
+ * Remove objects not linked into any layer and refresh shared space of
+ * remaining layers. Requests which come while place is scanned are
+ * merged into one more pass of running scan.
+ */
+void TStorage::CollectObjects(const TPath &place) {
+    TPath objects = place / PORTO_OBJECTS;
+
+    if (!objects.IsDirectoryStrict())
+        return;
+
+    auto lock = std::unique_lock<std::mutex>(ObjectsMutex);
+    auto it = ObjectsScan.find(place.ToString());
+    if (it != ObjectsScan.end()) {
+        it->second = true;
+        return;
+    }
+    it = ObjectsScan.emplace(place.ToString(), false).first;
+
+    do {
+        it->second = false;
+        lock.unlock();
+
+        uint64_t count = 0, shared = 0;
+        TPathWalk walk;
+
+        if (!walk.OpenScan(objects)) {
+            while (!walk.Next() && walk.Path) {
+                if (walk.Postorder || !S_ISREG(walk.Stat->st_mode))
+                    continue;
+                if (walk.Stat->st_nlink > 2)
+                    shared += walk.Stat->st_blocks * 512ull;
+                if (walk.Stat->st_nlink > 1)
+                    continue;
+                if (!walk.Path.Unlink())
+                    count++;
+            }
+        }
+
+        if (count) {
+            L_ACT("Collected {} objects in {}", count, objects);
+            Statistics->LayerObjectsRemoved += count;
+        }
+
+        RefreshShared(place);
+
+        TError error = objects.SetXAttr("user.porto.shared", std::to_string(shared));
+        if (error)
+            L_WRN("Cannot save shared space of {}: {}", objects, error);
+
+        lock.lock();
+        ObjectsShared[place.ToString()] = shared;
+    } while (it->second);
+
+    ObjectsScan.erase(it);
+}
+
+/* Objects of removed layers could become owned by single layer */
+void TStorage::RefreshShared(const TPath &place) {
+    std::list<TStorage> layers;
+    TStorage storage;
+
+    storage.Open(EStorageType::Place, place);
+    if (storage.List(EStorageType::Layer, layers))
+        return;
+
+    for (auto &layer: layers) {
+        if (layer.Load() || !layer.SharedSize || layer.SquashLayer())
+            continue;
+
+        uint64_t shared = layer.SharedSize;
+        if (CountLayerSpace(layer.Path, layer.Size, layer.SharedSize))
+            continue;
+        if (layer.SharedSize != shared)
+            (void)layer.SaveSpace();
+    }
+}
+
+TError TStorage::ImportArchive(const TPath &archive, const std::string &compress, bool merge,
+                               const TFile &stream) {
     TPath temp = TempPath(IMPORT_PREFIX);
+    bool squash = false;
+    TChecksumMap sums;
+    TStreamRelay relay;
     TError error;
     TFile arc;
 
@@ -662,22 +1694,29 @@ TError TStorage::ImportArchive(const TPath &archive, const std::string &compress
     if (error)
         return error;
 
-    if (!archive.IsAbsolute())
-        return TError(EError::InvalidValue, "archive path must be absolute");
+    if (stream) {
+        /* Client passed readable fd, no access checks are required */
+        error = relay.Start(stream, true, config().volumes().stream_timeout_ms(), arc);
+        if (error)
+            return error;
+    } else {
+        if (!archive.IsAbsolute())
+            return TError(EError::InvalidValue, "archive path must be absolute");
 
-    if (!archive.Exists())
-        return TError(EError::InvalidValue, "archive not found");
+        if (!archive.Exists())
+            return TError(EError::InvalidValue, "archive not found");
 
-    if (!archive.IsRegularFollow())
-        return TError(EError::InvalidValue, "archive not a file");
+        if (!archive.IsRegularFollow())
+            return TError(EError::InvalidValue, "archive not a file");
 
-    error = arc.OpenRead(archive);
-    if (error)
-        return error;
+        error = arc.OpenRead(archive);
+        if (error)
+            return error;
 
-    error = CL->ReadAccess(arc);
-    if (error)
-        return TError(error, "Cannot import {} from {}", Name, archive);
+        error = CL->ReadAccess(arc);
+        if (error)
+            return TError(error, "Cannot import {} from {}", Name, archive);
+    }
 
     std::string compress_format, compress_option;
     error = Compression(archive, arc, compress, compress_format, compress_option);
@@ -708,6 +1747,8 @@ TError TStorage::ImportArchive(const TPath &archive, const std::string &compress
     if (Path.Exists()) {
         if (!merge)
             return TError(EError::LayerAlreadyExists, "Layer already exists");
+        if (SquashLayer())
+            return TError(EError::NotSupported, "Cannot merge into squashfs layer {}", Name);
         error = CheckUsage();
         if (error)
             return error;
@@ -731,21 +1772,50 @@ TError TStorage::ImportArchive(const TPath &archive, const std::string &compress
     IncPlaceLoad(Place);
     Statistics->LayerImport++;
 
-    if (compress_format == "tar") {
-        TTuple args = { "tar",
-                        "--numeric-owner",
-                        "--preserve-permissions",
-                        compress_option,
-                        "--extract" };
+    squash = Type == EStorageType::Layer && !merge &&
+             compress_format == "squashfs" && config().volumes().squash_layers();
 
-        if (TarSupportsXattrs())
-            args.insert(args.begin() + 3, {
-                        "--xattrs",
-                        "--xattrs-include=security.capability",
-                        "--xattrs-include=trusted.overlay.*",
-                        "--xattrs-include=user.*"});
+    if (squash) {
+        TCopyStat stat;
+        TFile image;
 
-        error = RunCommand(args, import_dir, arc, TFile());
+        char magic[4];
+
+        /* Keep image as is, layer directory becomes mountpoint */
+        error = image.CreateTrunc(TempPath(SQUASH_PREFIX), 0600);
+        if (!error)
+            error = CopyFile(arc, image, &stat);
+        if (!error && (pread(image.Fd, magic, sizeof(magic), 0) != sizeof(magic) ||
+                       strncmp(magic, "hsqs", 4)))
+            error = TError(EError::InvalidValue, "Archive {} is not squashfs", archive);
+        if (!error)
+            L_ACT("Saved squashfs layer {} {}", Name, StringFormatSize(stat.Bytes));
+    } else if (compress_format == "tar" && config().volumes().extract_threads() > 0) {
+        bool dedup = Type == EStorageType::Layer && Meta.empty() &&
+                     config().volumes().layer_dedup();
+        bool sanitize = false;
+        TCopyStat stat;
+
+        /* Tar continues from entry which extractor does not support */
+        error = ExtractArchive(arc, compress_option, temp,
+                               Type == EStorageType::Layer, merge, stat,
+                               dedup ? PlaceChecksumAlgo(Place) : "",
+                               dedup ? &sums : nullptr, [&](const TFile &rest) {
+            sanitize = true;
+            return ExtractTarHelper(rest, "--no-auto-compress", import_dir);
+        });
+
+        if (!error && sanitize && Type == EStorageType::Layer)
+            error = SanitizeLayer(temp, merge);
+        if (!error)
+            L_ACT("Extracted {} files {} from {}", stat.Files,
+                  StringFormatSize(stat.Bytes), archive);
+    } else if (compress_format == "tar") {
+        error = ExtractTarHelper(arc, compress_option, import_dir);
+        if (!error && Type == EStorageType::Layer)
+            error = SanitizeLayer(temp, merge);
+    } else if (compress_format == "squashfs" && stream) {
+        error = TError(EError::NotSupported, "Cannot unpack squashfs from stream");
     } else if (compress_format == "squashfs") {
         TTuple args = { "unsquashfs",
                         "-force",
@@ -763,10 +1833,21 @@ TError TStorage::ImportArchive(const TPath &archive, const std::string &compress
     } else
         error = TError(EError::NotSupported, "Unsuported format " + compress_format);
 
+    if (stream) {
+        /*
+         * Stalled or broken client fails import even if extractor has
+         * already seen the end of archive and drains the rest.
+         */
+        arc.Close();
+        TError relay_error = relay.Finish();
+        if (relay_error)
+            error = relay_error;
+    }
+
     if (error)
         goto err;
 
-    if (Type == EStorageType::Layer) {
+    if (Type == EStorageType::Layer && compress_format == "squashfs" && !squash) {
         error = SanitizeLayer(temp, merge);
         if (error)
             goto err;
@@ -784,6 +1865,16 @@ TError TStorage::ImportArchive(const TPath &archive, const std::string &compress
             goto err;
     }
 
+    if (Type == EStorageType::Layer && Meta.empty() && !squash &&
+            config().volumes().layer_dedup()) {
+        error = DedupLayer(temp, &sums);
+        if (error)
+            L_WRN("Cannot dedup layer {}: {}", Name, error);
+    } else if (Type == EStorageType::Layer && merge) {
+        /* Saved usage is outdated, layer cache counts it again */
+        (void)removexattr(TempPath(PRIVATE_PREFIX).c_str(), "user.porto.space");
+    }
+
     lock.lock();
     error = temp.Rename(Path);
     if (!error)
@@ -794,6 +1885,13 @@ TError TStorage::ImportArchive(const TPath &archive, const std::string &compress
 
     DecPlaceLoad(Place);
 
+    if (Type == EStorageType::Layer) {
+        /* Usage is saved for next scans, squashfs image is just stat */
+        if (!Size && LayerCacheStat(Place).Limit)
+            (void)CountSpace();
+        CheckLayerCache(Place, Size - std::min(Size, SharedSize));
+    }
+
     StorageCv.notify_all();
 
     return OK;
@@ -803,6 +1901,9 @@ err:
     if (error2)
         L_WRN("Cannot cleanup layer: {}", error2);
 
+    if (squash)
+        (void)TempPath(SQUASH_PREFIX).Unlink();
+
     DecPlaceLoad(Place);
 
     lock.lock();
@@ -814,7 +1915,9 @@ err:
     return error;
 }
 
-TError TStorage::ExportArchive(const TPath &archive, const std::string &compress) {
+TError TStorage::ExportArchive(const TPath &archive, const std::string &compress,
+                               const TFile &stream) {
+    TStreamRelay relay;
     TFile dir, arc;
     TError error;
 
@@ -826,24 +1929,36 @@ TError TStorage::ExportArchive(const TPath &archive, const std::string &compress
     if (error)
         return TError(error, "Cannot export {}", Path);
 
-    if (!archive.IsAbsolute())
-        return TError(EError::InvalidValue, "archive path must be absolute");
+    if (!stream) {
+        if (!archive.IsAbsolute())
+            return TError(EError::InvalidValue, "archive path must be absolute");
 
-    if (archive.Exists())
-        return TError(EError::InvalidValue, "archive already exists");
+        if (archive.Exists())
+            return TError(EError::InvalidValue, "archive already exists");
+    }
 
     std::string compress_format, compress_option;
     error = Compression(archive, TFile(), compress, compress_format, compress_option);
     if (error)
         return error;
 
-    error = dir.OpenDir(archive.DirName());
-    if (error)
-        return error;
+    if (stream) {
+        if (compress_format == "squashfs" && !SquashLayer())
+            return TError(EError::NotSupported, "Cannot pack squashfs into stream");
 
-    error = CL->WriteAccess(dir);
-    if (error)
-        return error;
+        /* Helpers work in source directory, output goes to client fd */
+        error = dir.OpenDir(Path);
+        if (error)
+            return error;
+    } else {
+        error = dir.OpenDir(archive.DirName());
+        if (error)
+            return error;
+
+        error = CL->WriteAccess(dir);
+        if (error)
+            return error;
+    }
 
     if (Type == EStorageType::Storage) {
         auto lock = LockVolumes();
@@ -852,7 +1967,10 @@ TError TStorage::ExportArchive(const TPath &archive, const std::string &compress
             return error;
     }
 
-    error = arc.OpenAt(dir, archive.BaseName(), O_CREAT | O_WRONLY | O_EXCL | O_CLOEXEC, 0664);
+    if (stream)
+        error = relay.Start(stream, false, config().volumes().stream_timeout_ms(), arc);
+    else
+        error = arc.OpenAt(dir, archive.BaseName(), O_CREAT | O_WRONLY | O_EXCL | O_CLOEXEC, 0664);
     if (error)
         return error;
 
@@ -860,17 +1978,36 @@ TError TStorage::ExportArchive(const TPath &archive, const std::string &compress
     Statistics->LayerExport++;
 
     if (Type == EStorageType::Volume && compress_format == "tar") {
-        L_ACT("Save checksums in {}", Path);
+        L_ACT("Save {} checksums in {}", PlaceChecksumAlgo(Place), Path);
         error = SaveChecksums();
         if (error)
             return error;
         L("Unpacked size {} {}", Path, StringFormatSize(Size));
-        error = arc.SetXAttr("user.porto.unpacked_size", std::to_string(Size));
-        if (error)
-            L_WRN("Cannot save unpacked size in xattr: {}", error);
+        if (!stream) {
+            error = arc.SetXAttr("user.porto.unpacked_size", std::to_string(Size));
+            if (error)
+                L_WRN("Cannot save unpacked size in xattr: {}", error);
+        }
+    }
+
+    bool squash = SquashLayer(), mounted = false;
+    TError mount_error;
+
+    if (squash && compress_format != "squashfs") {
+        mount_error = MountLayer();
+        mounted = !mount_error;
     }
 
-    if (compress_format == "tar") {
+    if (mount_error) {
+        error = mount_error;
+    } else if (squash && compress_format == "squashfs") {
+        TFile image;
+
+        /* Export image as is */
+        error = image.OpenRead(TempPath(SQUASH_PREFIX));
+        if (!error)
+            error = CopyFile(image, arc);
+    } else if (compress_format == "tar") {
         TTuple args = { "tar",
                         "--one-file-system",
                         "--numeric-owner",
@@ -895,9 +2032,20 @@ TError TStorage::ExportArchive(const TPath &archive, const std::string &compress
     } else
         error = TError(EError::NotSupported, "Unsupported format " + compress_format);
 
-    if (!error)
+    if (mounted)
+        UmountLayer();
+
+    if (stream) {
+        /* Client must receive everything */
+        arc.Close();
+        TError relay_error = relay.Finish();
+        if (relay_error)
+            error = relay_error;
+    }
+
+    if (!error && !stream)
         error = arc.Chown(CL->TaskCred);
-    if (error)
+    if (error && !stream)
         (void)dir.UnlinkAt(archive.BaseName());
 
     DecPlaceLoad(Place);
@@ -938,6 +2086,20 @@ TError TStorage::Remove(bool weak) {
             L_WRN("Cannot remove private: {}", error);
     }
 
+    TPath image = TempPath(SQUASH_PREFIX);
+    bool squash = SquashLayer();
+    if (squash)
+        UmountUnused();
+
+    /* Meta storage needs quota destruction before removal */
+    if (Type != EStorageType::Meta &&
+            !MoveToTrash(Place, Path, 0, Type == EStorageType::Layer)) {
+        if (squash)
+            (void)image.Unlink();
+        Statistics->LayerRemove++;
+        return OK;
+    }
+
     TFile temp_dir;
     temp = TempPath(REMOVE_PREFIX + std::to_string(RemoveCounter++));
 
@@ -955,6 +2117,9 @@ TError TStorage::Remove(bool weak) {
     if (error)
         return error;
 
+    if (squash)
+        (void)image.Unlink();
+
     IncPlaceLoad(Place);
     Statistics->LayerRemove++;
 
@@ -973,6 +2138,9 @@ TError TStorage::Remove(bool weak) {
             L_WRN("Cannot remove storage {}: {}", temp, error);
     }
 
+    if (Type == EStorageType::Layer)
+        CollectObjects(Place);
+
     DecPlaceLoad(Place);
 
     lock.lock();
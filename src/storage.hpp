@@ -2,6 +2,7 @@
 
 #include <list>
 #include "util/path.hpp"
+#include "util/checksum.hpp"
 
 enum EStorageType {
     Place,
@@ -11,6 +12,15 @@ enum EStorageType {
     Volume,
 };
 
+struct TLayerCacheStat {
+    uint64_t Limit = 0;
+    uint64_t Used = 0;
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+    uint64_t Evictions = 0;
+    uint64_t EvictedBytes = 0;
+};
+
 class TStorage {
 public:
     enum EStorageType Type;
@@ -25,6 +35,7 @@ public:
     std::string Private;
     time_t LastChange = 0;
     uint64_t Size = 0;
+    uint64_t SharedSize = 0;
 
     TError Resolve(EStorageType type, const TPath &place, const std::string &name = "");
     void Open(EStorageType type, const TPath &place, const std::string &name = "");
@@ -33,8 +44,10 @@ public:
     static TError CheckPlace(const TPath &place);
     static TError SanitizeLayer(const TPath &layer, bool merge);
     TError List(enum EStorageType type, std::list<TStorage> &list, const std::string &mask="");
-    TError ImportArchive(const TPath &archive, const std::string &compress = "", bool merge = false);
-    TError ExportArchive(const TPath &archive, const std::string &compress = "");
+    TError ImportArchive(const TPath &archive, const std::string &compress = "", bool merge = false,
+                         const TFile &stream = TFile());
+    TError ExportArchive(const TPath &archive, const std::string &compress = "",
+                         const TFile &stream = TFile());
     bool Exists() const;
     bool Weak() const;
     uint64_t LastUsage() const;
@@ -46,6 +59,11 @@ public:
     TError SavePrivate(const std::string &text);
     TError SaveChecksums();
 
+    bool SquashLayer();
+    TError MountLayer();
+    void UmountLayer();
+    void UmountUnused();
+
     TError CreateMeta(uint64_t space_limit, uint64_t inode_limit);
     TError ResizeMeta(uint64_t space_limit, uint64_t inode_limit);
     TError StatMeta(TStatFS &stat);
@@ -54,8 +72,29 @@ public:
     static void IncPlaceLoad(const TPath &place);
     static void DecPlaceLoad(const TPath &place);
 
+    static TError RemoveTree(const TPath &place, const TPath &path, uint64_t space = 0);
+    static uint64_t TrashSpace(dev_t dev);
+    static void StartTrash();
+    static void StopTrash();
+    static void CollectObjects(const TPath &place);
+
+    static void StartLayerCache();
+    static void StopLayerCache();
+    static void LayerCacheAccess(const TPath &place, bool hit);
+    static void CheckLayerCache(const TPath &place, uint64_t size);
+    static TLayerCacheStat LayerCacheStat(const TPath &place);
+
 private:
     static TError Cleanup(const TPath &place, EStorageType type, unsigned perms);
+    static TError MoveToTrash(const TPath &place, const TPath &path, uint64_t space, bool collect = false);
+    static void ScanTrash(const TPath &place);
+    static void TrashWorker();
+    static void LayerCacheWorker();
+    static void EvictLayers(const TPath &place, uint64_t limit);
+    static void RefreshShared(const TPath &place);
+    TError CountSpace();
+    TError SaveSpace();
     TPath TempPath(const std::string &kind);
     TError CheckUsage();
+    TError DedupLayer(const TPath &layer, const TChecksumMap *sums = nullptr);
 };
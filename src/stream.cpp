@@ -3,15 +3,34 @@
 #include "util/log.hpp"
 #include "client.hpp"
 #include "container.hpp"
+#include "event.hpp"
+#include "epoll.hpp"
+#include "portod.hpp"
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
 
 extern "C" {
 #include <sys/ioctl.h>
+#include <sys/inotify.h>
 #include <sys/types.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 }
 
+struct TStdRing {
+    std::mutex Mutex;
+    std::shared_ptr<TEpollSource> Source;
+    std::string Data;
+    size_t Head = 0;        /* bytes before Head are dropped */
+
+    uint64_t Size() const {
+        return Data.size() - Head;
+    }
+};
+
 bool TStdStream::IsNull(void) const {
     return Path.IsEmpty() || Path.ToString() == "/dev/null";
 }
@@ -21,6 +40,10 @@ bool TStdStream::IsRedirect(void) const {
     return StringStartsWith(Path.ToString(), "/dev/fd/");
 }
 
+bool TStdStream::IsRing(void) const {
+    return Ring && Outside && !IsNull() && !IsRedirect();
+}
+
 TPath TStdStream::ResolveOutside(const TContainer &container) const {
     if (IsNull() || IsRedirect())
         return TPath();
@@ -39,7 +62,10 @@ TError TStdStream::Open(const TPath &path, const TCred &cred) {
 
     Offset = 0;
 
-    if (Stream)
+    /* Task keeps ring pipe open for read too, no SIGPIPE while porto restarts */
+    if (Stream && IsRing())
+        flags = O_RDWR;
+    else if (Stream)
         flags = O_WRONLY | O_APPEND;
     else
         flags = O_RDONLY;
@@ -133,11 +159,21 @@ TError TStdStream::OpenInside(const TContainer &container) {
 }
 
 TError TStdStream::Remove(const TContainer &container) {
+    if (RingBuffer) {
+        CloseRing();
+        std::lock_guard<std::mutex> guard(RingBuffer->Mutex);
+        std::string().swap(RingBuffer->Data);
+        RingBuffer->Head = 0;
+        Offset = 0;
+    }
+
     /* Custom stdout/stderr files are not removed */
     if (!Outside || Path.IsAbsolute())
         return OK;
     TPath path = ResolveOutside(container);
-    if (path.IsEmpty() || !path.IsRegularStrict())
+    struct stat st;
+    if (path.IsEmpty() || path.StatStrict(st) ||
+            !(S_ISREG(st.st_mode) || S_ISFIFO(st.st_mode)))
         return OK;
     TError error = path.Unlink();
     if (error && error.Errno == ENOENT)
@@ -162,12 +198,9 @@ TError TStdStream::Rotate(const TContainer &container) {
     return OK;
 }
 
-TError TStdStream::Read(const TContainer &container, std::string &text,
-                        const std::string &range) const {
-    std::string off = "", lim = "";
-    uint64_t offset, limit;
-    TError error;
+TError TStdStream::OpenRead(const TContainer &container, TFile &file) const {
     TPath path = ResolveOutside(container);
+    TError error;
 
     if (path.IsEmpty())
         return TError(EError::InvalidData, "Data not available");
@@ -176,6 +209,22 @@ TError TStdStream::Read(const TContainer &container, std::string &text,
     if (!path.IsRegularStrict())
         return TError(EError::InvalidData, "File is non-regular");
 
+    error = file.Open(path, O_RDONLY | O_NOCTTY | O_NOFOLLOW | O_CLOEXEC);
+    if (error)
+        return error;
+
+    if (file.RealPath() != path)
+        return TError(EError::Permission, "Real path doesn't match: " + path.ToString());
+
+    return OK;
+}
+
+TError TStdStream::Read(const TContainer &container, std::string &text,
+                        const std::string &range) const {
+    std::string off = "", lim = "";
+    uint64_t offset, limit;
+    TError error;
+
     /* [offset][:limit] */
     if (range.size()) {
         auto sep = range.find(':');
@@ -190,9 +239,6 @@ TError TStdStream::Read(const TContainer &container, std::string &text,
         error = StringToUint64(off, offset);
         if (error)
             return error;
-        if (offset < Offset)
-            return TError(EError::InvalidData, "Requested offset lower than current {}", Offset);
-        offset -= Offset;
     } else
         offset = 0;
 
@@ -203,16 +249,30 @@ TError TStdStream::Read(const TContainer &container, std::string &text,
     } else
         limit = Limit;
 
+    std::unique_lock<std::mutex> lock;
+    uint64_t size, base;
     TFile file;
 
-    error = file.Open(path, O_RDONLY | O_NOCTTY | O_NOFOLLOW | O_CLOEXEC);
-    if (error)
-        return error;
+    if (IsRing()) {
+        if (!RingBuffer)
+            return OK;
+        lock = std::unique_lock<std::mutex>(RingBuffer->Mutex);
+        size = RingBuffer->Size();
+    } else {
+        error = OpenRead(container, file);
+        if (error)
+            return error;
+        size = lseek(file.Fd, 0, SEEK_END);
+    }
 
-    if (file.RealPath() != path)
-        return TError(EError::Permission, "Real path doesn't match: " + path.ToString());
+    /* Ring offset moves together with data under its mutex */
+    base = Offset;
 
-    uint64_t size = lseek(file.Fd, 0, SEEK_END);
+    if (off.size()) {
+        if (offset < base)
+            return TError(EError::InvalidData, "Requested offset lower than current {}", base);
+        offset -= base;
+    }
 
     if (size <= offset)
         limit = 0;
@@ -221,12 +281,14 @@ TError TStdStream::Read(const TContainer &container, std::string &text,
     else if (!off.size())
         offset = size - limit;
 
-    if (limit) {
+    if (limit && !file) {
+        text = RingBuffer->Data.substr(RingBuffer->Head + offset, limit);
+    } else if (limit) {
         text.resize(limit);
         ssize_t result = pread(file.Fd, &text[0], limit, offset);
 
         if (result < 0)
-            return TError::System("Read " + path.ToString());
+            return TError::System("Read " + Path.ToString());
 
         if ((uint64_t)result < limit)
             text.resize(result);
@@ -234,3 +296,469 @@ TError TStdStream::Read(const TContainer &container, std::string &text,
 
     return OK;
 }
+
+/* Absolute offsets in stream: position in file plus Offset lost in rotation */
+TError TStdStream::Read(const TContainer &container, const Porto::TReadStreamRequest &req,
+                        Porto::TReadStreamResponse &rsp, TFile &file) const {
+    std::unique_lock<std::mutex> lock;
+    uint64_t base, size = 0;
+    TError error;
+
+    if (IsRing()) {
+        if (req.fd())
+            return TError(EError::NotSupported, "Stream is kept in memory");
+        if (RingBuffer) {
+            lock = std::unique_lock<std::mutex>(RingBuffer->Mutex);
+            size = RingBuffer->Size();
+        }
+    } else {
+        struct stat st;
+
+        error = OpenRead(container, file);
+        if (error)
+            return error;
+
+        error = file.Stat(st);
+        if (error)
+            return error;
+
+        size = st.st_size;
+    }
+
+    /* Ring offset moves together with data under its mutex */
+    base = Offset;
+    size += base;
+
+    uint64_t limit = Limit;
+    if (req.has_limit() && req.limit() < limit)
+        limit = req.limit();
+
+    uint64_t offset;
+
+    /* Data before base is lost, client sees that by offset in response */
+    if (req.has_offset())
+        offset = std::max(req.offset(), base);
+    else if (size > base + limit)
+        offset = size - limit;
+    else
+        offset = base;
+
+    rsp.set_offset(offset);
+    rsp.set_size(size);
+    rsp.set_base(base);
+
+    if (req.fd()) {
+        rsp.set_fd(true);
+        return OK;
+    }
+
+    if (offset < size && limit && !file) {
+        rsp.set_data(RingBuffer->Data.substr(RingBuffer->Head + offset - base,
+                                             std::min(size - offset, limit)));
+    } else if (offset < size && limit) {
+        auto data = rsp.mutable_data();
+        data->resize(std::min(size - offset, limit));
+        ssize_t result = pread(file.Fd, &(*data)[0], data->size(), offset - base);
+        if (result < 0)
+            return TError::System("Read " + Path.ToString());
+        data->resize(result);
+    }
+
+    return OK;
+}
+
+struct TStreamFollower {
+    std::weak_ptr<TClient> Client;
+    std::weak_ptr<TContainer> Container;
+    Porto::TReadStreamRequest Request;
+    uint64_t Deadline = 0;
+    int Watch = -1;
+    bool Queued = false;
+};
+
+static std::mutex FollowMutex;
+static std::map<uint64_t, TStreamFollower> Followers;
+static std::multimap<int, uint64_t> FollowWatches;
+static std::shared_ptr<TEpollSource> FollowSource;
+static uint64_t FollowSeq = 0;
+
+static void QueueFollowEvent(uint64_t id, TStreamFollower &follower) {
+    if (follower.Queued)
+        return;
+    follower.Queued = true;
+    TEvent e(EEventType::StreamFollow, follower.Container.lock());
+    e.Stream.Id = id;
+    EventQueue->Add(0, e);
+}
+
+static void RemoveFollowWatch(int wd, uint64_t id, bool rm_watch) {
+    auto range = FollowWatches.equal_range(wd);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == id) {
+            FollowWatches.erase(it);
+            break;
+        }
+    }
+    if (rm_watch && !FollowWatches.count(wd))
+        inotify_rm_watch(FollowSource->Fd, wd);
+}
+
+static bool Unfollow(uint64_t id) {
+    std::lock_guard<std::mutex> guard(FollowMutex);
+    auto it = Followers.find(id);
+    if (it == Followers.end())
+        return false;
+    if (it->second.Watch >= 0)
+        RemoveFollowWatch(it->second.Watch, id, true);
+    Followers.erase(it);
+    return true;
+}
+
+TError TStdStream::Follow(std::shared_ptr<TContainer> container,
+                          std::shared_ptr<TClient> client,
+                          const Porto::TReadStreamRequest &req,
+                          const TFile &file) {
+    std::lock_guard<std::mutex> guard(FollowMutex);
+    int wd = -1;
+
+    if (!FollowSource && file) {
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+            return TError::System("inotify_init1");
+        auto source = std::make_shared<TEpollSource>(fd, EPOLL_EVENT_STREAM,
+                                                     std::weak_ptr<TContainer>());
+        TError error = EpollLoop->AddSource(source);
+        if (error) {
+            close(fd);
+            return error;
+        }
+        FollowSource = source;
+    }
+
+    /* Ring streams have no file, they notify followers at receiving */
+    if (file) {
+        wd = inotify_add_watch(FollowSource->Fd, file.ProcPath().c_str(),
+                               IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+        if (wd < 0)
+            return TError::System("inotify_add_watch {}", file.RealPath().ToString());
+    }
+
+    uint64_t id = ++FollowSeq;
+    auto &follower = Followers[id];
+
+    follower.Client = client;
+    follower.Container = container;
+    follower.Request = req;
+    follower.Deadline = GetCurrentTimeMs() + req.timeout_ms();
+    follower.Watch = wd;
+    if (wd >= 0)
+        FollowWatches.emplace(wd, id);
+
+    /* Recheck data written before watch was added */
+    QueueFollowEvent(id, follower);
+
+    TEvent e(EEventType::StreamFollow, container);
+    e.Stream.Id = id;
+    EventQueue->Add(req.timeout_ms(), e);
+
+    return TError::Queued();
+}
+
+void TStdStream::RecvFollowEvents(int fd) {
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    std::lock_guard<std::mutex> guard(FollowMutex);
+    ssize_t len;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *ptr = buf; ptr < buf + len; ) {
+            auto event = (const struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            std::vector<uint64_t> ids;
+            auto range = FollowWatches.equal_range(event->wd);
+            for (auto it = range.first; it != range.second; ++it)
+                ids.push_back(it->second);
+
+            for (auto id: ids) {
+                auto &follower = Followers[id];
+                /* Watch is gone together with file */
+                if (event->mask & IN_IGNORED) {
+                    RemoveFollowWatch(event->wd, id, false);
+                    follower.Watch = -1;
+                }
+                QueueFollowEvent(id, follower);
+            }
+        }
+    }
+}
+
+void TStdStream::FollowEvent(uint64_t id) {
+    TStreamFollower follower;
+
+    FollowMutex.lock();
+    auto it = Followers.find(id);
+    if (it != Followers.end()) {
+        it->second.Queued = false;
+        follower = it->second;
+    }
+    FollowMutex.unlock();
+
+    auto client = follower.Client.lock();
+    if (!client || client->Fd < 0) {
+        Unfollow(id);
+        return;
+    }
+
+    Porto::TPortoResponse rsp;
+    TFile file;
+    TError error;
+
+    auto ct = follower.Container.lock();
+    if (ct) {
+        ct->LockStateRead();
+        auto &stream = follower.Request.stream() == "stderr" ? ct->Stderr : ct->Stdout;
+        error = stream.Read(*ct, follower.Request, *rsp.mutable_readstream(), file);
+        ct->UnlockState();
+    } else
+        error = TError(EError::ContainerDoesNotExist, "Container not found");
+
+    if (!error && rsp.readstream().size() <= rsp.readstream().offset() &&
+            GetCurrentTimeMs() < follower.Deadline)
+        return;
+
+    if (!Unfollow(id))
+        return;
+
+    if (error)
+        rsp.clear_readstream();
+    else if (rsp.readstream().fd())
+        client->StreamFd.Swap(file);
+
+    rsp.set_error(error.Error);
+    rsp.set_errormsg(error.Message());
+    rsp.set_timestamp(time(nullptr));
+
+    error = client->MakeResponse(rsp);
+    if (error)
+        L_WRN("Cannot send response for {} : {}", client->Id, error);
+}
+
+static void NotifyFollowers(const TContainer *container, int stream) {
+    std::lock_guard<std::mutex> guard(FollowMutex);
+    std::string name = stream == 1 ? "stdout" : "stderr";
+
+    for (auto &it: Followers) {
+        auto &follower = it.second;
+        if (follower.Request.stream() == name &&
+                follower.Container.lock().get() == container)
+            QueueFollowEvent(it.first, follower);
+    }
+}
+
+/* Receive data from pipe, returns true at end of stream */
+static bool DrainRing(TStdRing &ring, uint64_t &received) {
+    char buf[65536];
+
+    /* Do not starve other epoll sources, level triggered epoll returns here */
+    for (int i = 0; i < 16; i++) {
+        ssize_t len = read(ring.Source->Fd, buf, sizeof(buf));
+        if (len > 0) {
+            ring.Data.append(buf, len);
+            received += len;
+        } else if (len < 0 && errno == EINTR)
+            continue;
+        else
+            return len == 0 || errno != EAGAIN;
+    }
+
+    return false;
+}
+
+/* Limit is enforced at each receive, returns count of dropped bytes */
+static uint64_t TrimRing(TStdRing &ring, uint64_t limit) {
+    uint64_t loss = 0;
+
+    if (ring.Size() > limit) {
+        loss = ring.Size() - limit;
+        ring.Head += loss;
+        Statistics->LogRotateBytes += loss;
+    }
+
+    if (ring.Head && ring.Head >= ring.Data.size() / 2) {
+        ring.Data.erase(0, ring.Head);
+        ring.Head = 0;
+    }
+
+    return loss;
+}
+
+TError TStdStream::OpenRing(std::shared_ptr<TContainer> container, bool restore) {
+    TPath path = ResolveOutside(*container);
+    TError error;
+
+    if (!IsRing() || path.IsEmpty())
+        return OK;
+
+    if (!RingBuffer)
+        RingBuffer = std::make_shared<TStdRing>();
+    else
+        CloseRing();
+
+    if (!restore) {
+        (void)path.Unlink();
+        error = path.Mknod(S_IFIFO | 0660, 0);
+        if (error)
+            return error;
+        error = path.Chown(container->TaskCred);
+        if (error)
+            return error;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_NOCTTY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0)
+        return TError::System("open {}", path);
+
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISFIFO(st.st_mode)) {
+        close(fd);
+        return TError(EError::InvalidData, "{} is not a pipe", path);
+    }
+
+    auto source = std::make_shared<TEpollSource>(fd,
+            Stream == 1 ? EPOLL_EVENT_STDOUT : EPOLL_EVENT_STDERR, container);
+
+    RingBuffer->Mutex.lock();
+    RingBuffer->Source = source;
+    RingBuffer->Mutex.unlock();
+
+    error = EpollLoop->AddSource(source);
+    if (error)
+        CloseRing();
+
+    return error;
+}
+
+void TStdStream::CloseRing() {
+    std::shared_ptr<TEpollSource> source;
+    uint64_t received = 0;
+
+    if (!RingBuffer)
+        return;
+
+    RingBuffer->Mutex.lock();
+    source = RingBuffer->Source;
+    if (source) {
+        DrainRing(*RingBuffer, received);
+        Offset += TrimRing(*RingBuffer, Limit);
+        RingBuffer->Source = nullptr;
+    }
+    RingBuffer->Mutex.unlock();
+
+    if (source) {
+        EpollLoop->RemoveSource(source->Fd);
+        close(source->Fd);
+    }
+}
+
+void TStdStream::RecvRing(std::shared_ptr<TContainer> container, int fd) {
+    auto ring = RingBuffer;
+    uint64_t received = 0;
+
+    if (!ring)
+        return;
+
+    ring->Mutex.lock();
+
+    if (!ring->Source || ring->Source->Fd != fd) {
+        ring->Mutex.unlock();
+        return;
+    }
+
+    /* Writers are gone, next task reopens pipe */
+    if (DrainRing(*ring, received))
+        EpollLoop->StopInput(fd);
+
+    Offset += TrimRing(*ring, Limit);
+
+    ring->Mutex.unlock();
+
+    if (received)
+        NotifyFollowers(container.get(), Stream);
+}
+
+typedef std::pair<std::weak_ptr<TContainer>, int> TRotateTarget;
+
+static std::mutex RotateMutex;
+static std::shared_ptr<TEpollSource> RotateSource;
+static std::unordered_map<int, TRotateTarget> RotateWatches;
+static std::vector<TRotateTarget> RotatePending;
+
+void TStdStream::WatchRotate(std::shared_ptr<TContainer> container) {
+    TPath path = ResolveOutside(*container);
+
+    if (path.IsEmpty() || !path.IsRegularStrict())
+        return;
+
+    std::lock_guard<std::mutex> guard(RotateMutex);
+
+    if (!RotateSource) {
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0) {
+            auto source = std::make_shared<TEpollSource>(fd, EPOLL_EVENT_ROTATE,
+                                                         std::weak_ptr<TContainer>());
+            if (EpollLoop->AddSource(source))
+                close(fd);
+            else
+                RotateSource = source;
+        }
+    }
+
+    /* Watch fires once at first write after rotation */
+    int wd = -1;
+    if (RotateSource)
+        wd = inotify_add_watch(RotateSource->Fd, path.c_str(),
+                               IN_MODIFY | IN_ONESHOT | IN_DONT_FOLLOW);
+
+    /* Out of watches: check at each rotation */
+    if (wd < 0)
+        RotatePending.emplace_back(container, Stream);
+    else
+        RotateWatches[wd] = TRotateTarget(container, Stream);
+}
+
+void TStdStream::RecvRotateEvents(int fd) {
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    std::lock_guard<std::mutex> guard(RotateMutex);
+    ssize_t len;
+
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *ptr = buf; ptr < buf + len; ) {
+            auto event = (const struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            auto it = RotateWatches.find(event->wd);
+            if (it == RotateWatches.end())
+                continue;
+            if (!(event->mask & IN_IGNORED))
+                RotatePending.push_back(it->second);
+            RotateWatches.erase(it);
+        }
+    }
+}
+
+void TStdStream::RotateModified() {
+    std::vector<TRotateTarget> pending;
+
+    RotateMutex.lock();
+    pending.swap(RotatePending);
+    RotateMutex.unlock();
+
+    for (auto &it: pending) {
+        auto ct = it.first.lock();
+        if (!ct || ct->State != EContainerState::RUNNING)
+            continue;
+        auto &stream = it.second == 1 ? ct->Stdout : ct->Stderr;
+        stream.Rotate(*ct);
+        stream.WatchRotate(ct);
+    }
+}
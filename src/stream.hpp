@@ -1,10 +1,13 @@
 #pragma once
 
 #include <string>
+#include <memory>
+#include <atomic>
 #include <util/path.hpp>
 
 class TContainer;
 class TClient;
+struct TStdRing;
 
 class TStdStream {
 public:
@@ -12,9 +15,11 @@ public:
     TPath Path;
     bool Outside = false;
     uint64_t Limit = 0;
-    uint64_t Offset = 0;
+    std::atomic<uint64_t> Offset;   /* bytes lost in rotation, ring updates under its mutex */
+    bool Ring = false;      /* stdout_ring: named pipe drained into memory */
+    std::shared_ptr<TStdRing> RingBuffer;
 
-    TStdStream(int stream): Stream(stream) { }
+    TStdStream(int stream): Stream(stream), Offset(0) { }
 
     void SetOutside(const std::string &path) {
         Path = path;
@@ -28,6 +33,7 @@ public:
 
     bool IsNull(void) const;
     bool IsRedirect(void) const;
+    bool IsRing(void) const;
     TPath ResolveOutside(const TContainer &container) const;
 
     TError Open(const TPath &path, const TCred &cred);
@@ -36,7 +42,27 @@ public:
 
     TError Remove(const TContainer &container);
 
+    TError OpenRing(std::shared_ptr<TContainer> container, bool restore = false);
+    void CloseRing();
+    void RecvRing(std::shared_ptr<TContainer> container, int fd);
+
     TError Rotate(const TContainer &container);
+
+    /* Rotate only files modified since last check */
+    void WatchRotate(std::shared_ptr<TContainer> container);
+    static void RecvRotateEvents(int fd);
+    static void RotateModified();
+    TError OpenRead(const TContainer &container, TFile &file) const;
     TError Read(const TContainer &container, std::string &text,
                 const std::string &range = "") const;
+    TError Read(const TContainer &container, const Porto::TReadStreamRequest &req,
+                Porto::TReadStreamResponse &rsp, TFile &file) const;
+
+    /* Deliver ReadStream response when data appears or timeout expires */
+    static TError Follow(std::shared_ptr<TContainer> container,
+                         std::shared_ptr<TClient> client,
+                         const Porto::TReadStreamRequest &req,
+                         const TFile &file);
+    static void RecvFollowEvents(int fd);
+    static void FollowEvent(uint64_t id);
 };
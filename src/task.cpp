@@ -264,7 +264,7 @@ TError TTaskEnv::ApplySysctl() {
         }
     }
 
-    for (const auto &it: CT->Sysctl) {
+    for (const auto &it: CT->Sparse().Sysctl) {
         auto &key = it.first;
 
         if (TNetwork::NetworkSysctl(key)) {
@@ -334,8 +334,8 @@ TError TTaskEnv::ConfigureChild() {
     if (error)
         return error;
 
-    if (CT->EtcHosts.size()) {
-        error = TPath("/etc/hosts").WritePrivate(CT->EtcHosts);
+    if (CT->Sparse().EtcHosts.size()) {
+        error = TPath("/etc/hosts").WritePrivate(CT->Sparse().EtcHosts);
         if (error)
             return error;
     }
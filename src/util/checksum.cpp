@@ -0,0 +1,209 @@
+#include <memory>
+
+#include "checksum.hpp"
+
+extern "C" {
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+/* XXH64 by Yann Collet, see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md */
+
+static constexpr uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t XxhRotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t XxhRead64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+static inline uint32_t XxhRead32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return le32toh(v);
+}
+
+static inline uint64_t XxhRound(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    acc = XxhRotl(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t XxhMerge(uint64_t acc, uint64_t val) {
+    acc ^= XxhRound(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+TChecksum::TChecksum(const std::string &algo) : Xxh64(algo == "xxh64") {
+    if (Xxh64) {
+        Xxh.Total = 0;
+        Xxh.V[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+        Xxh.V[1] = XXH_PRIME64_2;
+        Xxh.V[2] = 0;
+        Xxh.V[3] = -XXH_PRIME64_1;
+        Xxh.MemSize = 0;
+    } else
+        Md5Init(&Md5);
+}
+
+bool TChecksum::Supported(const std::string &algo) {
+    return algo == "md5" || algo == "xxh64";
+}
+
+void TChecksum::Xxh64Update(const unsigned char *data, size_t len) {
+    const unsigned char *end = data + len;
+
+    Xxh.Total += len;
+
+    if (Xxh.MemSize + len < 32) {
+        memcpy(Xxh.Mem + Xxh.MemSize, data, len);
+        Xxh.MemSize += len;
+        return;
+    }
+
+    if (Xxh.MemSize) {
+        size_t fill = 32 - Xxh.MemSize;
+        memcpy(Xxh.Mem + Xxh.MemSize, data, fill);
+        for (int i = 0; i < 4; i++)
+            Xxh.V[i] = XxhRound(Xxh.V[i], XxhRead64(Xxh.Mem + i * 8));
+        data += fill;
+        Xxh.MemSize = 0;
+    }
+
+    uint64_t v1 = Xxh.V[0], v2 = Xxh.V[1], v3 = Xxh.V[2], v4 = Xxh.V[3];
+
+    for (; data + 32 <= end; data += 32) {
+        v1 = XxhRound(v1, XxhRead64(data));
+        v2 = XxhRound(v2, XxhRead64(data + 8));
+        v3 = XxhRound(v3, XxhRead64(data + 16));
+        v4 = XxhRound(v4, XxhRead64(data + 24));
+    }
+
+    Xxh.V[0] = v1;
+    Xxh.V[1] = v2;
+    Xxh.V[2] = v3;
+    Xxh.V[3] = v4;
+
+    Xxh.MemSize = end - data;
+    memcpy(Xxh.Mem, data, Xxh.MemSize);
+}
+
+uint64_t TChecksum::Xxh64Digest() {
+    const unsigned char *p = Xxh.Mem, *end = Xxh.Mem + Xxh.MemSize;
+    uint64_t h;
+
+    if (Xxh.Total >= 32) {
+        h = XxhRotl(Xxh.V[0], 1) + XxhRotl(Xxh.V[1], 7) +
+            XxhRotl(Xxh.V[2], 12) + XxhRotl(Xxh.V[3], 18);
+        for (int i = 0; i < 4; i++)
+            h = XxhMerge(h, Xxh.V[i]);
+    } else
+        h = XXH_PRIME64_5;
+
+    h += Xxh.Total;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= XxhRound(0, XxhRead64(p));
+        h = XxhRotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+
+    if (p + 4 <= end) {
+        h ^= XxhRead32(p) * XXH_PRIME64_1;
+        h = XxhRotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+
+    for (; p < end; p++) {
+        h ^= *p * XXH_PRIME64_5;
+        h = XxhRotl(h, 11) * XXH_PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+void TChecksum::Update(const void *data, size_t len) {
+    if (Xxh64)
+        Xxh64Update((const unsigned char *)data, len);
+    else
+        Md5Update(&Md5, data, len);
+}
+
+std::string TChecksum::Hex() {
+    if (Xxh64)
+        return fmt::format("{:016x}", Xxh64Digest());
+
+    unsigned char bin[16];
+    std::string sum;
+
+    Md5Final(bin, &Md5);
+    for (int i = 0; i < 16; ++i)
+        sum += fmt::format("{:02x}", bin[i]);
+    return sum;
+}
+
+std::string ChecksumXattr(const std::string &algo) {
+    return "user.porto." + algo + "sum";
+}
+
+TError SaveChecksum(const TFile &file, const std::string &algo, const std::string &sum) {
+    TError error = file.SetXAttr(ChecksumXattr(algo), sum);
+    if (error)
+        return error;
+
+    /* Content could be changed since other checksum was saved */
+    for (auto other: { "md5", "xxh64" })
+        if (algo != other)
+            (void)syscall(SYS_fremovexattr, file.Fd, ChecksumXattr(other).c_str());
+
+    return OK;
+}
+
+TError FileChecksum(const TFile &file, const std::string &algo, std::string &sum) {
+    TChecksum checksum(algo);
+    struct stat st;
+
+    if (fstat(file.Fd, &st))
+        return TError::System("fstat");
+
+    /* Small files are read at once, large by 1M chunks */
+    size_t size = std::min(std::max((uint64_t)st.st_size + 1, (uint64_t)4096),
+                           (uint64_t)(1 << 20));
+    std::unique_ptr<char[]> buf(new char[size]);
+
+    if ((uint64_t)st.st_size >= size)
+        (void)posix_fadvise(file.Fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    for (off_t off = 0; ; ) {
+        ssize_t ret = pread(file.Fd, buf.get(), size, off);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+            return TError::System("pread");
+        if (!ret)
+            break;
+        checksum.Update(buf.get(), ret);
+        off += ret;
+    }
+
+    sum = checksum.Hex();
+    return OK;
+}
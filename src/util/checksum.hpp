@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "util/md5.hpp"
+#include "util/path.hpp"
+
+/*
+ * Streaming content digest: "md5" for compatibility with saved checksums,
+ * "xxh64" is non-cryptographic but several times faster.
+ */
+class TChecksum {
+    bool Xxh64;
+    TMd5Context Md5;
+
+    struct {
+        uint64_t Total;
+        uint64_t V[4];
+        unsigned char Mem[32];
+        size_t MemSize;
+    } Xxh;
+
+    void Xxh64Update(const unsigned char *data, size_t len);
+    uint64_t Xxh64Digest();
+
+public:
+    explicit TChecksum(const std::string &algo = "md5");
+
+    static bool Supported(const std::string &algo);
+
+    void Update(const void *data, size_t len);
+    std::string Hex();
+};
+
+/* Path inside tree -> checksum of content */
+typedef std::unordered_map<std::string, std::string> TChecksumMap;
+
+/* Xattr where porto keeps checksum of file content */
+std::string ChecksumXattr(const std::string &algo);
+
+/* Save checksum into xattr and drop checksum by other algorithm */
+TError SaveChecksum(const TFile &file, const std::string &algo, const std::string &sum);
+
+TError FileChecksum(const TFile &file, const std::string &algo, std::string &sum);
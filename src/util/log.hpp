@@ -67,6 +67,20 @@ struct TStatistics {
     std::atomic<uint64_t> NetworkProblems;
     std::atomic<uint64_t> NetworkRepairs;
     std::atomic<uint64_t> PortoCrash;
+    std::atomic<uint64_t> ContainersPressure;
+    std::atomic<uint64_t> GetValues;
+    std::atomic<uint64_t> GetValueAllocs;
+    std::atomic<uint64_t> EventSeq;
+    std::atomic<uint64_t> TrashEntries;
+    std::atomic<uint64_t> TrashSpace;
+    std::atomic<uint64_t> TrashRemoved;
+    std::atomic<uint64_t> LayerDedupFiles;
+    std::atomic<uint64_t> LayerDedupBytes;
+    std::atomic<uint64_t> LayerObjectsRemoved;
+    std::atomic<uint64_t> LayerExtractFallback;
+    std::atomic<uint64_t> LayerCacheHits;
+    std::atomic<uint64_t> LayerCacheMisses;
+    std::atomic<uint64_t> LayerCacheEvictions;
 
     /* --- add new fields at the end --- */
 };
@@ -85,6 +99,8 @@ static inline void ResetStatistics() {
     Statistics->RequestsQueued = 0;
     Statistics->NetworksCount = 0;
     Statistics->LongestRoRequest = 0;
+    Statistics->TrashEntries = 0;
+    Statistics->TrashSpace = 0;
 }
 
 template <typename... Args> inline void L_DBG(const char* fmt, const Args&... args) {
@@ -37,15 +37,7 @@
 
 #include "md5.hpp"
 
-/* Any 32-bit or wider unsigned integer data type will do */
-typedef unsigned int MD5_u32plus;
-
-typedef struct {
-    MD5_u32plus lo, hi;
-    MD5_u32plus a, b, c, d;
-    unsigned char buffer[64];
-    MD5_u32plus block[16];
-} MD5_CTX;
+#include <string.h>
 
 /*
  * The basic MD5 functions.
@@ -103,7 +95,7 @@ typedef struct {
  * This processes one or more 64-byte data blocks, but does NOT update the bit
  * counters.  There are no alignment requirements.
  */
-static const void *body(MD5_CTX *ctx, const void *data, unsigned long size)
+static const void *body(TMd5Context *ctx, const void *data, unsigned long size)
 {
     const unsigned char *ptr;
     MD5_u32plus a, b, c, d;
@@ -210,7 +202,7 @@ static const void *body(MD5_CTX *ctx, const void *data, unsigned long size)
     return ptr;
 }
 
-static void MD5_Init(MD5_CTX *ctx)
+void Md5Init(TMd5Context *ctx)
 {
     ctx->a = 0x67452301;
     ctx->b = 0xefcdab89;
@@ -221,7 +213,7 @@ static void MD5_Init(MD5_CTX *ctx)
     ctx->hi = 0;
 }
 
-static void MD5_Update(MD5_CTX *ctx, const void *data, unsigned long size)
+void Md5Update(TMd5Context *ctx, const void *data, unsigned long size)
 {
     MD5_u32plus saved_lo;
     unsigned long used, available;
@@ -261,7 +253,7 @@ static void MD5_Update(MD5_CTX *ctx, const void *data, unsigned long size)
     (dst)[2] = (unsigned char)((src) >> 16); \
     (dst)[3] = (unsigned char)((src) >> 24);
 
-static void MD5_Final(unsigned char *result, MD5_CTX *ctx)
+void Md5Final(unsigned char *result, TMd5Context *ctx)
 {
     unsigned long used, available;
 
@@ -293,25 +285,3 @@ static void MD5_Final(unsigned char *result, MD5_CTX *ctx)
 
     memset(ctx, 0, sizeof(*ctx));
 }
-
-TError Md5Sum(TFile &file, std::string &sum) {
-    MD5_CTX ctx;
-    unsigned char bin[16];
-    std::string buf;
-    TError error;
-
-    MD5_Init(&ctx);
-    while (1) {
-        error = file.Read(buf);
-        if (error)
-            return error;
-        if (!buf.size())
-            break;
-        MD5_Update(&ctx, buf.c_str(), buf.size());
-    }
-    MD5_Final(bin, &ctx);
-    sum = "";
-    for (int i = 0; i < 16; ++i)
-        sum += fmt::format("{:02x}", bin[i]);
-    return OK;
-}
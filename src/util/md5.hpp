@@ -1,5 +1,15 @@
 #pragma once
 
-#include "util/path.hpp"
+/* Any 32-bit or wider unsigned integer data type will do */
+typedef unsigned int MD5_u32plus;
 
-TError Md5Sum(TFile &file, std::string &sum);
+typedef struct {
+    MD5_u32plus lo, hi;
+    MD5_u32plus a, b, c, d;
+    unsigned char buffer[64];
+    MD5_u32plus block[16];
+} TMd5Context;
+
+void Md5Init(TMd5Context *ctx);
+void Md5Update(TMd5Context *ctx, const void *data, unsigned long size);
+void Md5Final(unsigned char *result, TMd5Context *ctx);
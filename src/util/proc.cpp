@@ -1,25 +1,40 @@
 #include <sstream>
+#include <cstring>
 
 #include "proc.hpp"
 #include "path.hpp"
 
-const static TStringMap VmStatMap = {
-    {"VmSize", "size"},
-    {"VmPeak", "max_size"},
-    {"VmRSS", "used"},
-    {"VmHWM", "max_used"},
-    {"RssAnon", "anon"},
-    {"RssFile", "file"},
-    {"RssShmem", "shmem"},
-    {"HugetlbPages", "huge"},
-    {"VmSwap", "swap"},
-    {"VmData", "data"},
-    {"VmStk", "stack"},
-    {"VmExe", "code"},
-    {"VmLib", "code"},
-    {"VmLck", "locked"},
-    {"VmPTE", "table"},
-    {"VmPMD", "table"},
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
+const char *TVmStat::FieldName[TVmStat::VM_NR_FIELDS] = {
+    "count", "size", "max_size", "used", "max_used", "anon", "file", "shmem", "huge",
+    "swap", "data", "stack", "code", "locked", "table",
+};
+
+static const struct {
+    const char *Key;
+    size_t Len;
+    TVmStat::EField Field;
+} VmStatKeys[] = {
+    {"VmSize:", 7, TVmStat::VM_SIZE},
+    {"VmPeak:", 7, TVmStat::VM_MAX_SIZE},
+    {"VmRSS:", 6, TVmStat::VM_USED},
+    {"VmHWM:", 6, TVmStat::VM_MAX_USED},
+    {"RssAnon:", 8, TVmStat::VM_ANON},
+    {"RssFile:", 8, TVmStat::VM_FILE},
+    {"RssShmem:", 9, TVmStat::VM_SHMEM},
+    {"HugetlbPages:", 13, TVmStat::VM_HUGE},
+    {"VmSwap:", 7, TVmStat::VM_SWAP},
+    {"VmData:", 7, TVmStat::VM_DATA},
+    {"VmStk:", 6, TVmStat::VM_STACK},
+    {"VmExe:", 6, TVmStat::VM_CODE},
+    {"VmLib:", 6, TVmStat::VM_CODE},
+    {"VmLck:", 6, TVmStat::VM_LOCKED},
+    {"VmPTE:", 6, TVmStat::VM_TABLE},
+    {"VmPMD:", 6, TVmStat::VM_TABLE},
 };
 
 TVmStat::TVmStat() {
@@ -27,57 +42,227 @@ TVmStat::TVmStat() {
 }
 
 void TVmStat::Reset() {
-    for (auto &it: VmStatMap)
-        Stat[it.second] = 0;
+    for (auto &val: Stat)
+        val = 0;
 }
 
 void TVmStat::Add(const TVmStat &other) {
-    for (auto &it: other.Stat)
-        Stat[it.first] += it.second;
-}
-
-void TVmStat::Dump(Porto::TVmStat &s) {
-    s.set_count(Stat["count"]);
-    s.set_size(Stat["size"]);
-    s.set_max_size(Stat["max_size"]);
-    s.set_used(Stat["used"]);
-    s.set_max_used(Stat["max_used"]);
-    s.set_anon(Stat["anon"]);
-    s.set_file(Stat["file"]);
-    s.set_shmem(Stat["shmem"]);
-    s.set_huge(Stat["huge"]);
-    s.set_swap(Stat["swap"]);
-    s.set_data(Stat["data"]);
-    s.set_stack(Stat["stack"]);
-    s.set_code(Stat["code"]);
-    s.set_locked(Stat["locked"]);
-    s.set_table(Stat["table"]);
+    for (int i = 0; i < VM_NR_FIELDS; i++)
+        Stat[i] += other.Stat[i];
+}
+
+void TVmStat::Dump(Porto::TVmStat &s) const {
+    s.set_count(Stat[VM_COUNT]);
+    s.set_size(Stat[VM_SIZE]);
+    s.set_max_size(Stat[VM_MAX_SIZE]);
+    s.set_used(Stat[VM_USED]);
+    s.set_max_used(Stat[VM_MAX_USED]);
+    s.set_anon(Stat[VM_ANON]);
+    s.set_file(Stat[VM_FILE]);
+    s.set_shmem(Stat[VM_SHMEM]);
+    s.set_huge(Stat[VM_HUGE]);
+    s.set_swap(Stat[VM_SWAP]);
+    s.set_data(Stat[VM_DATA]);
+    s.set_stack(Stat[VM_STACK]);
+    s.set_code(Stat[VM_CODE]);
+    s.set_locked(Stat[VM_LOCKED]);
+    s.set_table(Stat[VM_TABLE]);
+}
+
+void TVmStat::Get(TUintMap &map) const {
+    for (int i = 0; i < VM_NR_FIELDS; i++)
+        map[FieldName[i]] = Stat[i];
+}
+
+TError TVmStat::Get(const std::string &name, uint64_t &value) const {
+    for (int i = 0; i < VM_NR_FIELDS; i++) {
+        if (name == FieldName[i]) {
+            value = Stat[i];
+            return OK;
+        }
+    }
+    return TError(EError::InvalidProperty, "Unknown {}", name);
 }
 
+bool TVmStat::Brief(const std::string &name) {
+    return name == "count" || name == "size" || name == "used" || name == "anon";
+}
+
+static ssize_t ReadProcFile(const std::string &path, char *buf, size_t size) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0)
+        return -1;
+    ssize_t len = read(fd, buf, size - 1);
+    close(fd);
+    if (len >= 0)
+        buf[len] = 0;
+    return len;
+}
+
+/* Lines like "VmRSS:      1234 kB", without allocations */
 TError TVmStat::Parse(pid_t pid) {
-    std::string text, line;
-    TError error;
+    char buf[8 << 10];
+    std::string text;
+    const char *ptr;
+    ssize_t len;
+
+    len = ReadProcFile(fmt::format("/proc/{}/status", pid), buf, sizeof(buf));
+    if (len < 0)
+        return TError::System("Cannot read status of {}", pid);
 
-    error = TPath(fmt::format("/proc/{}/status", pid)).ReadAll(text, 64 << 10);
-    if (error)
-        return error;
+    ptr = buf;
+
+    /* Huge supplementary groups list, take slow path */
+    if ((size_t)len == sizeof(buf) - 1) {
+        TError error = TPath(fmt::format("/proc/{}/status", pid)).ReadAll(text, 64 << 10);
+        if (error)
+            return error;
+        ptr = text.c_str();
+    }
 
-    std::stringstream ss(text);
-    while (std::getline(ss, line)) {
-        if (!StringEndsWith(line, "kB"))
+    for (; *ptr; ptr = strchrnul(ptr, '\n'), ptr += !!*ptr) {
+        if (ptr[0] != 'V' && ptr[0] != 'R' && ptr[0] != 'H')
             continue;
+        for (auto &key: VmStatKeys) {
+            if (!strncmp(ptr, key.Key, key.Len)) {
+                Stat[key.Field] += strtoull(ptr + key.Len, nullptr, 10) << 10;
+                break;
+            }
+        }
+    }
+
+    Stat[VM_COUNT] += 1;
+
+    return OK;
+}
+
+/* Only size, resident and shared pages: "size resident shared text lib data dt" */
+TError TVmStat::ParseStatm(pid_t pid) {
+    static const uint64_t page = sysconf(_SC_PAGESIZE);
+    unsigned long long size, resident, shared;
+    char buf[256];
+
+    if (ReadProcFile(fmt::format("/proc/{}/statm", pid), buf, sizeof(buf)) < 0)
+        return TError::System("Cannot read statm of {}", pid);
+
+    if (sscanf(buf, "%llu %llu %llu", &size, &resident, &shared) != 3)
+        return TError(EError::Unknown, "Cannot parse statm of {}", pid);
+
+    Stat[VM_COUNT] += 1;
+    Stat[VM_SIZE] += size * page;
+    Stat[VM_USED] += resident * page;
+    Stat[VM_ANON] += (resident - std::min(shared, resident)) * page;
 
-        uint64_t val;
-        auto sep = line.find(':');
-        if (StringToUint64(line.substr(sep + 1, line.size() - sep - 3), val))
+    return OK;
+}
+
+bool TVmStatCache::Get(pid_t pid, uint64_t now, uint64_t ttl, TVmStat &stat) {
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto it = Entries.find(pid);
+    if (it == Entries.end() || now - it->second.Time >= ttl)
+        return false;
+    stat.Add(it->second.Stat);
+    return true;
+}
+
+void TVmStatCache::Put(pid_t pid, uint64_t now, uint64_t ttl, const TVmStat &stat) {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    if (now - PruneTime >= ttl) {
+        for (auto it = Entries.begin(); it != Entries.end(); ) {
+            if (now - it->second.Time >= ttl)
+                it = Entries.erase(it);
+            else
+                ++it;
+        }
+        PruneTime = now;
+    }
+
+    auto &entry = Entries[pid];
+    entry.Time = now;
+    entry.Stat = stat;
+}
+
+/* some avg10=0.00 avg60=0.00 avg300=0.00 total=0 */
+TError TPressure::Parse(const std::string &text) {
+    bool found = false;
+
+    for (auto &line: SplitString(text, '\n')) {
+        unsigned long long total;
+        double avg10, avg60, avg300;
+        char type[8];
+
+        if (sscanf(line.c_str(), "%7s avg10=%lf avg60=%lf avg300=%lf total=%llu",
+                   type, &avg10, &avg60, &avg300, &total) != 5)
+            continue;
+
+        TStat *stat;
+        if (!strcmp(type, "some"))
+            stat = &Some;
+        else if (!strcmp(type, "full"))
+            stat = &Full;
+        else
             continue;
-        auto key = line.substr(0, sep);
 
-        auto it = VmStatMap.find(key);
-        if (it != VmStatMap.end())
-            Stat[it->second] += val << 10;
+        stat->Avg10 = avg10;
+        stat->Avg60 = avg60;
+        stat->Avg300 = avg300;
+        stat->Total = total;
+        found = true;
     }
-    Stat["count"] += 1;
+
+    if (!found)
+        return TError(EError::Unknown, "Cannot parse pressure: {}", text);
 
     return OK;
 }
+
+std::string TPressure::Format() const {
+    return fmt::format("some_avg10: {:.2f}; some_avg60: {:.2f}; some_avg300: {:.2f}; some_total: {}; "
+                       "full_avg10: {:.2f}; full_avg60: {:.2f}; full_avg300: {:.2f}; full_total: {}",
+                       Some.Avg10, Some.Avg60, Some.Avg300, Some.Total,
+                       Full.Avg10, Full.Avg60, Full.Avg300, Full.Total);
+}
+
+TError TPressure::Get(const std::string &index, std::string &value) const {
+    auto sep = index.find('_');
+    if (sep == std::string::npos)
+        return TError(EError::InvalidValue, "Invalid index: {}", index);
+
+    const TStat *stat;
+    auto type = index.substr(0, sep);
+    if (type == "some")
+        stat = &Some;
+    else if (type == "full")
+        stat = &Full;
+    else
+        return TError(EError::InvalidValue, "Invalid index: {}", index);
+
+    auto key = index.substr(sep + 1);
+    if (key == "avg10")
+        value = fmt::format("{:.2f}", stat->Avg10);
+    else if (key == "avg60")
+        value = fmt::format("{:.2f}", stat->Avg60);
+    else if (key == "avg300")
+        value = fmt::format("{:.2f}", stat->Avg300);
+    else if (key == "total")
+        value = std::to_string(stat->Total);
+    else
+        return TError(EError::InvalidValue, "Invalid index: {}", index);
+
+    return OK;
+}
+
+void TPressure::Dump(Porto::TPressure &p) const {
+    auto some = p.mutable_some();
+    some->set_avg10(Some.Avg10);
+    some->set_avg60(Some.Avg60);
+    some->set_avg300(Some.Avg300);
+    some->set_total(Some.Total);
+
+    auto full = p.mutable_full();
+    full->set_avg10(Full.Avg10);
+    full->set_avg60(Full.Avg60);
+    full->set_avg300(Full.Avg300);
+    full->set_total(Full.Total);
+}
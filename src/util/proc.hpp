@@ -1,14 +1,62 @@
 #pragma once
 
+#include <mutex>
+#include <unordered_map>
+
 #include "string.hpp"
 
 class TVmStat {
 public:
-   TUintMap Stat;
+   enum EField {
+       VM_COUNT, VM_SIZE, VM_MAX_SIZE, VM_USED, VM_MAX_USED, VM_ANON, VM_FILE,
+       VM_SHMEM, VM_HUGE, VM_SWAP, VM_DATA, VM_STACK, VM_CODE, VM_LOCKED, VM_TABLE,
+       VM_NR_FIELDS,
+   };
+
+   static const char *FieldName[VM_NR_FIELDS];
+
+   uint64_t Stat[VM_NR_FIELDS];
 
    TVmStat();
    void Reset();
    TError Parse(pid_t pid);
+   TError ParseStatm(pid_t pid);
    void Add(const TVmStat &a);
-   void Dump(Porto::TVmStat &s);
+   void Dump(Porto::TVmStat &s) const;
+   void Get(TUintMap &map) const;
+   TError Get(const std::string &name, uint64_t &value) const;
+
+   /* fields available from statm */
+   static bool Brief(const std::string &name);
+};
+
+/* Per-pid VmStat keyed by process start time */
+class TVmStatCache {
+   struct TEntry {
+       uint64_t Time;
+       TVmStat Stat;
+   };
+
+   std::mutex Mutex;
+   std::unordered_map<pid_t, TEntry> Entries;
+   uint64_t PruneTime = 0;
+
+public:
+   bool Get(pid_t pid, uint64_t now, uint64_t ttl, TVmStat &stat);
+   void Put(pid_t pid, uint64_t now, uint64_t ttl, const TVmStat &stat);
+};
+
+class TPressure {
+public:
+   struct TStat {
+       double Avg10 = 0;
+       double Avg60 = 0;
+       double Avg300 = 0;
+       uint64_t Total = 0;
+   } Some, Full;
+
+   TError Parse(const std::string &text);
+   std::string Format() const;
+   TError Get(const std::string &index, std::string &value) const;
+   void Dump(Porto::TPressure &p) const;
 };
@@ -433,7 +433,7 @@ TError TProjectQuota::Resize() {
     return OK;
 }
 
-TError TProjectQuota::Destroy() {
+TError TProjectQuota::Destroy(bool removed) {
     struct if_dqblk quota;
     TError error;
 
@@ -448,7 +448,7 @@ TError TProjectQuota::Destroy() {
     memset(&quota, 0, sizeof(quota));
     quota.dqb_valid = QIF_LIMITS;
 
-    if (!config().volumes().keep_project_quota_id()) {
+    if (!removed && !config().volumes().keep_project_quota_id()) {
         error = SetProjectIdAll(Path, 0);
         if (!error && Type == "ext4")
             quota.dqb_valid = QIF_ALL;
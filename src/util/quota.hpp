@@ -36,7 +36,8 @@ public:
     TError Load();
     TError Create();
     TError Resize();
-    TError Destroy();
+    /* Files which are going to be removed keep project id, unlink releases usage */
+    TError Destroy(bool removed = false);
 
     TError StatFS(TStatFS &result);
 
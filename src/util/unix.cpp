@@ -196,6 +196,30 @@ uint64_t GetHugetlbMemory() {
     return (uint64_t)pages << 21;
 }
 
+/* total count of OOM kills in system, including memory cgroup OOMs */
+TError GetSystemOomKills(uint64_t &count) {
+    FILE *file = fopen("/proc/vmstat", "r");
+    static const char key[] = "oom_kill ";
+    bool found = false;
+    char line[128];
+
+    if (!file)
+        return TError::System("Cannot open /proc/vmstat");
+
+    while (!found && fgets(line, sizeof(line), file)) {
+        if (!strncmp(line, key, sizeof(key) - 1)) {
+            count = strtoull(line + sizeof(key) - 1, nullptr, 10);
+            found = true;
+        }
+    }
+
+    fclose(file);
+
+    if (!found)
+        return TError(EError::NotSupported, "no oom_kill in /proc/vmstat");
+    return OK;
+}
+
 static __thread std::string *processName;
 
 void SetProcessName(const std::string &name) {
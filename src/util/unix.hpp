@@ -43,6 +43,7 @@ uint64_t GetCurrentTimeMs();
 bool WaitDeadline(uint64_t deadline, uint64_t sleep = 10);
 uint64_t GetTotalMemory();
 uint64_t GetHugetlbMemory();
+TError GetSystemOomKills(uint64_t &count);
 void SetProcessName(const std::string &name);
 void SetDieOnParentExit(int sig);
 std::string GetTaskName(pid_t pid = 0);
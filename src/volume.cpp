@@ -412,7 +412,7 @@ public:
 
         if (Volume->HaveQuota() && quota.Exists()) {
             L_ACT("Destroying project quota: {}", quota.Path);
-            TError error2 = quota.Destroy();
+            TError error2 = quota.Destroy(Volume->OwnStorage());
         }
 
         return error;
@@ -438,7 +438,7 @@ public:
     }
 };
 
-static TError SetupLoopDev(const TFile &file, const TPath &path, int &loopNr) {
+TError SetupLoopDev(const TFile &file, const TPath &path, int &loopNr) {
     static std::mutex BigLoopLock;
     TFile ctl, dev;
     struct loop_info64 info;
@@ -864,7 +864,7 @@ err:
 
         if (Volume->HaveQuota() && quota.Exists()) {
             L_ACT("Destroying project quota: {}", quota.Path);
-            TError error2 = quota.Destroy();
+            TError error2 = quota.Destroy(Volume->OwnStorage());
             if (!error)
                 error = error2;
         }
@@ -1545,13 +1545,18 @@ TError TVolume::CheckGuarantee(uint64_t space_guarantee, uint64_t inode_guarante
     if (error)
         return error;
 
+    /* Trash will be reclaimed soon */
+    uint64_t trash = TStorage::TrashSpace(storage.GetDev());
+    total.SpaceAvail += trash;
+
     StatFS(current);
 
     /* Check available space as is */
     if (total.SpaceAvail + current.SpaceUsage < space_guarantee)
-        return TError(EError::NoSpace, "Not enough space for volume guarantee {}, avail {}, our usage {}",
+        return TError(EError::NoSpace, "Not enough space for volume guarantee {}, avail {} including trash {}, our usage {}",
                       StringFormatSize(space_guarantee),
                       StringFormatSize(total.SpaceAvail),
+                      StringFormatSize(trash),
                       StringFormatSize(current.SpaceUsage));
 
     if (total.InodeAvail + current.InodeUsage < inode_guarantee &&
@@ -1887,6 +1892,7 @@ TError TVolume::Configure(const TPath &target_root) {
             TStorage layer_storage;
             layer_storage.Open(EStorageType::Layer, Place, l);
             layer = layer_storage.Path;
+            TStorage::LayerCacheAccess(Place, layer.Exists());
         }
         if (!layer.Exists())
             return TError(EError::LayerNotFound, "Layer not found " + layer.ToString());
@@ -1930,6 +1936,51 @@ TError TVolume::Configure(const TPath &target_root) {
     return OK;
 }
 
+/* Mount squashfs layers, first layer of backend squash is an image path */
+TError TVolume::MountLayers() {
+    TError error;
+
+    if (LayersMounted)
+        return OK;
+
+    for (size_t i = 0; i < Layers.size(); i++) {
+        if (Layers[i][0] == '/' || (i == 0 && BackendType == "squash"))
+            continue;
+
+        TStorage layer;
+        layer.Open(EStorageType::Layer, Place, Layers[i]);
+        error = layer.MountLayer();
+        if (error) {
+            while (i--) {
+                if (Layers[i][0] == '/' || (i == 0 && BackendType == "squash"))
+                    continue;
+                layer.Open(EStorageType::Layer, Place, Layers[i]);
+                layer.UmountLayer();
+            }
+            return error;
+        }
+    }
+
+    LayersMounted = true;
+    return OK;
+}
+
+void TVolume::UmountLayers() {
+    if (!LayersMounted)
+        return;
+
+    for (size_t i = 0; i < Layers.size(); i++) {
+        if (Layers[i][0] == '/' || (i == 0 && BackendType == "squash"))
+            continue;
+
+        TStorage layer;
+        layer.Open(EStorageType::Layer, Place, Layers[i]);
+        layer.UmountLayer();
+    }
+
+    LayersMounted = false;
+}
+
 TError TVolume::MergeLayers() {
     TError error;
 
@@ -1937,6 +1988,9 @@ TError TVolume::MergeLayers() {
         return OK;
 
     for (auto &name : Layers) {
+        uint64_t start = GetCurrentTimeMs();
+        TCopyStat stat;
+
         L_ACT("Merge layer {} into volume: {}", name, Path);
 
         if (name[0] == '/') {
@@ -1965,7 +2019,7 @@ TError TVolume::MergeLayers() {
                 return error;
             }
 
-            error = CopyRecursive(temp, InternalPath);
+            error = CopyRecursive(temp, InternalPath, &stat);
 
             (void)temp.UmountAll();
             (void)temp.Rmdir();
@@ -1974,10 +2028,17 @@ TError TVolume::MergeLayers() {
             layer_storage.Open(EStorageType::Layer, Place, name);
             (void)layer_storage.Touch();
             /* Imported layers are available for everybody */
-            error = CopyRecursive(layer_storage.Path, InternalPath);
+            error = CopyRecursive(layer_storage.Path, InternalPath, &stat);
         }
         if (error)
             return error;
+
+        if (stat.Files) {
+            uint64_t ms = std::max(GetCurrentTimeMs() - start, (uint64_t)1);
+            L_ACT("Merged layer {} at place {}: {} files {} bytes {} cloned in {} ms {} MB/s",
+                  name, Place, stat.Files, stat.Bytes, stat.Cloned, ms,
+                  stat.Bytes * 1000 / ms >> 20);
+        }
     }
 
     error = TStorage::SanitizeLayer(InternalPath, true);
@@ -2261,12 +2322,19 @@ TError TVolume::Build() {
     if (error)
         return error;
 
-    error = Backend->Build();
+    error = MountLayers();
     if (error)
         return error;
 
+    error = Backend->Build();
+    if (error) {
+        UmountLayers();
+        return error;
+    }
+
     if (BackendType != "overlay" && BackendType != "squash") {
         error = MergeLayers();
+        UmountLayers();
         if (error)
             return error;
 
@@ -2650,8 +2718,17 @@ TError TVolume::DeleteOne() {
     L_ACT("Delete volume: {} backend: {}", Path, BackendType);
 
     TPath internal = GetInternal("");
+    uint64_t space = 0;
     TError ret, error;
 
+    /* Usage reported as pending free while storage in trash */
+    if (OwnStorage()) {
+        TProjectQuota quota(StoragePath);
+        TStatFS stat;
+        if (quota.Exists() && !quota.StatFS(stat))
+            space = stat.SpaceUsage;
+    }
+
     if (Path != InternalPath) {
         error = Path.UmountAll();
         if (error) {
@@ -2677,6 +2754,8 @@ TError TVolume::DeleteOne() {
             ret = error;
     }
 
+    UmountLayers();
+
     StorageFd.Close();
 
     if (KeepStorage && !UserStorage() && !RemoteStorage()) {
@@ -2699,15 +2778,11 @@ TError TVolume::DeleteOne() {
 
     if (!KeepStorage && !RemoteStorage() && StoragePath.Exists()) {
         if (!UserStorage()) {
-            error = RemoveRecursive(StoragePath);
+            error = TStorage::RemoveTree(Place, StoragePath, space);
             if (error) {
-                L_VERBOSE("Cannot remove storage {}: {}", StoragePath, error);
-                error = StoragePath.RemoveAll();
-                if (error) {
-                    L_WRN("Cannot remove storage {}: {}", StoragePath, error);
-                    if (!ret)
-                        ret = error;
-                }
+                L_WRN("Cannot remove storage {}: {}", StoragePath, error);
+                if (!ret)
+                    ret = error;
             }
         } else {
             /* File image storage for backend=loop always persistent. */
@@ -3781,6 +3856,12 @@ next_link:
         if (RootContainer->VolumeMounts != (int)VolumeLinks.size())
             L_WRN("Volume links index out of sync: {} != {}", RootContainer->VolumeMounts, VolumeLinks.size());
 
+        if (volume->BackendType == "overlay" || volume->BackendType == "squash") {
+            error = volume->MountLayers();
+            if (error)
+                L_WRN("Volume {} layers: {}", volume->Path, error);
+        }
+
         L("Volume {} restored", volume->Path);
     }
 
@@ -3819,13 +3900,9 @@ next_link:
         if (error)
             L_ERR("Cannot umount nested : {}", error);
 
-        error = RemoveRecursive(dir);
-        if (error) {
-            L_VERBOSE("Cannot remove {}: {}", dir, error);
-            error = dir.RemoveAll();
-            if (error)
-                L_WRN("Cannot remove {}: {}", dir, error);
-        }
+        error = TStorage::RemoveTree(place.Path, dir);
+        if (error)
+            L_WRN("Cannot remove {}: {}", dir, error);
     }
 
     L_SYS("Remove stale layers...");
@@ -3836,6 +3913,7 @@ next_link:
         L_WRN("Layers listing failed : {}", error);
     } else {
         for (auto &layer : storages) {
+            layer.UmountUnused();
             if (layer.Weak()) {
                 error = layer.Remove(true);
                 if (error && error != EError::Busy)
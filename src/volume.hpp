@@ -124,6 +124,7 @@ public:
     bool HasDependentContainer = false;
 
     std::vector<std::string> Layers;
+    bool LayersMounted = false;
     std::list<std::shared_ptr<TVolumeLink>> Links;
 
     uint64_t ClaimedSpace = 0;
@@ -183,6 +184,8 @@ public:
 
     TError Build(void);
 
+    TError MountLayers();
+    void UmountLayers();
     TError MergeLayers();
     TError MakeDirectories(const TFile &base);
     TError MakeSymlinks(const TFile &base);
@@ -237,6 +240,11 @@ public:
         return Storage[0] == '/';
     }
 
+    /* StoragePath is removed together with volume */
+    bool OwnStorage(void) const {
+        return !KeepStorage && !UserStorage() && !RemoteStorage();
+    }
+
     /* They do not keep data in StoragePath */
     bool RemoteStorage(void) const {
         return BackendType == "rbd" ||
@@ -287,4 +295,5 @@ static inline std::unique_lock<std::mutex> LockVolumes() {
     return std::unique_lock<std::mutex>(VolumesMutex);
 }
 
+extern TError SetupLoopDev(const TFile &file, const TPath &path, int &loopNr);
 extern TError PutLoopDev(const int loopNr); /* Legacy */
@@ -1,21 +1,136 @@
 #include "waiter.hpp"
 #include "client.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <map>
+#include <deque>
 #include <time.h>
 
 static std::mutex ContainerWaitersLock;
-static std::list<TContainerWaiter *> ContainerWaiters;
 
 static inline std::unique_lock<std::mutex> LockWaiters() {
     return std::unique_lock<std::mutex>(ContainerWaitersLock);
 }
 
+/*
+ * Active waiters indexed by exact container name, by literal prefix of
+ * name wildcard and by exact label name. Wildcards without literal
+ * prefix like "***" are kept under empty prefix, label wildcards are
+ * kept in separate list. Event touches only waiters which could match.
+ */
+static std::unordered_multimap<std::string, TContainerWaiter *> WaitersByName;
+static std::unordered_multimap<std::string, TContainerWaiter *> WaitersByPrefix;
+static std::map<size_t, size_t> WaitersPrefixLengths;
+static std::unordered_multimap<std::string, TContainerWaiter *> WaitersByLabel;
+static std::list<TContainerWaiter *> WaitersLabelWildcards;
+static uint64_t WaitersSeq = 0;
+
+/*
+ * Bounded journal of reported events for resuming AsyncWait.
+ * Sequence counter lives in shared statistics and survives respawn,
+ * journal does not: JournalBase is the last seq lost from journal.
+ */
+static std::deque<TContainerReport> EventJournal;
+static uint64_t JournalBase = 0;
+static bool JournalInit = false;
+
+static const char *WILDCARD_CHARS = "*?[\\";
+
+static std::string WildcardPrefix(const std::string &pattern) {
+    return pattern.substr(0, std::min(pattern.find_first_of(WILDCARD_CHARS), pattern.size()));
+}
+
+static void IndexRemove(std::unordered_multimap<std::string, TContainerWaiter *> &index,
+                        const std::string &key, TContainerWaiter *waiter) {
+    auto range = index.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == waiter) {
+            index.erase(it);
+            return;
+        }
+    }
+}
+
+static void AddWaiterLocked(TContainerWaiter *waiter) {
+    waiter->Seq = ++WaitersSeq;
+
+    for (auto &name: waiter->Names)
+        WaitersByName.emplace(name, waiter);
+
+    for (auto &wc: waiter->Wildcards) {
+        auto prefix = WildcardPrefix(wc);
+        WaitersByPrefix.emplace(prefix, waiter);
+        WaitersPrefixLengths[prefix.size()]++;
+    }
+
+    for (auto &label: waiter->Labels) {
+        if (label.find_first_of(WILDCARD_CHARS) == std::string::npos)
+            WaitersByLabel.emplace(label, waiter);
+        else
+            WaitersLabelWildcards.push_back(waiter);
+    }
+}
+
+static void RemoveWaiterLocked(TContainerWaiter *waiter) {
+    for (auto &name: waiter->Names)
+        IndexRemove(WaitersByName, name, waiter);
+
+    for (auto &wc: waiter->Wildcards) {
+        auto prefix = WildcardPrefix(wc);
+        IndexRemove(WaitersByPrefix, prefix, waiter);
+        auto it = WaitersPrefixLengths.find(prefix.size());
+        if (!--it->second)
+            WaitersPrefixLengths.erase(it);
+    }
+
+    for (auto &label: waiter->Labels) {
+        if (label.find_first_of(WILDCARD_CHARS) == std::string::npos)
+            IndexRemove(WaitersByLabel, label, waiter);
+        else
+            WaitersLabelWildcards.remove(waiter);
+    }
+}
+
+/* Candidates in order of activation, without duplicates */
+static void FindWaitersLocked(const std::string &name, const std::string &label,
+                              std::vector<TContainerWaiter *> &found) {
+    if (!label.empty() && !(label[0] >= 'a' && label[0] <= 'z')) {
+        auto range = WaitersByLabel.equal_range(label);
+        for (auto it = range.first; it != range.second; ++it)
+            found.push_back(it->second);
+        for (auto waiter: WaitersLabelWildcards)
+            found.push_back(waiter);
+    } else {
+        auto range = WaitersByName.equal_range(name);
+        for (auto it = range.first; it != range.second; ++it)
+            found.push_back(it->second);
+
+        for (auto &len: WaitersPrefixLengths) {
+            if (len.first > name.size())
+                break;
+            range = WaitersByPrefix.equal_range(name.substr(0, len.first));
+            for (auto it = range.first; it != range.second; ++it)
+                found.push_back(it->second);
+        }
+    }
+
+    std::sort(found.begin(), found.end(), [](TContainerWaiter *a, TContainerWaiter *b) {
+        return a->Seq < b->Seq;
+    });
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+}
+
 TContainerWaiter::~TContainerWaiter() {
     PORTO_ASSERT(!Client);
 }
 
-void TContainerWaiter::Activate(TClient &client) {
+void TContainerWaiter::Activate(TClient &client, bool replay, uint64_t since) {
     auto lock = LockWaiters();
 
+    if (replay)
+        ReplayLocked(client, since);
+
     auto link = Async ? &client.AsyncWaiter : &client.SyncWaiter;
     if (*link)
         (*link)->DeactivateLocked();
@@ -25,7 +140,7 @@ void TContainerWaiter::Activate(TClient &client) {
     if (!Names.empty() || !Wildcards.empty()) {
         Client = &client;
         *link = shared_from_this();
-        ContainerWaiters.push_back(this);
+        AddWaiterLocked(this);
     }
 }
 
@@ -40,12 +155,24 @@ void TContainerWaiter::DeactivateLocked() {
     auto link = Async ? &Client->AsyncWaiter : &Client->SyncWaiter;
     PORTO_ASSERT(link->get() == this);
 
-    ContainerWaiters.remove(this);
+    RemoveWaiterLocked(this);
     Client = nullptr;
 
     link->reset();
 }
 
+bool TContainerWaiter::ShouldReportName(const std::string &name) {
+    for (auto &nm: Names)
+        if (name == nm)
+            return true;
+
+    for (auto &wc: Wildcards)
+        if (StringMatch(name, wc) && name != ROOT_CONTAINER)
+            return true;
+
+    return false;
+}
+
 bool TContainerWaiter::ShouldReport(TContainer &ct) {
 
     /* Sync wait reports only stopped, dead, respawning, hollow meta */
@@ -56,15 +183,7 @@ bool TContainerWaiter::ShouldReport(TContainer &ct) {
             (ct.State != EContainerState::META || ct.RunningChildren))
         return false;
 
-    for (auto &nm: Names)
-        if (ct.Name == nm)
-            return true;
-
-    for (auto &wc: Wildcards)
-        if (StringMatch(ct.Name, wc) && ct.Level)
-            return true;
-
-    return false;
+    return ShouldReportName(ct.Name);
 }
 
 bool TContainerWaiter::ShouldReportLabel(const std::string &label) {
@@ -74,25 +193,88 @@ bool TContainerWaiter::ShouldReportLabel(const std::string &label) {
     return false;
 }
 
+static void InitJournalLocked() {
+    if (!JournalInit) {
+        /* Fresh start: seq from previous runs must not be valid */
+        if (!Statistics->EventSeq)
+            Statistics->EventSeq = (uint64_t)time(nullptr) << 32;
+        JournalBase = Statistics->EventSeq;
+        JournalInit = true;
+    }
+}
+
+void TContainerWaiter::ReplayLocked(TClient &client, uint64_t since) {
+    InitJournalLocked();
+
+    if (Names.empty() && Wildcards.empty())
+        return;
+
+    /* Requested events are lost or seq belongs to another journal */
+    if (since < JournalBase || since > Statistics->EventSeq) {
+        TContainerReport report("", EContainerState::UNDEFINED, time(nullptr),
+                                "", "", Statistics->EventSeq);
+        report.Gap = true;
+        client.MakeReport(report, true);
+        return;
+    }
+
+    for (auto it = EventJournal.begin() + (since - JournalBase);
+            it != EventJournal.end(); ++it) {
+        auto &event = *it;
+        std::string name;
+
+        if (!ShouldReportName(event.Name))
+            continue;
+
+        if (!event.Label.empty() && !(event.Label[0] >= 'a' && event.Label[0] <= 'z') &&
+                !ShouldReportLabel(event.Label))
+            continue;
+
+        if (client.ComposeName(event.Name, name))
+            continue;
+
+        TContainerReport report = event;
+        report.Name = name;
+        client.MakeReport(report, true);
+    }
+}
+
+void TContainerWaiter::Replay(TClient &client, uint64_t since) {
+    auto lock = LockWaiters();
+    ReplayLocked(client, since);
+}
+
 void TContainerWaiter::ReportAll(TContainer &ct, const std::string &label, const std::string &value) {
+    std::vector<TContainerWaiter *> found;
     auto lock = LockWaiters();
-    for (auto it = ContainerWaiters.begin(); it != ContainerWaiters.end();) {
-        auto waiter = *it;
+
+    InitJournalLocked();
+
+    auto seq = ++Statistics->EventSeq;
+    auto when = time(nullptr);
+    uint64_t size = config().daemon().event_journal_size();
+
+    EventJournal.emplace_back(ct.Name, ct.State, when, label, value, seq);
+    while (EventJournal.size() > size) {
+        EventJournal.pop_front();
+        JournalBase++;
+    }
+
+    FindWaitersLocked(ct.Name, label, found);
+
+    for (auto waiter: found) {
         if (waiter->ShouldReport(ct) &&
                 (label.empty() || (label[0] >= 'a' && label[0] <= 'z') ||
                  waiter->ShouldReportLabel(label))) {
 
             std::string name;
             if (!waiter->Client->ComposeName(ct.Name, name)) {
-                waiter->Client->MakeReport(name, ct.State, waiter->Async, label, value);
-                if (!waiter->Async) {
-                    ++it;
+                waiter->Client->MakeReport(TContainerReport(name, ct.State, when, label, value, seq),
+                                           waiter->Async);
+                if (!waiter->Async)
                     waiter->DeactivateLocked();
-                    continue;
-                }
             }
         }
-        ++it;
     }
 }
 
@@ -13,10 +13,13 @@ struct TContainerReport {
     EContainerState State;
     std::string Label, Value;
     time_t When;
+    uint64_t Seq;
+    bool Gap = false;
 
     TContainerReport(const std::string &name, EContainerState state, time_t when,
-                     const std::string &label, const std::string &value):
-        Name(name), State(state), Label(label), Value(value), When(when) {}
+                     const std::string &label, const std::string &value,
+                     uint64_t seq = 0):
+        Name(name), State(state), Label(label), Value(value), When(when), Seq(seq) {}
 };
 
 class TContainerWaiter : public std::enable_shared_from_this<TContainerWaiter> {
@@ -26,14 +29,19 @@ public:
     std::vector<std::string> Wildcards;
     std::vector<std::string> Labels;
     bool Async;
+    uint64_t Seq = 0;
 
     TContainerWaiter(bool async) : Async(async) { }
     ~TContainerWaiter();
 
-    void Activate(TClient &client);
+    void Activate(TClient &client, bool replay = false, uint64_t since = 0);
     void Deactivate();
     void DeactivateLocked();
 
+    void Replay(TClient &client, uint64_t since);
+    void ReplayLocked(TClient &client, uint64_t since);
+
+    bool ShouldReportName(const std::string &name);
     bool ShouldReport(TContainer &ct);
     bool ShouldReportLabel(const std::string &label);
     void Timeout();
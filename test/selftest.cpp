@@ -13,6 +13,7 @@
 #include "util/unix.hpp"
 #include "util/cred.hpp"
 #include "util/idmap.hpp"
+#include "util/checksum.hpp"
 #include "test.hpp"
 #include "rpc.hpp"
 
@@ -2366,6 +2367,46 @@ static void TestFormat(Porto::TPortoApi &) {
     Expect(!!StringToSize("1z", v));
 }
 
+static std::string Xxh64Hex(const std::string &data, size_t chunk = 0) {
+    TChecksum checksum("xxh64");
+
+    if (!chunk)
+        chunk = data.size();
+    for (size_t off = 0; off < data.size(); off += chunk)
+        checksum.Update(data.data() + off, std::min(chunk, data.size() - off));
+    return checksum.Hex();
+}
+
+static void TestChecksum(Porto::TPortoApi &) {
+    std::string data;
+
+    for (int i = 0; i < 100; i++)
+        data += (char)(i * 7 % 251);
+
+    Expect(TChecksum::Supported("md5"));
+    Expect(TChecksum::Supported("xxh64"));
+    Expect(!TChecksum::Supported("crc32"));
+
+    ExpectEq(Xxh64Hex(""), "ef46db3751d8e999");
+    ExpectEq(Xxh64Hex("a"), "d24ec4f1a98c6e5b");
+    ExpectEq(Xxh64Hex("abc"), "44bc2cf5ad770999");
+
+    /* Around 32-byte stripe boundary */
+    ExpectEq(Xxh64Hex(data.substr(0, 31)), "0f187c62b1e722b7");
+    ExpectEq(Xxh64Hex(data.substr(0, 32)), "91b0cb0931a8c629");
+    ExpectEq(Xxh64Hex(data.substr(0, 33)), "931b043cf8d65b94");
+    ExpectEq(Xxh64Hex(data.substr(0, 64)), "ab64977b5af9d022");
+    ExpectEq(Xxh64Hex(data), "b7fe1d84b2f23a05");
+
+    /* Streaming gives the same digest regardless of chunking */
+    for (size_t chunk: { 1, 7, 31, 32, 33 })
+        ExpectEq(Xxh64Hex(data, chunk), "b7fe1d84b2f23a05");
+
+    TChecksum md5;
+    md5.Update("abc", 3);
+    ExpectEq(md5.Hex(), "900150983cd24fb0d6963f7d28e17f72");
+}
+
 static void TestRoot(Porto::TPortoApi &api) {
     string v;
     string root = "/";
@@ -4186,6 +4227,7 @@ int SelfTest(std::vector<std::string> args) {
         { "path", TestPath },
         { "idmap", TestIdmap },
         { "format", TestFormat },
+        { "checksum", TestChecksum },
         { "root", TestRoot },
         { "data", TestData },
         { "holder", TestHolder },
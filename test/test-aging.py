@@ -0,0 +1,73 @@
+#!/usr/bin/python
+
+import time
+import porto
+from test_common import *
+
+ConfigurePortod('test-aging', """
+daemon {
+    log_rotate_ms: 200
+}
+""")
+
+c = porto.Connection()
+
+def WaitFor(cond, timeout=5):
+    for i in range(timeout * 10):
+        if cond():
+            return True
+        time.sleep(0.1)
+    return cond()
+
+try:
+    # dead containers are destroyed by event due after aging_time
+    a = c.Run("test-aging-a", command="true", aging_time=1, wait=5)
+    b = c.Run("test-aging-b", command="true", aging_time=3600, wait=5)
+    ExpectEq(a["state"], "dead")
+    ExpectEq(b["state"], "dead")
+
+    Expect(WaitFor(lambda: "test-aging-a" not in c.List()))
+    ExpectEq(b["state"], "dead")
+
+    # changed aging_time reschedules destroy
+    b.SetProperty("aging_time", "1")
+    Expect(WaitFor(lambda: "test-aging-b" not in c.List()))
+
+    # restarted container is not destroyed by stale event
+    a = c.Run("test-aging-a", command="true", aging_time=1, wait=5)
+    a.Stop()
+    a.SetProperty("command", "sleep 1000")
+    a.Start()
+    time.sleep(2)
+    ExpectEq(a["state"], "running")
+    a.Destroy()
+
+    # writes into stdout queue rotation at next tick
+    rotated = int(c.GetProperty("/", "porto_stat", "log_rotate_bytes"))
+
+    a = c.Run("test-aging-a", command="bash -c 'seq 10000; sleep 2; seq 10000; sleep 1000'",
+              stdout_limit=4096)
+
+    Expect(WaitFor(lambda: int(a["stdout_offset"]) > 0))
+    ExpectEq(a["state"], "running")
+    ExpectLe(len(a["stdout"]), 4096)
+    offset = int(a["stdout_offset"])
+
+    # watch is re-armed after rotation
+    Expect(WaitFor(lambda: int(a["stdout_offset"]) > offset))
+    ExpectLe(len(a["stdout"]), 4096)
+    ExpectEq(a["stdout"].split()[-1], "10000")
+
+    # quiet log is not touched
+    offset = int(a["stdout_offset"])
+    time.sleep(1)
+    ExpectEq(int(a["stdout_offset"]), offset)
+
+    ExpectLe(rotated + offset, int(c.GetProperty("/", "porto_stat", "log_rotate_bytes")))
+
+    a.Destroy()
+
+finally:
+    for name in ["test-aging-a", "test-aging-b"]:
+        Catch(c.Destroy, name)
+    ConfigurePortod('test-aging', "")
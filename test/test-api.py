@@ -249,6 +249,36 @@ class TestApi(unittest.TestCase):
         assert a["private"] == volume_private
         a.Destroy()
 
+    def test_sync_get(self):
+        c = porto.Connection()
+
+        a = c.Run(container_name)
+        b = c.Run(container_name + "/b", command="sleep 60")
+
+        variables = ["state", "cpu_usage", "oom_kills", "oom_kills_total", "net_rx_bytes"]
+
+        # sync is limited to requested containers, missing ones get own errors
+        res = c.Get([container_name + "/b", container_name + "/missing"], variables, sync=True)
+        self.assertEqual(sorted(res.keys()), [container_name + "/b", container_name + "/missing"])
+        self.assertEqual(res[container_name + "/b"]["state"], "running")
+        self.assertEqual(res[container_name + "/b"]["oom_kills"], "0")
+        for var in variables:
+            self.assertIsInstance(res[container_name + "/missing"][var], porto.exceptions.ContainerDoesNotExist)
+
+        # repeated syncs within share period are consistent
+        prev = 0
+        for i in range(10):
+            res = c.Get([container_name, container_name + "/b"], variables, sync=True)
+            for name in [container_name, container_name + "/b"]:
+                for var in variables:
+                    self.assertNotIsInstance(res[name][var], porto.exceptions.PortoException)
+            self.assertEqual(res[container_name]["oom_kills_total"], "0")
+            usage = int(res[container_name]["cpu_usage"])
+            self.assertGreaterEqual(usage, prev)
+            prev = usage
+
+        a.Destroy()
+
     def test_layers(self):
         AsAlice()
         c = porto.Connection()
@@ -347,6 +377,27 @@ class TestApi(unittest.TestCase):
         l.Remove()
         os.rmdir(volume_path)
 
+    def test_get_values(self):
+        c = porto.Connection()
+
+        def Stat(name):
+            return int(c.GetProperty("/", "porto_stat", name))
+
+        a = c.Create(container_name)
+        a.SetProperty("command", "sleep " + "1" * 100)
+
+        # every value is counted, heap buffer only for text longer than inline storage
+        values = Stat("get_values")
+        allocs = Stat("get_value_allocs")
+
+        res = c.Get([container_name, container_name + "/missing"], ["state", "memory_limit", "command"])
+        self.assertEqual(res[container_name]["command"], "sleep " + "1" * 100)
+
+        self.assertEqual(Stat("get_values"), values + 3)
+        self.assertEqual(Stat("get_value_allocs"), allocs + 1)
+
+        a.Destroy()
+
     def test_storage(self):
         AsAlice()
         c = porto.Connection()
@@ -462,6 +513,30 @@ class TestApi(unittest.TestCase):
         c2.Disconnect()
         c.Disconnect()
 
+    def test_porto_rss(self):
+        c = porto.Connection()
+
+        def Stat():
+            return c.GetMap("/", "porto_stat")
+
+        st = Stat()
+        self.assertGreater(st["porto_rss"], 0)
+        self.assertGreater(st["porto_rss_per_container"], 0)
+        self.assertLessEqual(st["porto_rss_per_container"], st["porto_rss"])
+        self.assertGreater(st["container_struct_size"], 0)
+
+        # per container share follows container count
+        names = [container_name + "-{}".format(i) for i in range(100)]
+        try:
+            for name in names:
+                c.Create(name)
+            st2 = Stat()
+            self.assertLess(st2["porto_rss_per_container"], st["porto_rss_per_container"])
+            self.assertLessEqual(st2["porto_rss_per_container"] * (st2["containers"] + 1), st2["porto_rss"])
+        finally:
+            for name in names:
+                Catch(c.Destroy, name)
+
     def test_error_stringification(self):
         c = porto.Connection()
         c.Connect()
@@ -0,0 +1,54 @@
+#!/usr/bin/python
+
+import porto
+from test_common import *
+
+AsRoot()
+
+# small chunks spread even short requests across RO threads
+ConfigurePortod('test-get-parallel', """
+daemon {
+    get_chunk_size: 2
+    get_parallelism: 4
+}
+""")
+
+c = porto.Connection()
+
+COUNT = 50
+names = ["gp-{}".format(i) for i in range(COUNT)]
+
+try:
+    for i, name in enumerate(names):
+        c.Create(name).SetProperty("command", "sleep {}".format(i))
+
+    # missing containers in the middle of chunks
+    request = names[:COUNT // 2] + ["gp-missing"] + names[COUNT // 2:] + ["gp-missing2"]
+
+    for it in range(10):
+        res = c.Get(request, ["state", "command", "gp_bogus"])
+
+        # every chunk is completed, including missing entries
+        ExpectEq(sorted(res.keys()), sorted(request))
+
+        for i, name in enumerate(names):
+            ExpectEq(res[name]["state"], "stopped")
+            ExpectEq(res[name]["command"], "sleep {}".format(i))
+            ExpectEq(type(res[name]["gp_bogus"]), porto.exceptions.InvalidProperty)
+
+        # errors stay with their own entries
+        for name in ["gp-missing", "gp-missing2"]:
+            for var in ["state", "command", "gp_bogus"]:
+                ExpectEq(type(res[name][var]), porto.exceptions.ContainerDoesNotExist)
+
+    # wildcard request takes the same path
+    res = c.Get(["gp-*"], ["state"])
+    ExpectEq(sorted(res.keys()), sorted(names))
+
+finally:
+    for name in names:
+        try:
+            c.Destroy(name)
+        except porto.exceptions.ContainerDoesNotExist:
+            pass
+    ConfigurePortod('test-get-parallel', "")
@@ -91,6 +91,29 @@ ExpectProp(a, 'TEST.a', 'Y')
 a.SetLabel('TEST.a', '', 'Y')
 ExpectEq(Catch(a.GetProperty, 'TEST.a'), porto.exceptions.LabelNotFound)
 
+# label index follows set, change and removal
+
+a.SetLabel('TEST.idx', '1')
+ExpectEq(c.FindLabel('TEST.idx'), [{'name':'a', 'label':'TEST.idx', 'value':'1', 'state':'meta'}])
+ExpectEq(c.FindLabel('TEST.idx', value='1'), [{'name':'a', 'label':'TEST.idx', 'value':'1', 'state':'meta'}])
+
+a.SetLabel('TEST.idx', '2')
+ExpectEq(c.FindLabel('TEST.idx', value='1'), [])
+ExpectEq(c.FindLabel('TEST.idx', value='2'), [{'name':'a', 'label':'TEST.idx', 'value':'2', 'state':'meta'}])
+ExpectEq(c.WaitLabels(['a'], ['TEST.idx'], timeout=0)['value'], '2')
+
+x = c.Run('x')
+x.SetLabel('TEST.idx', '2')
+ExpectEq(c.FindLabel('TEST.idx', value='2'), [{'name':'a', 'label':'TEST.idx', 'value':'2', 'state':'meta'},
+                                              {'name':'x', 'label':'TEST.idx', 'value':'2', 'state':'meta'}])
+x.Destroy()
+ExpectEq(c.FindLabel('TEST.idx'), [{'name':'a', 'label':'TEST.idx', 'value':'2', 'state':'meta'}])
+
+a.SetLabel('TEST.idx', '')
+ExpectEq(c.FindLabel('TEST.idx'), [])
+ExpectEq(c.FindLabel('TEST.idx', value='2'), [])
+ExpectEq(Catch(c.WaitLabels, ['a'], ['TEST.idx'], timeout=0), porto.exceptions.WaitContainerTimeout)
+
 
 ExpectEq(Catch(a.IncLabel, 'TEST.a', add=0), porto.exceptions.LabelNotFound)
 a.SetLabel('TEST.a', 'a')
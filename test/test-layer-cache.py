@@ -0,0 +1,94 @@
+#!/usr/bin/python
+
+import os
+import shutil
+import tarfile
+import time
+import porto
+from test_common import *
+
+AsRoot()
+
+DIR = "/tmp/test-layer-cache"
+PLACE = DIR + "-place"
+MB = 2 ** 20
+
+ConfigurePortod('test-layer-cache', """
+volumes {
+    layer_cache_limit: "%s: %d"
+    layer_cache_period_ms: 1000
+}
+""" % (PLACE, 3 * MB))
+
+for path in [DIR, PLACE]:
+    if os.path.exists(path):
+        shutil.rmtree(path)
+    os.mkdir(path)
+
+for name in ["porto_volumes", "porto_layers", "porto_storage"]:
+    os.mkdir(PLACE + "/" + name)
+
+c = porto.Connection(timeout=300)
+
+def MakeLayer(name, hardlink=False):
+    src = DIR + "/" + name
+    os.mkdir(src)
+    with open(src + "/data", "wb") as f:
+        f.write(os.urandom(MB))
+    if hardlink:
+        os.link(src + "/data", src + "/link")
+    t = tarfile.open(name=src + ".tar", mode="w")
+    t.add(src, arcname=".")
+    t.close()
+    c.ImportLayer(name, src + ".tar", place=PLACE)
+    time.sleep(1.1)
+
+def Layers():
+    return [l.name for l in c.ListLayers(place=PLACE)]
+
+try:
+    # hardlinked data is counted once: a and b fit into limit
+    MakeLayer("a", hardlink=True)
+    MakeLayer("b")
+
+    # least recently used is b
+    v = c.CreateVolume(layers=["a"], place=PLACE)
+    v.Unlink()
+    time.sleep(1.1)
+
+    evictions = c.GetLayerCache(place=PLACE).evictions
+
+    MakeLayer("c")
+
+    for i in range(100):
+        if "b" not in Layers():
+            break
+        time.sleep(0.1)
+
+    ExpectEq(sorted(Layers()), ["a", "c"])
+
+    cache = c.GetLayerCache(place=PLACE)
+    ExpectEq(cache.place, PLACE)
+    ExpectEq(cache.space_limit, 3 * MB)
+    ExpectEq(cache.evictions, evictions + 1)
+    Expect(cache.space_used < 3 * MB)
+
+    # volumes count hits and misses of layers at place
+    v = c.CreateVolume(layers=["a"], place=PLACE)
+    v.Unlink()
+    ExpectEq(c.GetLayerCache(place=PLACE).hits, cache.hits + 1)
+
+    ExpectException(lambda: c.CreateVolume(layers=["missing"], place=PLACE), porto.exceptions.LayerNotFound)
+    ExpectEq(c.GetLayerCache(place=PLACE).misses, cache.misses + 1)
+
+finally:
+    for name in Layers():
+        c.RemoveLayer(name, place=PLACE)
+    # removed layers are reclaimed in background
+    for i in range(100):
+        if not os.path.exists(PLACE + "/porto_trash") or not os.listdir(PLACE + "/porto_trash"):
+            break
+        time.sleep(0.1)
+    shutil.rmtree(DIR)
+    shutil.rmtree(PLACE)
+    ConfigurePortod('test-layer-cache', "")
@@ -0,0 +1,123 @@
+#!/usr/bin/python
+
+import os
+import stat
+import subprocess
+import porto
+from test_common import *
+
+AsRoot()
+
+SRC = "/tmp/test-layer-copy"
+MB = 2 ** 20
+
+c = porto.Connection(timeout=60)
+
+def Cleanup():
+    for path in [SRC + "/mnt", SRC]:
+        if os.path.ismount(path):
+            subprocess.check_call(["umount", path])
+    if os.path.exists(SRC):
+        os.rmdir(SRC)
+
+def MakeTree():
+    # source on tmpfs, volumes are on other filesystem
+    os.mkdir(SRC)
+    subprocess.check_call(["mount", "-t", "tmpfs", "tmpfs", SRC])
+
+    os.mkdir(SRC + "/dir", 0o750)
+    os.chown(SRC + "/dir", 1234, 5678)
+
+    with open(SRC + "/dir/file", "wb") as f:
+        f.write(b"hello")
+    os.chmod(SRC + "/dir/file", 0o640)
+    os.chown(SRC + "/dir/file", 4321, 8765)
+    os.setxattr(SRC + "/dir/file", "user.porto_test", b"value")
+    os.setxattr(SRC + "/dir/file", "trusted.porto_test", b"trusted")
+
+    with open(SRC + "/big", "wb") as f:
+        f.write(os.urandom(8 * MB))
+    os.chmod(SRC + "/big", 0o755)
+
+    # hardlinks are kept
+    os.link(SRC + "/big", SRC + "/dir/big-link")
+
+    os.mkfifo(SRC + "/fifo")
+    os.symlink("dir/file", SRC + "/link")
+    os.symlink("/nonexistent", SRC + "/dangling")
+    os.lchown(SRC + "/link", 1234, 5678)
+
+    # content of other filesystems is not copied
+    os.mkdir(SRC + "/mnt")
+    subprocess.check_call(["mount", "-t", "tmpfs", "tmpfs", SRC + "/mnt"])
+    open(SRC + "/mnt/hidden", "w").close()
+
+    for path in ["/dir/file", "/big", "/dir", "/"]:
+        os.utime(SRC + path, (1000000000, 1200000000))
+
+def Tree(root):
+    res = {}
+    inodes = {}
+    for top, dirs, files in os.walk(root):
+        for name in dirs + files:
+            path = os.path.join(top, name)
+            rel = os.path.relpath(path, root)
+            st = os.lstat(path)
+            ent = {
+                "mode": st.st_mode,
+                "uid": st.st_uid,
+                "gid": st.st_gid,
+            }
+            if stat.S_ISLNK(st.st_mode):
+                ent["link"] = os.readlink(path)
+            else:
+                ent["mtime"] = int(st.st_mtime)
+                ent["xattr"] = sorted((k, os.getxattr(path, k)) for k in os.listxattr(path))
+            if stat.S_ISREG(st.st_mode):
+                ent["data"] = open(path, "rb").read()
+                ent["nlink"] = st.st_nlink
+                inodes.setdefault(st.st_ino, []).append(rel)
+            res[rel] = ent
+        # stay at one filesystem like copier does
+        dirs[:] = [d for d in dirs if not os.path.ismount(os.path.join(top, d))]
+    links = sorted(sorted(v) for v in inodes.values())
+    return res, links
+
+def Check():
+    v = c.CreateVolume(backend="plain", layers=[SRC])
+    try:
+        src, src_links = Tree(SRC)
+        dst, dst_links = Tree(v.path)
+
+        ExpectEq(sorted(dst.keys()), sorted(src.keys()))
+        for key in dst:
+            # mountpoint itself is seen from the other side
+            if key != "mnt":
+                ExpectEq((key, dst[key]), (key, src[key]))
+        ExpectEq(dst_links, src_links)
+        ExpectEq(dst["big"]["nlink"], 2)
+
+        Expect(stat.S_ISDIR(dst["mnt"]["mode"]))
+        ExpectEq(os.listdir(v.path + "/mnt"), [])
+        ExpectEq(int(os.stat(v.path).st_mtime), 1200000000)
+    finally:
+        v.Unlink()
+
+Cleanup()
+MakeTree()
+
+try:
+    # in-process copier and cp helper give the same result
+    for threads in [None, 1, 0]:
+        if threads is None:
+            ConfigurePortod('test-layer-copy', "")
+        else:
+            ConfigurePortod('test-layer-copy', """
+volumes {
+    copy_threads: %d
+}
+""" % threads)
+        Check()
+finally:
+    Cleanup()
+    ConfigurePortod('test-layer-copy', "")
@@ -0,0 +1,127 @@
+#!/usr/bin/python
+
+import hashlib
+import os
+import shutil
+import tarfile
+import time
+import porto
+from test_common import *
+
+AsRoot()
+
+DIR = "/tmp/test-layer-dedup"
+PLACE = DIR + "-place"
+MD5_PLACE = DIR + "-md5-place"
+LAYERS = PLACE + "/porto_layers"
+OBJECTS = PLACE + "/porto_objects"
+
+ConfigurePortod('test-layer-dedup', """
+volumes {
+    layer_dedup: true
+    layer_checksum: "default: md5; %s: xxh64"
+}
+""" % PLACE)
+
+for path in [DIR, PLACE, MD5_PLACE]:
+    if os.path.exists(path):
+        shutil.rmtree(path)
+    os.mkdir(path)
+
+for place in [PLACE, MD5_PLACE]:
+    for name in ["porto_volumes", "porto_layers", "porto_storage"]:
+        os.mkdir(place + "/" + name)
+
+c = porto.Connection(timeout=300)
+
+MTIME = 1500000000
+
+def MakeTarball(name, files):
+    src = DIR + "/" + name
+    os.mkdir(src)
+    for path, data in files.items():
+        with open(src + "/" + path, "wb") as f:
+            f.write(data)
+        os.utime(src + "/" + path, (MTIME, MTIME))
+    t = tarfile.open(name=src + ".tar", mode="w")
+    t.add(src, arcname=".")
+    t.close()
+    shutil.rmtree(src)
+    return src + ".tar"
+
+def Inode(layer, path):
+    return os.stat(LAYERS + "/" + layer + "/" + path).st_ino
+
+def Read(layer, path):
+    return open(LAYERS + "/" + layer + "/" + path, "rb").read()
+
+def XAttrs(path):
+    return {k: os.getxattr(path, k).decode() for k in os.listxattr(path) if k.startswith("user.porto.")}
+
+def Objects():
+    res = []
+    if os.path.exists(OBJECTS):
+        for top, dirs, files in os.walk(OBJECTS):
+            res += files
+    return res
+
+def Stat(name):
+    return int(c.GetProperty("/", "porto_stat", name))
+
+try:
+    dedup_files = Stat("layer_dedup_files")
+
+    common = os.urandom(65536)
+    c.ImportLayer("a", MakeTarball("a", {"common": common, "same_size": b"a" * 4096}), place=PLACE)
+    c.ImportLayer("b", MakeTarball("b", {"common": common, "same_size": b"b" * 4096}), place=PLACE)
+
+    # identical files share one inode with object in pool
+    ExpectEq(Inode("a", "common"), Inode("b", "common"))
+    ExpectEq(os.stat(LAYERS + "/a/common").st_nlink, 3)
+    ExpectLe(dedup_files + 1, Stat("layer_dedup_files"))
+
+    # same size, owner, mode and mtime but different content
+    ExpectNe(Inode("a", "same_size"), Inode("b", "same_size"))
+    ExpectEq(Read("a", "same_size"), b"a" * 4096)
+    ExpectEq(Read("b", "same_size"), b"b" * 4096)
+
+    # checksums are saved by algorithm of place
+    sums = [XAttrs(LAYERS + "/" + l + "/same_size") for l in ["a", "b"]]
+    ExpectEq([list(x.keys()) for x in sums], [["user.porto.xxh64sum"]] * 2)
+    ExpectEq(sums[0]["user.porto.xxh64sum"], "89a55a10892c1603")
+    ExpectNe(sums[0], sums[1])
+    ExpectEq(XAttrs(LAYERS + "/a/common"), XAttrs(LAYERS + "/b/common"))
+
+    c.ImportLayer("a", MakeTarball("md5", {"common": common}), place=MD5_PLACE)
+    ExpectEq(XAttrs(MD5_PLACE + "/porto_layers/a/common"),
+             {"user.porto.md5sum": hashlib.md5(common).hexdigest()})
+    c.RemoveLayer("a", place=MD5_PLACE)
+
+    # merge over shared file replaces it only in own layer
+    c.MergeLayer("a", MakeTarball("a2", {"common": b"new"}), place=PLACE)
+    ExpectEq(Read("a", "common"), b"new")
+    ExpectEq(Read("b", "common"), common)
+    ExpectNe(Inode("a", "common"), Inode("b", "common"))
+
+    # objects are dropped after their last layer is removed
+    Expect(len(Objects()) > 0)
+    c.RemoveLayer("a", place=PLACE)
+    c.RemoveLayer("b", place=PLACE)
+
+    for i in range(100):
+        if not Objects():
+            break
+        time.sleep(0.1)
+    ExpectEq(Objects(), [])
+
+finally:
+    for place in [PLACE, MD5_PLACE]:
+        for l in c.ListLayers(place=place):
+            l.Remove()
+        for i in range(100):
+            if not os.path.exists(place + "/porto_trash") or not os.listdir(place + "/porto_trash"):
+                break
+            time.sleep(0.1)
+        shutil.rmtree(place)
+    shutil.rmtree(DIR)
+    ConfigurePortod('test-layer-dedup', "")
@@ -0,0 +1,98 @@
+#!/usr/bin/python
+
+import os
+import threading
+import time
+import porto
+from test_common import *
+
+AsRoot()
+
+LAYER = "test-layer-stream"
+MB = 2 ** 20
+
+ConfigurePortod('test-layer-stream', """
+volumes {
+    stream_timeout_ms: 1000
+}
+""")
+
+c = porto.Connection(timeout=30)
+
+v = c.CreateVolume()
+
+try:
+    with open(v.path + "/data", "wb") as f:
+        f.write(os.urandom(MB))
+
+    # reader stalls: pipe buffer fills and export fails instead of hanging
+    r, w = os.pipe()
+    start = time.time()
+    ExpectException(lambda: v.Export(None, compress="tar", fd=w), porto.exceptions.Busy)
+    Expect(time.time() - start < 20)
+    os.close(r)
+    os.close(w)
+
+    # writer stalls: archive never ends and import fails instead of hanging
+    r, w = os.pipe()
+    os.write(w, b"\0" * 512)
+    start = time.time()
+    ExpectException(lambda: c.ImportLayer(LAYER, None, compress="tar", fd=r), porto.exceptions.Busy)
+    Expect(time.time() - start < 20)
+    os.close(r)
+    os.close(w)
+
+    Expect(LAYER not in [l.name for l in c.ListLayers()])
+
+    # place load is released and streams still work
+    r, w = os.pipe()
+    chunks = []
+    reader = threading.Thread(target=lambda: chunks.extend(iter(lambda: os.read(r, MB), b'')))
+    reader.start()
+    v.Export(None, compress="tar", fd=w)
+    os.close(w)
+    reader.join()
+    os.close(r)
+    Expect(len(b''.join(chunks)) > MB)
+
+    # compression of stream cannot be detected
+    r, w = os.pipe()
+    ExpectException(lambda: c.ImportLayer(LAYER, None, fd=r), porto.exceptions.InvalidValue)
+    os.close(r)
+    os.close(w)
+
+    # compressed archive goes through streams both ways
+    with open(v.path + "/file", "w") as f:
+        f.write("test")
+
+    r, w = os.pipe()
+    chunks = []
+    reader = threading.Thread(target=lambda: chunks.extend(iter(lambda: os.read(r, MB), b'')))
+    reader.start()
+    v.Export(None, compress="tar.gz", fd=w)
+    os.close(w)
+    reader.join()
+    os.close(r)
+    archive = b''.join(chunks)
+
+    r, w = os.pipe()
+    def WriteArchive():
+        with os.fdopen(w, 'wb') as f:
+            f.write(archive)
+    writer = threading.Thread(target=WriteArchive)
+    writer.start()
+    l = c.ImportLayer(LAYER, None, compress="tar.gz", fd=r)
+    writer.join()
+    os.close(r)
+    ExpectEq(l.name, LAYER)
+
+    u = c.CreateVolume(layers=[LAYER])
+    with open(u.path + "/file") as f:
+        ExpectEq(f.read(), "test")
+    u.Unlink()
+
+finally:
+    v.Unlink()
+    if LAYER in [l.name for l in c.ListLayers()]:
+        c.RemoveLayer(LAYER)
+    ConfigurePortod('test-layer-stream', "")
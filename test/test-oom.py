@@ -98,6 +98,36 @@ a.Destroy()
 total_oom = int(r['oom_kills_total'])
 
 
+# nested non fatal ooms are counted once at each level
+
+a = c.Run("test-oom")
+b = c.Run("test-oom/b")
+d = c.Run("test-oom/b/d", command="bash -c 'for i in 1 2 3; do stress -m 1 ; done; sleep 1000'",
+          memory_limit="64M", oom_is_fatal=False)
+
+for i in range(100):
+    if d.GetProperty('oom_kills', sync=True) == '3':
+        break
+    time.sleep(0.1)
+
+for sync in [False, True, True]:
+    ExpectEq(d.GetProperty('state'), 'running')
+    ExpectEq(d.GetProperty('oom_kills', sync=sync), '3')
+    ExpectEq(d.GetProperty('oom_kills_total', sync=sync), '3')
+
+    for ct in [a, b]:
+        ExpectEq(ct.GetProperty('state'), 'meta')
+        ExpectEq(ct.GetProperty('oom_kills', sync=sync), '0')
+        ExpectEq(ct.GetProperty('oom_kills_total', sync=sync), '3')
+
+    ExpectEq(r.GetProperty('oom_kills_total', sync=sync), str(total_oom + 3))
+    time.sleep(0.5)
+
+total_oom += 3
+
+a.Destroy()
+
+
 # os move oom
 
 a = c.Run("test-oom", command="stress -m 1", virt_mode="os", memory_limit="64M", wait=1)
@@ -0,0 +1,70 @@
+#!/usr/bin/python
+
+import sys
+import time
+import porto
+from test_common import *
+
+c = porto.Connection()
+
+if "cpu_pressure" not in c.Plist():
+    print("SKIP pressure stall information")
+    sys.exit()
+
+KEYS = ["some_avg10", "some_avg60", "some_avg300", "some_total",
+        "full_avg10", "full_avg60", "full_avg300", "full_total"]
+
+def Pressure(name, prop):
+    res = {}
+    for kv in c.GetProperty(name, prop).split(';'):
+        key, val = kv.split(':')
+        res[key.strip()] = float(val)
+    ExpectEq(sorted(res.keys()), sorted(KEYS))
+    for key in KEYS:
+        Expect(res[key] >= 0)
+    for key in ["some_avg10", "some_avg60", "some_avg300"]:
+        ExpectLe(res[key], 100)
+    return res
+
+b = c.Create("b")
+try:
+    b.SetProperty("pressure_trigger", "cpu some 100000 1000000; memory full 500000 500000 kill")
+    ExpectEq(b.GetProperty("pressure_trigger"), "cpu some 100000 1000000;memory full 500000 500000 kill")
+
+    for value in ["cpu some 100000 100000000",  # window above 10s
+                  "cpu some 100000 400000",     # window below 500ms
+                  "cpu some 0 1000000",
+                  "cpu some 2000000 1000000",
+                  "cpu some 100000 1000000 bogus",
+                  "cpu some 100000 1000000; cpu some 100000 2000000",
+                  "disk some 100000 1000000"]:
+        ExpectEq(Catch(b.SetProperty, "pressure_trigger", value), porto.exceptions.InvalidValue)
+
+    b.SetProperty("pressure_trigger", "io full 500000 10000000")
+    ExpectEq(b.GetProperty("pressure_trigger"), "io full 500000 10000000")
+finally:
+    b.Destroy()
+
+a = c.Run("a", command="bash -c 'while true; do true; done'", cpu_limit="0.1c")
+
+try:
+    for name in ["/", "a"]:
+        for prop in ["cpu_pressure", "memory_pressure", "io_pressure"]:
+            prev = Pressure(name, prop)
+            for i in range(5):
+                time.sleep(0.2)
+                cur = Pressure(name, prop)
+                # totals are cumulative stall time
+                ExpectLe(prev["some_total"], cur["some_total"])
+                ExpectLe(prev["full_total"], cur["full_total"])
+                prev = cur
+
+            total = int(c.GetProperty(name, prop + "[some_total]"))
+            ExpectLe(int(prev["some_total"]), total)
+            ExpectEq(Catch(c.GetProperty, name, prop + "[some_bogus]"), porto.exceptions.InvalidValue)
+
+    # throttled cpu hog stalls on cpu
+    ExpectLe(1, Pressure("a", "cpu_pressure")["some_total"])
+
+finally:
+    a.Destroy()
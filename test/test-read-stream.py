@@ -0,0 +1,52 @@
+from test_common import *
+import porto
+import time
+
+c = porto.Connection()
+
+a = c.Run("a", command="bash -c 'echo foo; sleep 1; echo bar; sleep 1000'")
+
+# wait for first line
+data, offset, size = c.ReadStream("a", offset=0, timeout=5)
+ExpectEq(data, b"foo\n")
+ExpectEq(offset, 0)
+ExpectEq(size, 4)
+
+# non-block at end of stream
+data, offset, size = c.ReadStream("a", offset=size)
+ExpectEq(data, b"")
+ExpectEq(size, 4)
+
+# follow
+data, offset, size = c.ReadStream("a", offset=4, timeout=5)
+ExpectEq(data, b"bar\n")
+ExpectEq(offset, 4)
+ExpectEq(size, 8)
+
+# timeout
+start = time.time()
+data, offset, size = c.ReadStream("a", offset=size, timeout=0.2)
+ExpectEq(data, b"")
+Expect(time.time() - start >= 0.2)
+
+# tail with limit
+data, offset, size = c.ReadStream("a", limit=4)
+ExpectEq(data, b"bar\n")
+
+ExpectEq(c.ReadStream("a", stream="stderr")[0], b"")
+ExpectEq(Catch(c.ReadStream, "a", stream="stdin"), porto.exceptions.InvalidValue)
+
+a.Destroy()
+
+# in-memory ring
+a = c.Run("a", command="bash -c 'echo foo; echo bar >&2; sleep 1; printf %0100d 0; sleep 1000'",
+          stdout_ring=True, stdout_limit=64)
+ExpectEq(a.GetProperty("stdout_ring"), True)
+ExpectEq(c.ReadStream("a", offset=0, timeout=5)[0], b"foo\n")
+ExpectEq(c.ReadStream("a", stream="stderr", offset=0, timeout=5)[0], b"bar\n")
+c.ReadStream("a", offset=4, timeout=5)
+time.sleep(0.5)
+ExpectEq(a.GetProperty("stdout_offset"), "40")
+ExpectEq(a.GetProperty("stdout"), "0" * 64)
+ExpectEq(a.GetProperty("stdout[100:4]"), "0000")
+a.Destroy()
@@ -0,0 +1,76 @@
+#!/usr/bin/python
+
+import os
+import sys
+import shutil
+import subprocess
+import porto
+from test_common import *
+
+AsRoot()
+
+if not any(os.path.exists(d + "/mksquashfs") for d in os.environ["PATH"].split(":")):
+    print("SKIP mksquashfs not found")
+    sys.exit()
+
+LAYER = "test-squash-layer"
+DIR = "/tmp/" + LAYER
+
+ConfigurePortod('test-squash-layer', """
+volumes {
+    squash_layers: true
+}
+""")
+
+c = porto.Connection(timeout=30)
+
+if os.path.exists(DIR):
+    shutil.rmtree(DIR)
+os.mkdir(DIR)
+
+def Mounted(path):
+    return path in ParseMountinfo()
+
+try:
+    os.mkdir(DIR + "/src")
+    with open(DIR + "/src/data", "w") as f:
+        f.write("squash")
+    subprocess.check_call(["mksquashfs", DIR + "/src", DIR + "/layer.squashfs", "-noappend", "-quiet"])
+
+    layer = c.ImportLayer(LAYER, DIR + "/layer.squashfs")
+    layer_path = "/place/porto_layers/" + LAYER
+
+    # image is kept as is and mounted only while used
+    Expect(os.path.isfile("/place/porto_layers/_squash_" + LAYER))
+    Expect(not Mounted(layer_path))
+
+    a = c.CreateVolume(layers=[LAYER], backend="overlay")
+    ExpectEq(open(a.path + "/data").read(), "squash")
+    ExpectEq(ParseMountinfo()[layer_path]['type'], "squashfs")
+
+    # second user shares the mount
+    b = c.CreateVolume(layers=[LAYER], backend="overlay")
+    ExpectEq(open(b.path + "/data").read(), "squash")
+
+    a.Unlink()
+    Expect(Mounted(layer_path))
+
+    b.Unlink()
+    Expect(not Mounted(layer_path))
+
+    # copying backend drops mount after merge
+    p = c.CreateVolume(layers=[LAYER], backend="plain")
+    ExpectEq(open(p.path + "/data").read(), "squash")
+    Expect(not Mounted(layer_path))
+    p.Unlink()
+
+    ExpectException(lambda: c.MergeLayer(LAYER, DIR + "/layer.squashfs"), porto.exceptions.NotSupported)
+
+    layer.Remove()
+    Expect(not os.path.exists("/place/porto_layers/_squash_" + LAYER))
+
+finally:
+    if LAYER in [l.name for l in c.ListLayers()]:
+        c.RemoveLayer(LAYER)
+    shutil.rmtree(DIR)
+    ConfigurePortod('test-squash-layer', "")
@@ -0,0 +1,78 @@
+#!/usr/bin/python
+
+import time
+import porto
+from test_common import *
+
+PERIOD_MS = 200
+HISTORY = 5
+
+ConfigurePortod('test-stats-sampler', """
+daemon {
+    stats_sample_ms: %d
+    stats_history: %d
+}
+""" % (PERIOD_MS, HISTORY))
+
+c = porto.Connection()
+
+def Procs(name):
+    return open("/sys/fs/cgroup/freezer/porto/{}/cgroup.procs".format(name)).read().split()
+
+a = c.Run("a", command="bash -c 'sleep 1000 & while true; do true; done'")
+
+try:
+    time.sleep(PERIOD_MS * 3 / 1000.)
+
+    # cpu-bound container: stable set of processes, one thread each
+    procs = Procs("a")
+    ExpectEq(int(a.GetProperty("process_count")), len(procs))
+    ExpectEq(int(a.GetProperty("thread_count")), len(procs))
+    ExpectEq(int(a.GetProperty("process_count", sync=True)), len(procs))
+    ExpectEq(int(a.GetProperty("thread_count", sync=True)), len(procs))
+
+    # sync get sees new process before next sample
+    b = c.Run("a/b", command="sleep 1000")
+    ExpectEq(int(a.GetProperty("process_count", sync=True)), len(Procs("a")) + len(Procs("a/b")))
+    b.Destroy()
+
+    time.sleep(PERIOD_MS * 3 / 1000.)
+    ExpectEq(int(a.GetProperty("process_count")), len(procs))
+
+    # busy loop burns at most one cpu
+    for window in [None, "1s", "%dms" % (PERIOD_MS * 2)]:
+        rate = int(a.GetProperty("cpu_usage_rate", window))
+        ExpectRange(rate, 1e8, 1.1e9)
+        ExpectLe(int(a.GetProperty("cpu_usage_system_rate", window)), rate)
+
+    ExpectLe(rate * 0.5, int(c.GetProperty("/", "cpu_usage_rate")))
+
+    # history grows until capped
+    Expect("cpu_usage" in a.GetProperty("stats_history").split(';'))
+    ExpectEq(Catch(a.GetProperty, "stats_history", "bogus"), porto.exceptions.InvalidProperty)
+
+    b = c.Run("a/c", command="bash -c 'while true; do true; done'")
+    prev = 0
+    for i in range(HISTORY * 3):
+        hist = [kv.split(':') for kv in b.GetProperty("stats_history", "cpu_usage").split(';') if kv]
+        ExpectLe(prev, len(hist))
+        ExpectLe(len(hist), HISTORY)
+        if len(hist) == HISTORY:
+            break
+        prev = len(hist)
+        time.sleep(PERIOD_MS / 1000.)
+    ExpectEq(len(hist), HISTORY)
+    Expect(prev < HISTORY)
+
+    # samples are ordered in time and usage of cpu hog grows
+    for i in range(1, len(hist)):
+        ExpectLe(int(hist[i - 1][0]), int(hist[i][0]))
+        ExpectLe(int(hist[i - 1][1]), int(hist[i][1]))
+
+    time.sleep(PERIOD_MS * 2 / 1000.)
+    ExpectEq(len(b.GetProperty("stats_history", "cpu_usage").split(';')), HISTORY)
+    b.Destroy()
+
+finally:
+    a.Destroy()
+    ConfigurePortod('test-stats-sampler', "")
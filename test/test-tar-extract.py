@@ -0,0 +1,173 @@
+#!/usr/bin/python
+
+import io
+import os
+import shutil
+import stat
+import subprocess
+import tarfile
+import time
+import porto
+from test_common import *
+
+AsRoot()
+
+DIR = "/tmp/test-tar-extract"
+PLACE = DIR + "-place"
+OUTSIDE = DIR + "-outside"
+LAYERS = PLACE + "/porto_layers"
+
+for path in [DIR, PLACE, OUTSIDE]:
+    if os.path.exists(path):
+        shutil.rmtree(path)
+    os.mkdir(path)
+
+for name in ["porto_volumes", "porto_layers", "porto_storage"]:
+    os.mkdir(PLACE + "/" + name)
+
+c = porto.Connection(timeout=60)
+
+def Stat(name):
+    return int(c.GetProperty("/", "porto_stat", name))
+
+def Entry(name, kind=tarfile.REGTYPE, data=b"", link="", pax=None):
+    info = tarfile.TarInfo(name)
+    info.type = kind
+    info.size = len(data)
+    info.mode = 0o755 if kind == tarfile.DIRTYPE else 0o644
+    info.mtime = 1500000000
+    info.linkname = link
+    if pax:
+        info.pax_headers = pax
+    return (info, data)
+
+def Tarball(name, entries, fmt=tarfile.PAX_FORMAT):
+    path = DIR + "/" + name + ".tar"
+    t = tarfile.open(name=path, mode="w", format=fmt)
+    for info, data in entries:
+        t.addfile(info, io.BytesIO(data) if info.isreg() else None)
+    t.close()
+    return path
+
+def Import(name, entries, fmt=tarfile.PAX_FORMAT, merge=False):
+    path = Tarball(name, entries, fmt)
+    if merge:
+        c.MergeLayer(name, path, place=PLACE)
+    else:
+        c.ImportLayer(name, path, place=PLACE)
+    return LAYERS + "/" + name
+
+def Layers():
+    return [l.name for l in c.ListLayers(place=PLACE)]
+
+def Remove(name):
+    if name in Layers():
+        c.RemoveLayer(name, place=PLACE)
+
+try:
+    fallback = Stat("layer_extract_fallback")
+
+    # unsafe paths are rejected
+    for name in ["../" + os.path.basename(OUTSIDE) + "/dotdot", "dir/../../dotdot", OUTSIDE + "/abs"]:
+        ExpectException(Import, porto.exceptions.InvalidValue, "unsafe", [Entry(name, data=b"x")])
+        ExpectEq(os.listdir(OUTSIDE), [])
+        Remove("unsafe")
+
+    ExpectException(Import, porto.exceptions.InvalidValue, "unsafe",
+                    [Entry("data", data=b"x"), Entry("link", tarfile.LNKTYPE, link=OUTSIDE + "/data")])
+    Remove("unsafe")
+
+    # symlinks are not followed, even in tar fallback
+    for target in [OUTSIDE, "../../../../../../.." + OUTSIDE]:
+        try:
+            layer = Import("symlink", [Entry("evil", tarfile.SYMTYPE, link=target),
+                                       Entry("evil/file", data=b"x")])
+            Expect(not os.path.islink(layer + "/evil"))
+            ExpectEq(open(layer + "/evil/file").read(), "x")
+        except porto.exceptions.PortoException:
+            pass
+        ExpectEq(os.listdir(OUTSIDE), [])
+        Remove("symlink")
+
+    ExpectEq(Stat("layer_extract_fallback"), fallback + 2)
+    fallback = Stat("layer_extract_fallback")
+
+    # aufs whiteouts become overlayfs whiteouts and opaque dirs
+    layer = Import("whiteout", [Entry("dir", tarfile.DIRTYPE),
+                                Entry("dir/.wh..wh..opq"),
+                                Entry("dir/file", data=b"x"),
+                                Entry(".wh.gone"),
+                                Entry(".wh..wh.aufs")])
+    ExpectEq(sorted(os.listdir(layer)), ["dir", "gone"])
+    ExpectEq(sorted(os.listdir(layer + "/dir")), ["file"])
+    ExpectEq(os.getxattr(layer + "/dir", "trusted.overlay.opaque"), b"y")
+    st = os.lstat(layer + "/gone")
+    Expect(stat.S_ISCHR(st.st_mode))
+    ExpectEq(st.st_rdev, 0)
+
+    # merge applies whiteouts to existing content
+    Import("whiteout", [Entry(".wh.dir")], merge=True)
+    ExpectEq(os.listdir(layer), ["gone"])
+    Remove("whiteout")
+
+    for fmt in [tarfile.PAX_FORMAT, tarfile.GNU_FORMAT]:
+        long_dir = "/".join(["d" * 60] * 5)
+        long_name = long_dir + "/" + "f" * 200
+        long_link = "/".join([".."] * 5) + "/" + "t" * 150
+
+        layer = Import("format", [Entry("data", data=b"hello"),
+                                  Entry("link", tarfile.LNKTYPE, link="data"),
+                                  Entry(long_name, data=b"long"),
+                                  Entry(long_dir + "/hard", tarfile.LNKTYPE, link=long_name),
+                                  Entry(long_dir + "/sym", tarfile.SYMTYPE, link=long_link)] +
+                                  ([Entry("xattr", data=b"x", pax={"SCHILY.xattr.user.test": "value"})]
+                                   if fmt == tarfile.PAX_FORMAT else []), fmt=fmt)
+
+        # hardlinks to earlier entries
+        ExpectEq(os.stat(layer + "/link").st_ino, os.stat(layer + "/data").st_ino)
+        ExpectEq(os.stat(layer + "/data").st_nlink, 2)
+
+        # pax and gnu long names and link targets
+        ExpectEq(open(layer + "/" + long_name).read(), "long")
+        ExpectEq(os.stat(layer + "/" + long_dir + "/hard").st_ino, os.stat(layer + "/" + long_name).st_ino)
+        ExpectEq(os.readlink(layer + "/" + long_dir + "/sym"), long_link)
+
+        if fmt == tarfile.PAX_FORMAT:
+            ExpectEq(os.getxattr(layer + "/xattr", "user.test"), b"value")
+
+        Remove("format")
+
+    ExpectEq(Stat("layer_extract_fallback"), fallback)
+
+    # sparse files are unpacked by tar, together with the rest of archive
+    src = DIR + "/sparse"
+    os.mkdir(src)
+    open(src + "/a", "w").write("a")
+    with open(src + "/b-sparse", "wb") as f:
+        f.seek(16 << 20)
+        f.write(b"end")
+    open(src + "/c", "w").write("c")
+    subprocess.check_call(["tar", "--sparse", "--format=gnu", "-cf", DIR + "/sparse.tar",
+                           "-C", src, "a", "b-sparse", "c"])
+
+    c.ImportLayer("sparse", DIR + "/sparse.tar", place=PLACE)
+    layer = LAYERS + "/sparse"
+    ExpectEq(open(layer + "/a").read(), "a")
+    ExpectEq(open(layer + "/c").read(), "c")
+    ExpectEq(os.stat(layer + "/b-sparse").st_size, (16 << 20) + 3)
+    with open(layer + "/b-sparse", "rb") as f:
+        f.seek(16 << 20)
+        ExpectEq(f.read(), b"end")
+    ExpectEq(Stat("layer_extract_fallback"), fallback + 1)
+    Remove("sparse")
+
+finally:
+    for name in Layers():
+        c.RemoveLayer(name, place=PLACE)
+    shutil.rmtree(DIR)
+    shutil.rmtree(OUTSIDE)
+    WaitTrash = 100
+    while WaitTrash and os.path.exists(PLACE + "/porto_trash") and os.listdir(PLACE + "/porto_trash"):
+        time.sleep(0.1)
+        WaitTrash -= 1
+    shutil.rmtree(PLACE)
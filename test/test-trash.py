@@ -0,0 +1,109 @@
+#!/usr/bin/python
+
+import os
+import shutil
+import subprocess
+import time
+import porto
+from test_common import *
+
+AsRoot()
+
+PLACE = "/tmp/test-trash-place"
+TRASH = PLACE + "/porto_trash"
+MB = 2 ** 20
+
+if os.path.exists(PLACE):
+    subprocess.call(["chattr", "-R", "-i", PLACE])
+    shutil.rmtree(PLACE)
+os.mkdir(PLACE)
+
+for name in ["porto_volumes", "porto_layers", "porto_storage"]:
+    os.mkdir(PLACE + "/" + name)
+
+c = porto.Connection(timeout=30)
+
+def Stat(name):
+    return int(c.GetProperty("/", "porto_stat", name))
+
+def Trash():
+    return os.listdir(TRASH) if os.path.exists(TRASH) else []
+
+def WaitTrash(count, timeout=30):
+    for i in range(timeout * 10):
+        if len(Trash()) == count and Stat("trash_entries") == count:
+            break
+        time.sleep(0.1)
+    ExpectEq(len(Trash()), count)
+    ExpectEq(Stat("trash_entries"), count)
+
+def Fill(v, size):
+    os.mkdir(v.path + "/dir")
+    for i in range(100):
+        with open("{}/dir/{}".format(v.path, i), "wb") as f:
+            f.write(b"x" * (size // 100))
+
+try:
+    removed = Stat("trash_removed")
+
+    # removal returns at once, reclaimer cannot unlink immutable file
+    v = c.CreateVolume(place=PLACE, backend="plain")
+    Fill(v, MB)
+    subprocess.check_call(["chattr", "+i", v.path + "/dir/0"])
+    v.Unlink()
+
+    ExpectEq(len(Trash()), 1)
+    entry = TRASH + "/" + Trash()[0]
+    Expect(os.path.exists(entry + "/dir/0"))
+    ExpectEq(Stat("trash_entries"), 1)
+
+    time.sleep(1)
+    ExpectEq(len(Trash()), 1)
+    ExpectEq(Stat("trash_removed"), removed)
+
+    # leftovers are picked up by restarted portod
+    ReloadPortod()
+    c = porto.Connection(timeout=30)
+
+    # place is scanned at first use
+    c.CreateVolume(place=PLACE, backend="plain").Unlink()
+    WaitTrash(1)
+    ExpectEq(Trash()[0], os.path.basename(entry))
+
+    subprocess.check_call(["chattr", "-i", entry + "/dir/0"])
+    WaitTrash(0)
+
+    # space of storage in trash counts as available for guarantees
+    try:
+        v = c.CreateVolume(place=PLACE, backend="native", space_limit="256M")
+    except porto.exceptions.NotSupported:
+        print("SKIP space guarantee: no project quota")
+        v = None
+
+    if v is not None:
+        Fill(v, 128 * MB)
+        subprocess.check_call(["chattr", "+i", v.path + "/dir/0"])
+        v.Unlink()
+        entry = TRASH + "/" + Trash()[0]
+
+        space = Stat("trash_space")
+        ExpectLe(127 * MB, space)
+
+        st = os.statvfs(PLACE)
+        avail = st.f_bavail * st.f_bsize
+        g = c.CreateVolume(place=PLACE, backend="native", space_limit="1G",
+                           space_guarantee=str(avail + space // 2))
+        g.Unlink()
+
+        ExpectException(lambda: c.CreateVolume(place=PLACE, backend="native", space_limit="1G",
+                                               space_guarantee=str(avail + space * 2)),
+                        porto.exceptions.NoSpace)
+
+        subprocess.check_call(["chattr", "-i", entry + "/dir/0"])
+        WaitTrash(0)
+        ExpectEq(Stat("trash_space"), 0)
+
+finally:
+    subprocess.call(["chattr", "-R", "-i", PLACE])
+    WaitTrash(0)
+    shutil.rmtree(PLACE)
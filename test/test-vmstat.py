@@ -0,0 +1,79 @@
+#!/usr/bin/python
+
+import time
+import porto
+from test_common import *
+
+c = porto.Connection()
+
+KEYS = {
+    "size": ["VmSize"],
+    "max_size": ["VmPeak"],
+    "data": ["VmData"],
+    "stack": ["VmStk"],
+    "code": ["VmExe", "VmLib"],
+}
+
+def Procs(name):
+    return open("/sys/fs/cgroup/freezer/porto/{}/cgroup.procs".format(name)).read().split()
+
+def ProcVmStat(name):
+    res = {"count": 0}
+    for key in KEYS:
+        res[key] = 0
+    for pid in Procs(name):
+        status = {}
+        for line in open("/proc/{}/status".format(pid)):
+            l = line.split()
+            if len(l) == 3 and l[2] == "kB":
+                status[l[0].rstrip(":")] = int(l[1]) * 1024
+        res["count"] += 1
+        for key, fields in KEYS.items():
+            for field in fields:
+                res[key] += status.get(field, 0)
+    return res
+
+def CheckVmStat(ct):
+    expect = ProcVmStat(ct.name)
+    stat = ct.GetMap("virtual_memory")
+    for key in expect:
+        ExpectEq(stat[key], expect[key])
+        ExpectEq(int(ct.GetProperty("virtual_memory", key)), expect[key])
+    ExpectLe(stat["used"], stat["size"])
+    ExpectLe(stat["anon"], stat["used"])
+    ExpectLe(stat["used"], stat["max_used"])
+
+def Check():
+    a = c.Run("a", command="bash -c 'sleep 1000 & sleep 1000 & exec sleep 1000'")
+    try:
+        time.sleep(0.5)
+        CheckVmStat(a)
+
+        # many processes are parsed in chunks
+        b = c.Run("a/b", command="bash -c 'for i in $(seq 600); do sleep 1000 & done; wait'")
+        for i in range(100):
+            if len(Procs("a/b")) > 600:
+                break
+            time.sleep(0.1)
+        CheckVmStat(b)
+        CheckVmStat(a)
+
+        # cached stats are dropped when sample expires
+        b.Destroy()
+        time.sleep(0.5)
+        CheckVmStat(a)
+    finally:
+        a.Destroy()
+
+Check()
+
+ConfigurePortod('test-vmstat', """
+daemon {
+    stats_sample_ms: 200
+}
+""")
+
+try:
+    Check()
+finally:
+    ConfigurePortod('test-vmstat', "")
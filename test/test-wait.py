@@ -42,3 +42,48 @@ a = c.Run("a", weak=False, command="sleep 1000")
 ReloadPortod()
 a.Destroy()
 ExpectEq(events, [])
+
+# resume async from event journal
+seqs = []
+def resume_event(name, state, when, label=None, value=None, seq=None):
+    ExpectEq((name, state), events.pop(0))
+    if state != "gap":
+        seqs.append(seq)
+
+events=[('', 'gap')]
+c.AsyncWait(["b"], resume_event, since_seq=0)
+ExpectEq(events, [])
+
+events=[('b', 'stopped'), ('b', 'starting'), ('b', 'running')]
+b = c.Run("b", weak=False, command="sleep 1000")
+ExpectEq(events, [])
+
+c.Disconnect()
+c.Connect()
+
+events=[('b', 'stopping'), ('b', 'stopped'), ('b', 'destroyed')]
+b.Destroy()
+ExpectEq(events, [])
+ExpectEq(seqs, sorted(seqs))
+ExpectEq(len(seqs), len(set(seqs)))
+
+# waiters are woken only for matching names and wildcards
+woken = []
+def index_event(name, state, when, label=None, value=None, seq=None):
+    woken.append(name)
+
+c.AsyncWait(["w-a", "w-x*"], index_event)
+
+for name in ["w-a", "w-b", "w-x1", "w-y"]:
+    c.Run(name, command="true").Destroy()
+
+ExpectEq(sorted(set(woken)), ["w-a", "w-x1"])
+
+x = c.Run("w-x2", command="sleep 1000")
+b = c.Run("w-b", command="true")
+ExpectEq(c.WaitContainers(["w-b"], timeout=5), "w-b")
+ExpectEq(Catch(c.WaitContainers, ["w-x*", "w-c"], timeout=0.1), porto.exceptions.WaitContainerTimeout)
+x.Kill(9)
+ExpectEq(c.WaitContainers(["w-x*", "w-c"], timeout=5), "w-x2")
+x.Destroy()
+b.Destroy()